@@ -0,0 +1,85 @@
+/***************************************************************************
+ *  Description:
+ *      Run a command and append its wall time, CPU time, and peak
+ *      memory use to a TSV results file.  POSIX time(1) has no
+ *      machine-readable output and is not installed everywhere.
+ *
+ *      Usage: bench-time results.tsv label command [args ...]
+ *
+ *      label is copied verbatim as the leading columns of the result
+ *      line, so it may contain tabs.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static double   tv_seconds(struct timeval *tv)
+
+{
+    return tv->tv_sec + tv->tv_usec / 1000000.0;
+}
+
+
+int     main(int argc, char *argv[])
+
+{
+    FILE            *results;
+    pid_t           pid;
+    int             status;
+    struct timeval  start,
+		    end;
+    struct rusage   usage;
+    double          wall;
+
+    if ( argc < 4 )
+    {
+	fprintf(stderr, "Usage: %s results.tsv label command [args ...]\n",
+		argv[0]);
+	return EX_USAGE;
+    }
+
+    gettimeofday(&start, NULL);
+    if ( (pid = fork()) == 0 )
+    {
+	execvp(argv[3], argv + 3);
+	fprintf(stderr, "%s: Cannot run %s: %s\n", argv[0], argv[3],
+		strerror(errno));
+	_exit(EX_UNAVAILABLE);
+    }
+    else if ( pid == -1 )
+    {
+	fprintf(stderr, "%s: fork() failed: %s\n", argv[0], strerror(errno));
+	return EX_OSERR;
+    }
+    waitpid(pid, &status, 0);
+    gettimeofday(&end, NULL);
+    // Includes grandchildren such as decompressors, once reaped
+    getrusage(RUSAGE_CHILDREN, &usage);
+    wall = tv_seconds(&end) - tv_seconds(&start);
+
+    if ( (results = fopen(argv[1], "a")) == NULL )
+    {
+	fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[1],
+		strerror(errno));
+	return EX_CANTCREAT;
+    }
+    // ru_maxrss is KiB on Linux and BSD, bytes on macOS
+    fprintf(results, "%s\t%.3f\t%.3f\t%.3f\t%ld\t%d\n", argv[2], wall,
+	    tv_seconds(&usage.ru_utime), tv_seconds(&usage.ru_stime),
+	    (long)usage.ru_maxrss,
+	    WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    fclose(results);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EX_SOFTWARE;
+}
@@ -0,0 +1,104 @@
+#!/bin/sh -e
+
+##########################################################################
+#   Script description:
+#       Time each stage of peak classification on synthetic data of
+#       increasing size and append the results to results.tsv, so that
+#       releases can be compared.  Run via "make bench".
+#
+#       Stages:
+#           index       Augment the GFF, sort, and write the index
+#           update      Replace the upstream regions in an existing
+#                       index for new --upstream-boundaries
+#           intersect   Classify peaks using an existing index
+#           filter      filter-overlaps on the intersect output
+#
+#       Environment:
+#           BENCH_GENES     Gene counts for synthetic GFFs
+#           BENCH_PEAKS     Peak counts for synthetic BEDs
+#           BENCH_THREADS   --threads for each command
+#
+#   History:
+#   Date        Name        Modification
+#   2026-10-16  Jason Bacon Begin
+#   2026-10-16  Jason Bacon Replace sort stage with update
+##########################################################################
+
+if [ $0 != ./bench.sh ]; then
+    printf "Must be run as ./bench.sh\n"
+    exit 1
+fi
+
+genes=${BENCH_GENES:-"20000 60000"}
+peaks=${BENCH_PEAKS:-"10000 100000 1000000 10000000"}
+threads=${BENCH_THREADS:-1}
+results=results.tsv
+version=$(../peak-classifier --version | awk '{ print $2 }')
+date=$(date '+%Y-%m-%dT%H:%M:%S')
+host=$(uname -n)
+log=bench.log
+
+# Boundaries for the update stage, differing from the defaults
+update_boundaries="2000,20000,200000"
+
+features="five_prime_utr three_prime_utr intron exon upstream1000
+    upstream10000 upstream100000 upstream-beyond"
+
+##########################################################################
+#   Function description:
+#       Time one command, appending a line to $results
+#
+#   Arguments:
+#       stage genes peaks command [args ...]
+##########################################################################
+
+run()
+{
+    stage=$1
+    stage_genes=$2
+    stage_peaks=$3
+    shift 3
+    printf "%-10s genes=%-8s peaks=%-9s " $stage $stage_genes $stage_peaks
+    ./bench-time $results \
+	"$date	$host	$version	$stage	$stage_genes	$stage_peaks	$threads" \
+	"$@" >> $log 2>&1
+    tail -n 1 $results | awk -F '\t' '{ printf("%8s s %10s KiB\n", $8, $11); }'
+}
+
+if [ ! -e $results ]; then
+    printf "Date\tHost\tVersion\tStage\tGenes\tPeaks\tThreads\tWall\tUser\tSys\tMaxRSS\tStatus\n" > $results
+fi
+mkdir -p Data
+rm -f $log
+
+if [ ! -e Data/one-peak.bed ]; then
+    awk -v peaks=1 -v chroms=1 -f gen-peaks.awk /dev/null > Data/one-peak.bed
+fi
+
+for g in $genes; do
+    gff=Data/synthetic-$g.gff3
+    if [ ! -e $gff ]; then
+	printf "Generating $gff...\n"
+	awk -v genes=$g -f gen-gff.awk /dev/null > $gff
+    fi
+    rm -f Data/synthetic-$g-augmented.*
+    run index $g 0 ../peak-classifier-index --threads $threads $gff
+    run update $g 1 ../peak-classifier --upstream-boundaries $update_boundaries \
+	Data/one-peak.bed $gff Data/scratch.tsv
+    # Restore the default boundaries, untimed, for the intersect stage
+    ../peak-classifier Data/one-peak.bed $gff Data/scratch.tsv >> $log 2>&1
+
+    for p in $peaks; do
+	bed=Data/peaks-$p.bed
+	if [ ! -e $bed ]; then
+	    printf "Generating $bed...\n"
+	    awk -v peaks=$p -f gen-peaks.awk /dev/null > $bed
+	fi
+	run intersect $g $p ../peak-classifier --threads $threads \
+	    $bed $gff Data/overlaps.tsv
+	run filter $g $p ../filter-overlaps --threads $threads \
+	    Data/overlaps.tsv Data/filtered.tsv $features
+    done
+done
+rm -f Data/scratch.tsv Data/overlaps.tsv Data/filtered.tsv
+printf "\nResults appended to $results.  Command output is in $log.\n"
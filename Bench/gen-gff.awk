@@ -0,0 +1,91 @@
+#############################################################################
+#   Description:
+#       Generate a synthetic GFF3 file resembling Ensembl annotations,
+#       sorted by chromosome and position, with "###" after each gene.
+#
+#   Usage:
+#       awk -v genes=20000 [-v chroms=20] [-v transcripts=4] [-v exons=12] \
+#           [-v seed=1] -f gen-gff.awk /dev/null > synthetic.gff3
+#
+#       transcripts and exons are the maximum per gene and per transcript.
+#       Counts are drawn uniformly from 1 to the maximum.
+#
+#   History:
+#   Date        Name        Modification
+#   2026-10-16  Jason Bacon Begin
+#############################################################################
+
+BEGIN {
+    if ( genes == "" ) genes = 20000
+    if ( chroms == "" ) chroms = 20
+    if ( transcripts == "" ) transcripts = 4
+    if ( exons == "" ) exons = 12
+    if ( seed == "" ) seed = 1
+    srand(seed)
+    OFS = "\t"
+
+    print "##gff-version 3"
+    per_chrom = int(genes / chroms)
+    if ( per_chrom < 1 ) per_chrom = 1
+    for (chrom = 1; chrom <= chroms; ++chrom)
+    {
+	pos = 1000 + int(rand() * 50000)
+	for (g = 1; g <= per_chrom; ++g)
+	{
+	    gene_len = 1000 + int(rand() * 80000)
+	    gene_start = pos
+	    gene_end = pos + gene_len - 1
+	    strand = rand() < 0.5 ? "+" : "-"
+	    type = rand() < 0.8 ? "gene" : "ncRNA_gene"
+	    gene_id = "SYN" chrom "G" g
+	    print chrom, "synthetic", type, gene_start, gene_end, ".", strand, \
+		".", "ID=gene:" gene_id ";Name=" gene_id
+
+	    nt = 1 + int(rand() * transcripts)
+	    for (t = 1; t <= nt; ++t)
+		transcript(chrom, gene_start, gene_len, strand, gene_id "T" t)
+	    print "###"
+
+	    # Some genes overlap the previous one, as in real annotations
+	    pos = gene_end - 5000 + int(rand() * 150000)
+	    if ( pos <= gene_start )
+		pos = gene_start + 1
+	}
+    }
+}
+
+function transcript(chrom, gene_start, gene_len, strand, id,
+		    tx_start, tx_end, ne, seg, e, exon_start, exon_end, utr)
+{
+    tx_start = gene_start + int(rand() * gene_len * 0.1)
+    tx_end = gene_start + gene_len - 1 - int(rand() * gene_len * 0.1)
+    print chrom, "synthetic", rand() < 0.85 ? "mRNA" : "lnc_RNA", \
+	tx_start, tx_end, ".", strand, ".", \
+	"ID=transcript:" id ";Parent=gene:" gene_id
+
+    # Exons evenly spaced over the transcript, separated by introns
+    ne = 1 + int(rand() * exons)
+    seg = (tx_end - tx_start + 1) / ne
+    for (e = 0; e < ne; ++e)
+    {
+	exon_start = int(tx_start + e * seg)
+	exon_end = e == ne - 1 ? tx_end : int(exon_start + seg * (0.1 + rand() * 0.5))
+	if ( exon_end <= exon_start )
+	    exon_end = exon_start + 1
+
+	# UTRs at the transcript ends, by strand
+	utr = ""
+	if ( e == 0 )
+	    utr = strand == "+" ? "five_prime_UTR" : "three_prime_UTR"
+	if ( e == ne - 1 )
+	    utr = strand == "+" ? "three_prime_UTR" : "five_prime_UTR"
+	print chrom, "synthetic", "exon", exon_start, exon_end, ".", strand, \
+	    ".", "Parent=transcript:" id
+	if ( utr != "" )
+	    print chrom, "synthetic", utr, exon_start, \
+		exon_start + int((exon_end - exon_start) * 0.3), ".", strand, \
+		".", "Parent=transcript:" id
+	print chrom, "synthetic", "CDS", exon_start, exon_end, ".", strand, \
+	    "0", "Parent=transcript:" id
+    }
+}
@@ -0,0 +1,39 @@
+#############################################################################
+#   Description:
+#       Generate synthetic peaks in BED format, sorted by chromosome and
+#       position as peak-classifier expects.  Peak widths are drawn from
+#       150 to 2000 bases, roughly like MACS2 narrow peaks.
+#
+#   Usage:
+#       awk -v peaks=1000000 [-v chroms=20] [-v chrom_len=100000000] \
+#           [-v seed=1] -f gen-peaks.awk /dev/null > synthetic.bed
+#
+#   History:
+#   Date        Name        Modification
+#   2026-10-16  Jason Bacon Begin
+#############################################################################
+
+BEGIN {
+    if ( peaks == "" ) peaks = 100000
+    if ( chroms == "" ) chroms = 20
+    if ( chrom_len == "" ) chrom_len = 100000000
+    if ( seed == "" ) seed = 1
+    srand(seed)
+    OFS = "\t"
+
+    per_chrom = int(peaks / chroms)
+    # Mean gap between peak starts that fills each chromosome
+    mean_gap = chrom_len / (per_chrom + 1)
+    n = 0
+    for (chrom = 1; chrom <= chroms; ++chrom)
+    {
+	count = chrom == chroms ? peaks - per_chrom * (chroms - 1) : per_chrom
+	pos = 0
+	for (p = 1; p <= count; ++p)
+	{
+	    pos += 1 + int(rand() * 2 * mean_gap)
+	    width = 150 + int(rand() * 1850)
+	    print chrom, pos, pos + width, "peak" ++n, int(rand() * 1000), "."
+	}
+    }
+}
@@ -36,10 +36,6 @@ printf "Viewing augmented GFF data...\n"
 pause
 more small-test-augmented.bed
 
-printf "Viewing sorted GFF data...\n"
-pause
-more small-test-augmented+sorted.bed
-
 printf "Viewing overlaps...\n"
 pause
 more small-test-overlaps.tsv
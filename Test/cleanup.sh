@@ -1,3 +1,5 @@
 #!/bin/sh -e
 
-rm -f *.tsv
+rm -f *.tsv *.pco
+rm -f test-*.bed test-*.txt test-small* Genes-test-small*
+rm -rf test-cache test-cache-gff test-cache-serial test-cache-bounds
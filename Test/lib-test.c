@@ -0,0 +1,84 @@
+/***************************************************************************
+ *  Description:
+ *      Classify peaks through the libpeakclassifier.a API and print the
+ *      overlaps as the lines of an overlaps TSV, without the header, so
+ *      test.sh can compare them to peak-classifier output.
+ *
+ *      Usage: lib-test features-augmented.pci peaks.bed
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <xtend/mem.h>
+#include "../libpeakclassifier.h"
+
+static void print_overlap(void *arg, const overlap_t *overlap)
+
+{
+    FILE    *stream = arg;
+
+    fprintf(stream, "%s\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64
+	    "\t%s\t%c\t%" PRId64, overlap->chrom, overlap->peak_start,
+	    overlap->peak_end, overlap->feature_start, overlap->feature_end,
+	    overlap->feature_name, overlap->strand, overlap->overlap);
+    if ( overlap->tss_distance != OVERLAP_NO_TSS_DISTANCE )
+	fprintf(stream, "\t%" PRId64, overlap->tss_distance);
+    putc('\n', stream);
+}
+
+
+int     main(int argc, char *argv[])
+
+{
+    feature_set_t       fs;
+    overlap_params_t    params = OVERLAP_PARAMS_INIT;
+    bl_bed_t            *peaks;
+    FILE                *peak_stream;
+    size_t              peak_count,
+			array_size;
+    int                 status;
+
+    if ( argc != 3 )
+    {
+	fprintf(stderr, "Usage: %s features-augmented.pci peaks.bed\n",
+		argv[0]);
+	return EX_USAGE;
+    }
+    if ( (peak_stream = fopen(argv[2], "r")) == NULL )
+    {
+	fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[2],
+		strerror(errno));
+	return EX_NOINPUT;
+    }
+    array_size = 1024;
+    peaks = xt_malloc(array_size, sizeof(*peaks));
+    for (peak_count = 0; ; ++peak_count)
+    {
+	if ( peak_count == array_size )
+	{
+	    array_size *= 2;
+	    peaks = xt_realloc(peaks, array_size, sizeof(*peaks));
+	}
+	peaks[peak_count] = (bl_bed_t)BL_BED_INIT;
+	if ( bl_bed_read(&peaks[peak_count], peak_stream,
+			 BL_BED_FIELD_ALL) != BL_READ_OK )
+	    break;
+    }
+    fclose(peak_stream);
+
+    if ( (status = pc_features_from_index(&fs, argv[1])) != EX_OK )
+	return status;
+    status = pc_classify(&fs, peaks, peak_count, &params, print_overlap,
+			 stdout);
+    pc_features_free(&fs);
+    free(peaks);
+    return status;
+}
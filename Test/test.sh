@@ -11,7 +11,7 @@ if [ ! -e $gff ]; then
 fi
 
 cd ..
-make clean all
+make clean all Test/lib-test
 cd Test
 
 # Use cave-man installed libs if available
@@ -59,3 +59,230 @@ printf "\nMidpoints only:\n\n"
     five_prime_utr three_prime_utr intron exon \
     upstream1000 upstream10000 upstream100000 upstream200000 upstream300000 \
     upstream400000 upstream500000 upstream600000 upstream700000 upstream800000 upstream-beyond
+
+printf "\nMidpoints only, ranked during classification:\n\n"
+../peak-classifier --midpoints \
+    --rank five_prime_utr,three_prime_utr,intron,exon,upstream1000,upstream10000,upstream100000,upstream200000,upstream300000,upstream400000,upstream500000,upstream600000,upstream700000,upstream800000,upstream-beyond \
+    test.bed.xz $gff test-midpoint-ranked.tsv
+cmp test-filtered.tsv test-midpoint-ranked.tsv
+
+printf "\nInvalid peaks (truncated line, end < start):\n\n"
+for peak in '1\t12098\n2\t300\t400\n' '1\t500\t400\n'; do
+    printf "$peak" > test-invalid.bed
+    status=0
+    ../peak-classifier test-invalid.bed $gff test-invalid-overlaps.tsv \
+	|| status=$?
+    if [ $status != 65 ]; then
+	printf "Expected EX_DATAERR (65), got $status.\n"
+	exit 1
+    fi
+done
+
+printf "\nInvalid overlap fractions (0, > 1, not a number):\n\n"
+for option in --min-peak-overlap --min-gff-overlap; do
+    for fraction in 0 1.5 0.2x; do
+	status=0
+	../peak-classifier $option $fraction test.bed.xz $gff \
+	    test-invalid-overlaps.tsv 2> /dev/null || status=$?
+	if [ $status != 64 ]; then
+	    printf "Expected EX_USAGE (64) for $option $fraction, got $status.\n"
+	    exit 1
+	fi
+    done
+done
+
+printf "\nBatch manifest, compared to single runs:\n\n"
+printf "test.bed.xz test-batch-overlaps.tsv\ntest.bed.xz test-batch-peak-20-overlaps.tsv --min-peak-overlap 0.2\n" \
+    > test-batch.txt
+../peak-classifier --batch test-batch.txt $gff
+cmp test-batch-overlaps.tsv test-overlaps.tsv
+cmp test-batch-peak-20-overlaps.tsv test-peak-20-overlaps.tsv
+
+printf "\nServer queries, compared to a single run, and a malformed query:\n\n"
+xz -dc test.bed.xz | head -n 3 > test-serve.bed
+../peak-classifier test-serve.bed $gff test-serve-overlaps.tsv
+(grep -v '^#' test-serve-overlaps.tsv
+    printf "#Error: Query 4: Expected chrom start end.\n\n") > test-serve-expected.txt
+../peak-classifier --serve test-serve.sock $gff &
+server=$!
+tries=0
+while [ ! -S test-serve.sock ] && [ $tries -lt 30 ]; do
+    sleep 1
+    tries=$(($tries + 1))
+done
+(cat test-serve.bed; printf "1 oops\n\n") | python3 -c '
+import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+s.sendall(sys.stdin.buffer.read())
+s.shutdown(socket.SHUT_WR)
+while True:
+    data = s.recv(65536)
+    if not data:
+        break
+    sys.stdout.buffer.write(data)
+' test-serve.sock > test-serve-reply.txt
+kill $server
+wait $server
+cmp test-serve-reply.txt test-serve-expected.txt
+
+printf "\nLibrary API, compared to a single run:\n\n"
+./lib-test ${gff%.gff3*}-augmented.pci test-serve.bed > test-lib-overlaps.txt
+grep -v '^#' test-serve-overlaps.tsv | cmp - test-lib-overlaps.txt
+
+printf "\nBinary overlaps, compared to TSV:\n\n"
+../peak-classifier test.bed.xz $gff test-overlaps.pco
+../overlaps-to-tsv test-overlaps.pco test-pco-overlaps.tsv
+cmp test-pco-overlaps.tsv test-overlaps.tsv
+../filter-overlaps test-overlaps.tsv test-tsv-filtered.tsv \
+    five_prime_utr three_prime_utr intron exon upstream1000 upstream-beyond
+../filter-overlaps test-overlaps.pco test-pco-filtered.tsv \
+    five_prime_utr three_prime_utr intron exon upstream1000 upstream-beyond
+cmp test-pco-filtered.tsv test-tsv-filtered.tsv
+
+printf "\nTSS distances, compared to hand-checked output:\n\n"
+cp ../Small-test/small-test.gff3 test-small.gff3
+../peak-classifier-index --tss-distance test-small.gff3
+../peak-classifier --tss-distance tss-distance.bed test-small.gff3 \
+    test-tss-distance.tsv
+cmp test-tss-distance.tsv tss-distance-correct.txt
+
+printf "\nUnsorted peaks, sorted with spill files and in input order:\n\n"
+xz -dc test.bed.xz | sort -r > test-unsorted.bed
+# --mem 16K holds about 500 peaks, so the sort spills runs to temp files
+../peak-classifier --sort-input --mem 16K test-unsorted.bed $gff \
+    test-sort-input-overlaps.tsv
+cmp test-sort-input-overlaps.tsv test-overlaps.tsv
+../peak-classifier --restore-order --mem 16K test-unsorted.bed $gff \
+    test-restore-order-overlaps.tsv
+# The library API classifies peaks in the order given
+./lib-test ${gff%.gff3*}-augmented.pci test-unsorted.bed \
+    > test-unsorted-lib-overlaps.txt
+grep -v '^#' test-restore-order-overlaps.tsv | cmp - test-unsorted-lib-overlaps.txt
+
+printf "\nCount matrices, compared to counts from the overlaps:\n\n"
+xz -dc test.bed.xz | awk 'NR % 2' > test-sample-a.bed
+xz -dc test.bed.xz | awk 'NR % 3 == 0' > test-sample-b.bed
+../peak-classifier --matrix test-matrix.tsv \
+    --gene-matrix test-gene-matrix.tsv $gff test-sample-a.bed test-sample-b.bed
+column=2
+for sample in test-sample-a test-sample-b; do
+    # Distinct peaks of the sample per feature, and overlaps with genes
+    awk -v genes=$sample-gene-overlaps.txt '
+	FNR == NR { peaks[$1 " " $2 " " $3]; ++total; next }
+	/^#/ || !(($1 " " $2 " " $3) in peaks) { next }
+	!seen[$1 " " $2 " " $3 " " $6]++ { ++count[$6] }
+	$6 ~ /gene$/ { ++gene_overlaps }
+	END {
+	    print "total-peaks", total
+	    for (feature in count)
+		print feature, count[feature]
+	    print gene_overlaps + 0 > genes
+	}' $sample.bed test-overlaps.tsv | sort > $sample-expected.txt
+    awk -v column=$column '!/^#/ && $column > 0 { print $1, $column }' \
+	test-matrix.tsv | sort > $sample-matrix.txt
+    cmp $sample-matrix.txt $sample-expected.txt
+    awk -v column=$column '!/^#/ { sum += $column } END { print sum + 0 }' \
+	test-gene-matrix.tsv | cmp - $sample-gene-overlaps.txt
+    column=$(($column + 1))
+done
+
+printf "\nGene lookup, compared to the augmented features:\n\n"
+../peak-classifier-index test-small.gff3
+../extract-genes test-small-augmented.bed
+genes="1-3435953-3438772 1-3276123-3741721"
+../extract-genes --lookup test-small-augmented.bed $genes > test-lookup.txt
+# The feature block beginning with each gene, in the order requested
+for gene in $genes; do
+    awk -v gene=$gene '
+	/^###/ { block = 0; next }
+	/^#/ { next }
+	block == 0 { block = ($1 "-" $2 "-" $3 == gene) ? 1 : -1 }
+	block == 1' test-small-augmented.bed
+done > test-lookup-expected.txt
+cmp test-lookup.txt test-lookup-expected.txt
+status=0
+../extract-genes --lookup test-small-augmented.bed 1-5-6 || status=$?
+if [ $status != 65 ]; then
+    printf "Expected EX_DATAERR (65), got $status.\n"
+    exit 1
+fi
+
+printf "\nGFF without ### separators, and sorted by position:\n\n"
+grep -v '^###' test-small.gff3 > test-small-noseps.gff3
+# A stable sort by start interleaves the subfeatures of overlapping genes
+grep '^#' test-small.gff3 | grep -v '^###' > test-small-sorted.gff3
+grep -v '^#' test-small.gff3 | sort -s -t "$(printf '\t')" -k 1,1 -k 4,4n \
+    >> test-small-sorted.gff3
+grep -v '^#' test-small-augmented.bed | sort > test-small-features.txt
+for variant in noseps sorted; do
+    ../peak-classifier-index test-small-$variant.gff3
+    grep -v '^#' test-small-$variant-augmented.bed | sort \
+	| cmp - test-small-features.txt
+done
+
+printf "\nCached index, reused for a copy of the GFF:\n\n"
+rm -rf test-cache test-cache-gff
+mkdir test-cache-gff
+cp $gff test-cache-gff
+for gff_copy in $gff test-cache-gff/$(basename $gff); do
+    ../peak-classifier --cache-dir test-cache test.bed.xz $gff_copy \
+	test-cache-overlaps.tsv 2> test-cache-stderr.txt
+    cat test-cache-stderr.txt
+    cmp test-cache-overlaps.tsv test-overlaps.tsv
+done
+if ! grep -q '^Using existing test-cache/' test-cache-stderr.txt; then
+    printf "Cached index was not reused.\n"
+    exit 1
+fi
+if ls test-cache/*.lock > /dev/null 2>&1; then
+    printf "Lock file left in test-cache.\n"
+    exit 1
+fi
+
+printf "\nConcurrent jobs with two sets of upstream boundaries:\n\n"
+cp ../Small-test/small-test.gff3 test-small-bounds.gff3
+# Uncompressed, so that jobs start together instead of after xz
+xz -dc test.bed.xz > test-bounds.bed
+for bounds in 1000,10000,100000 2000,20000,200000; do
+    ../peak-classifier --cache-dir test-cache-serial \
+	--upstream-boundaries $bounds test-bounds.bed $gff \
+	test-bounds-$bounds-expected.tsv
+    ../peak-classifier --cache-dir test-cache-serial \
+	--upstream-boundaries $bounds test-bounds.bed test-small-bounds.gff3 \
+	test-small-bounds-$bounds-expected.tsv
+done
+# Cached indexes, and an index next to the GFF updated in turns.  Jobs
+# that mapped an index just updated by another job used its regions.
+# This depends on timing, so a regression may pass now and then.
+jobs=$(seq 1 50)
+for cache in test-cache-bounds ""; do
+    pids=""
+    for job in $jobs; do
+	for bounds in 1000,10000,100000 2000,20000,200000; do
+	    if [ -n "$cache" ]; then
+		../peak-classifier --cache-dir $cache \
+		    --upstream-boundaries $bounds test-bounds.bed $gff \
+		    test-bounds-$bounds-$job.tsv 2> /dev/null &
+	    else
+		../peak-classifier --upstream-boundaries $bounds \
+		    test-bounds.bed test-small-bounds.gff3 \
+		    test-small-bounds-$bounds-$job.tsv 2> /dev/null &
+	    fi
+	    pids="$pids $!"
+	done
+    done
+    for pid in $pids; do
+	wait $pid
+    done
+    for job in $jobs; do
+	for bounds in 1000,10000,100000 2000,20000,200000; do
+	    if [ -n "$cache" ]; then
+		cmp test-bounds-$bounds-$job.tsv test-bounds-$bounds-expected.tsv
+	    else
+		cmp test-small-bounds-$bounds-$job.tsv \
+		    test-small-bounds-$bounds-expected.tsv
+	    fi
+	done
+    done
+done
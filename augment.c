@@ -0,0 +1,858 @@
+/***************************************************************************
+ *  Description:
+ *      Convert a GFF3 file to a BED file of features of interest,
+ *      inserting explicit intron and upstream (promoter) regions.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2021-04-15  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <xtend/string.h>
+#include <xtend/file.h>
+#include <xtend/mem.h>
+#include <biolibc/bed.h>
+#include <biolibc/gff3.h>
+#include <biolibc/pos-list.h>
+#include "feature-sort.h"
+#include "classify.h"
+#include "fast-write.h"
+#include "augment.h"
+
+/*
+ *  Format the name once, and number it once in the sorter, if any
+ */
+
+static void label_init(augment_out_t *out, augment_label_t *label,
+		       const char *name)
+
+{
+    int     status;
+
+    label->name = strdup(name);
+    label->len = strlen(name);
+    label->num = 0;
+    if ( (out->sorter != NULL) &&
+	 ((status = feature_sort_name(out->sorter, name, &label->num)) != EX_OK) )
+	exit(status);
+}
+
+
+/*
+ *  Labels for generated features: introns and each upstream region
+ */
+
+static void labels_init(augment_out_t *out, bl_pos_list_t *pos_list)
+
+{
+    char    name[BL_BED_NAME_MAX_CHARS + 1];
+    size_t  c;
+
+    label_init(out, &out->intron, "intron");
+    out->upstream_count = BL_POS_LIST_COUNT(pos_list) - 1;
+    out->upstream = xt_malloc(out->upstream_count + 1,
+			      sizeof(*out->upstream));
+    for (c = 0; c < out->upstream_count; ++c)
+    {
+	snprintf(name, BL_BED_NAME_MAX_CHARS, "upstream%" PRId64,
+		 BL_POS_LIST_POSITIONS_AE(pos_list, c + 1));
+	label_init(out, &out->upstream[c], name);
+    }
+}
+
+
+static void labels_free(augment_out_t *out)
+
+{
+    size_t  c;
+
+    for (c = 0; c < out->upstream_count; ++c)
+	free(out->upstream[c].name);
+    free(out->upstream);
+    free(out->intron.name);
+}
+
+
+/*
+ *  Format one 6-column BED line, as bl_bed_write() would
+ */
+
+static char *bed_format(char *p, const char *chrom, int64_t start,
+			int64_t end, const char *name, size_t name_len,
+			unsigned score, char strand)
+
+{
+    p = fast_format_str(p, chrom, strlen(chrom));
+    *p++ = '\t';
+    p = fast_format_int64(p, start);
+    *p++ = '\t';
+    p = fast_format_int64(p, end);
+    *p++ = '\t';
+    p = fast_format_str(p, name, name_len);
+    *p++ = '\t';
+    p = fast_format_uint64(p, score);
+    *p++ = '\t';
+    *p++ = strand;
+    *p++ = '\n';
+    return p;
+}
+
+
+/*
+ *  Label for a GFF feature type, added the first time the type is seen
+ */
+
+static size_t   window_type(augment_out_t *out, const char *type)
+
+{
+    augment_window_t    *window = &out->window;
+    size_t              c;
+
+    for (c = 0; c < window->type_count; ++c)
+	if ( strcmp(window->types[c].name, type) == 0 )
+	    return c;
+    if ( window->type_count == window->type_array_size )
+    {
+	window->type_array_size = window->type_array_size == 0 ? 32 :
+				  window->type_array_size * 2;
+	window->types = xt_realloc(window->types, window->type_array_size,
+				   sizeof(*window->types));
+    }
+    label_init(out, &window->types[window->type_count], type);
+    return window->type_count++;
+}
+
+
+static void gene_add_id(augment_gene_t *gene, const char *id)
+
+{
+    if ( gene->id_count == gene->id_array_size )
+    {
+	gene->id_array_size = gene->id_array_size == 0 ? 8 :
+			      gene->id_array_size * 2;
+	gene->ids = xt_realloc(gene->ids, gene->id_array_size,
+			       sizeof(*gene->ids));
+    }
+    gene->ids[gene->id_count].id = strdup(id);
+    gene->ids[gene->id_count].exon_seen = false;
+    ++gene->id_count;
+}
+
+
+static void gene_free(augment_gene_t *gene)
+
+{
+    size_t  c;
+
+    for (c = 0; c < gene->id_count; ++c)
+	free(gene->ids[c].id);
+    free(gene->ids);
+    free(gene->subs);
+}
+
+
+static void window_free(augment_window_t *window)
+
+{
+    size_t  c;
+
+    for (c = 0; c < window->count; ++c)
+	gene_free(&window->genes[c]);
+    free(window->genes);
+    for (c = 0; c < window->type_count; ++c)
+	free(window->types[c].name);
+    free(window->types);
+}
+
+
+/*
+ *  Find the open gene and ID named by the first ID in a Parent
+ *  attribute.  Subfeatures of the same parent usually come together,
+ *  so the last match is checked first, then the newest genes and IDs.
+ */
+
+static bool window_find_parent(augment_window_t *window, const char *parent,
+			       size_t *gene_index, size_t *id_index)
+
+{
+    size_t          len = strcspn(parent, ","),
+		    g,
+		    c;
+    augment_id_t    *ids;
+
+    if ( (window->last_gene < window->count) &&
+	 (window->last_id < window->genes[window->last_gene].id_count) )
+    {
+	ids = window->genes[window->last_gene].ids;
+	if ( (strncmp(ids[window->last_id].id, parent, len) == 0) &&
+	     (ids[window->last_id].id[len] == '\0') )
+	{
+	    *gene_index = window->last_gene;
+	    *id_index = window->last_id;
+	    return true;
+	}
+    }
+    for (g = window->count; g-- > 0; )
+    {
+	ids = window->genes[g].ids;
+	for (c = window->genes[g].id_count; c-- > 0; )
+	{
+	    if ( (strncmp(ids[c].id, parent, len) == 0) &&
+		 (ids[c].id[len] == '\0') )
+	    {
+		*gene_index = window->last_gene = g;
+		*id_index = window->last_id = c;
+		return true;
+	    }
+	}
+    }
+    return false;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Filter the GFF file and insert explicit intron and upstream
+ *      (promoter) regions, returning a FILE pointer to a BED file
+ *      containing all features of interest.
+ *      If augmented_filename is NULL, features only go to the sorter.
+ *      If genes is not NULL, genes with upstream regions are added to
+ *      it for the feature index.
+ *
+ *      Subfeatures are grouped under their gene by Parent ID, so the GFF
+ *      need not have ### separators, and need only be sorted so that
+ *      each subfeature precedes the first feature starting past the end
+ *      of its gene.  Both gene-grouped and position-sorted GFFs qualify.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2021-04-15  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Make the BED file optional
+ *  2026-10-16  Jason Bacon Record genes for regenerating upstream regions
+ *  2026-10-16  Jason Bacon Buffer the BED file with fast_write_t
+ *  2026-10-16  Jason Bacon Group subfeatures by Parent instead of ###
+ ***************************************************************************/
+
+int     gff3_augment(FILE *gff3_stream, const char *upstream_boundaries,
+		    const char *augmented_filename, feature_sort_t *sorter,
+		    upstream_genes_t *genes)
+
+{
+    augment_out_t   out;
+    bl_bed_t    bed_feature = BL_BED_INIT;
+    bl_gff3_t    gff3_feature;
+    char        *feature,
+		*parent,
+		*chrom;
+    bl_pos_list_t      pos_list = BL_POS_LIST_INIT;
+    int         status = EX_OK;
+    
+    if ( augmented_filename == NULL )
+	out.bed_stream = NULL;
+    else if ( (out.bed_stream = fopen(augmented_filename, "w")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot write temp GFF: %s\n",
+		strerror(errno));
+	return EX_CANTCREAT;
+    }
+    else
+    {
+	fprintf(out.bed_stream, "#CHROM\tFirst\tLast+1\tStrand+Feature\n");
+	fast_write_open(&out.bed, out.bed_stream);
+    }
+    out.sorter = sorter;
+    out.genes = genes;
+    memset(&out.window, 0, sizeof(out.window));
+    
+    upstream_pos_list(&pos_list, upstream_boundaries);
+    labels_init(&out, &pos_list);
+
+    // Write all of the first 4 fields to the feature file
+    // Done within bl_gff3_to_bed() now
+    //bl_bed_set_fields(&bed_feature, 6);
+    //bl_bed_set_score(&bed_feature, 0);
+    
+    fputs("Augmenting GFF3 data...\n", stderr);
+    bl_gff3_skip_header(gff3_stream);
+    bl_gff3_init(&gff3_feature);
+    while ( bl_gff3_read(&gff3_feature, gff3_stream, BL_GFF3_FIELD_ALL) == BL_READ_OK )
+    {
+	feature = BL_GFF3_TYPE(&gff3_feature);
+	// No gene spans a ###, so write them all
+	if ( (strcmp(feature, "###") == 0) && (out.window.count != 0) )
+	    augment_flush_genes(&out, &pos_list, INT64_MAX);
+	// FIXME: Create a --autosomes-only flag to activate this check
+	else if ( !xt_strisint(BL_GFF3_SEQID(&gff3_feature), 10) )
+	    continue;
+	else if ( strcmp(feature, "###") == 0 )
+	    augment_end_block(&out);
+	else
+	{
+	    // Write the genes this feature is past
+	    chrom = BL_GFF3_SEQID(&gff3_feature);
+	    if ( out.window.count != 0 )
+		augment_flush_genes(&out, &pos_list,
+				    strcmp(chrom, out.window.chrom) != 0 ?
+				    INT64_MAX : BL_GFF3_START(&gff3_feature) - 1);
+
+	    parent = BL_GFF3_FEATURE_PARENT(&gff3_feature);
+	    if ( (parent != NULL) && (*parent != '\0') &&
+		 augment_add_subfeature(&out, &gff3_feature) )
+		continue;
+	    
+	    /*
+	     *  Top-level genes wait for their subfeatures.  Other top-level
+	     *  features, and subfeatures of anything but an open gene, are
+	     *  blocks by themselves.
+	     */
+	    if ( ((parent == NULL) || (*parent == '\0')) &&
+		 (strstr(feature, "gene") != NULL) )
+		augment_open_gene(&out, &gff3_feature);
+	    else if ( strcmp(feature, "chromosome") != 0 )
+	    {
+		bl_gff3_to_bed(&gff3_feature, &bed_feature);
+		augment_write(&out, &bed_feature);
+		augment_end_block(&out);
+	    }
+	}
+    }
+    augment_flush_genes(&out, &pos_list, INT64_MAX);
+    bl_gff3_free(&gff3_feature);
+    xt_fclose(gff3_stream);
+    if ( (out.bed_stream != NULL) &&
+	 ((fast_write_close(&out.bed) != EX_OK) |
+	  (fclose(out.bed_stream) != 0)) )
+    {
+	fprintf(stderr, "peak-classifier: Error writing %s.\n",
+		augmented_filename);
+	status = EX_IOERR;
+    }
+    window_free(&out.window);
+    labels_free(&out);
+    bl_pos_list_free(&pos_list);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write one augmented feature to the BED file and pass it to the
+ *      sorter, if any
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Format with bed_format()
+ ***************************************************************************/
+
+void    augment_write(augment_out_t *out, bl_bed_t *bed_feature)
+
+{
+    int     status;
+    char    *p;
+    
+    // Features from bl_gff3_to_bed() always have 6 fields
+    if ( out->bed_stream != NULL )
+    {
+	p = fast_write_reserve(&out->bed);
+	p = bed_format(p, BL_BED_CHROM(bed_feature),
+		       BL_BED_CHROM_START(bed_feature),
+		       BL_BED_CHROM_END(bed_feature), BL_BED_NAME(bed_feature),
+		       strlen(BL_BED_NAME(bed_feature)),
+		       BL_BED_SCORE(bed_feature), BL_BED_STRAND(bed_feature));
+	fast_write_commit(&out->bed, p);
+    }
+    if ( (out->sorter != NULL) &&
+	 ((status = feature_sort_add(out->sorter, bed_feature)) != EX_OK) )
+    {
+	fputs("augment_write(): feature_sort_add() failed.\n", stderr);
+	exit(status);
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write a generated intron or upstream region.  Unlike
+ *      augment_write(), no bl_bed_t is filled in and the name is not
+ *      looked up, since both are known in advance.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    augment_write_region(augment_out_t *out, const char *chrom,
+			     uint32_t chrom_num, int64_t start, int64_t end,
+			     const augment_label_t *label, char strand)
+
+{
+    feature_rec_t   rec;
+    char            *p;
+    int             status;
+
+    if ( out->bed_stream != NULL )
+    {
+	p = fast_write_reserve(&out->bed);
+	p = bed_format(p, chrom, start, end, label->name, label->len, 0,
+		       strand);
+	fast_write_commit(&out->bed, p);
+    }
+    if ( out->sorter != NULL )
+    {
+	rec.start = start;
+	rec.end = end;
+	rec.chrom = chrom_num;
+	rec.name = label->num;
+	rec.strand = strand;
+	if ( (status = feature_sort_add_rec(out->sorter, &rec)) != EX_OK )
+	{
+	    fputs("augment_write_region(): feature_sort_add_rec() failed.\n",
+		  stderr);
+	    exit(status);
+	}
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      End a gene or other top-level feature block.  Each block is a
+ *      separate sort run.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    augment_end_block(augment_out_t *out)
+
+{
+    int     status;
+    char    *p;
+    
+    if ( out->bed_stream != NULL )
+    {
+	p = fast_write_reserve(&out->bed);
+	fast_write_commit(&out->bed, fast_format_str(p, "###\n", 4));
+    }
+    if ( (out->sorter != NULL) &&
+	 ((status = feature_sort_end_run(out->sorter)) != EX_OK) )
+    {
+	fputs("augment_end_block(): feature_sort_end_run() failed.\n", stderr);
+	exit(status);
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add a top-level gene to the window, to be written with its
+ *      subfeatures and upstream regions once the GFF moves past it.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    augment_open_gene(augment_out_t *out, bl_gff3_t *gff3_feature)
+
+{
+    augment_window_t    *window = &out->window;
+    augment_gene_t      *gene;
+    char                *id;
+
+    if ( window->count == 0 )
+    {
+	strncpy(window->chrom, BL_GFF3_SEQID(gff3_feature),
+		BL_CHROM_MAX_CHARS);
+	window->chrom[BL_CHROM_MAX_CHARS] = '\0';
+	window->chrom_num = out->sorter == NULL ? 0 :
+			    feature_sort_chrom(out->sorter, window->chrom);
+    }
+    if ( window->count == window->array_size )
+    {
+	window->array_size = window->array_size == 0 ? 16 :
+			     window->array_size * 2;
+	window->genes = xt_realloc(window->genes, window->array_size,
+				   sizeof(*window->genes));
+    }
+    gene = &window->genes[window->count++];
+    memset(gene, 0, sizeof(*gene));
+    // BED start is 0-based, GFF is 1-based, and both ends are the same
+    gene->start = BL_GFF3_START(gff3_feature) - 1;
+    gene->end = BL_GFF3_END(gff3_feature);
+    gene->strand = BL_GFF3_STRAND(gff3_feature);
+    gene->type = window_type(out, BL_GFF3_TYPE(gff3_feature));
+    // A gene with no ID can have no subfeatures, but keeps ids[0]
+    id = BL_GFF3_FEATURE_ID(gff3_feature);
+    gene_add_id(gene, id == NULL ? "" : id);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Attach a subfeature to the open gene containing its parent.
+ *      Returns false if the parent is not part of an open gene, in which
+ *      case nothing is done.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+bool    augment_add_subfeature(augment_out_t *out, bl_gff3_t *subfeature)
+
+{
+    augment_window_t    *window = &out->window;
+    augment_gene_t      *gene;
+    augment_sub_t       *sub;
+    size_t              g,
+			parent;
+    char                *id;
+
+    if ( (window->count == 0) ||
+	 (strcmp(BL_GFF3_SEQID(subfeature), window->chrom) != 0) ||
+	 !window_find_parent(window, BL_GFF3_FEATURE_PARENT(subfeature),
+			     &g, &parent) )
+	return false;
+
+    gene = &window->genes[g];
+    if ( gene->sub_count == gene->sub_array_size )
+    {
+	gene->sub_array_size = gene->sub_array_size == 0 ? 32 :
+			       gene->sub_array_size * 2;
+	gene->subs = xt_realloc(gene->subs, gene->sub_array_size,
+				sizeof(*gene->subs));
+    }
+    sub = &gene->subs[gene->sub_count++];
+    sub->start = BL_GFF3_START(subfeature) - 1;
+    sub->end = BL_GFF3_END(subfeature);
+    sub->strand = BL_GFF3_STRAND(subfeature);
+    sub->type = window_type(out, BL_GFF3_TYPE(subfeature));
+    sub->exon = strcmp(BL_GFF3_TYPE(subfeature), "exon") == 0;
+    sub->parent = parent;
+    // Transcripts are parents of exons
+    if ( ((id = BL_GFF3_FEATURE_ID(subfeature)) != NULL) && (*id != '\0') )
+	gene_add_id(gene, id);
+    return true;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write and close the open genes ending at or before pos, in GFF
+ *      order.  INT64_MAX writes all of them.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    augment_flush_genes(augment_out_t *out, bl_pos_list_t *pos_list,
+			    int64_t pos)
+
+{
+    augment_window_t    *window = &out->window;
+    size_t              c,
+			kept;
+
+    for (c = kept = 0; c < window->count; ++c)
+    {
+	if ( window->genes[c].end <= pos )
+	{
+	    augment_write_gene(out, &window->genes[c], pos_list);
+	    gene_free(&window->genes[c]);
+	}
+	else
+	    window->genes[kept++] = window->genes[c];
+    }
+    if ( kept != window->count )
+    {
+	window->count = kept;
+	window->last_gene = SIZE_MAX;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write a gene block: the gene, its upstream regions, and its
+ *      subfeatures in GFF order, with an intron between each exon and
+ *      the previous exon of the same parent
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2021-04-19  Jason Bacon Begin as gff3_process_subfeatures()
+ *  2026-10-16  Jason Bacon Write introns with augment_write_region()
+ *  2026-10-16  Jason Bacon Write a gene collected by Parent ID
+ ***************************************************************************/
+
+void    augment_write_gene(augment_out_t *out, augment_gene_t *gene,
+			   bl_pos_list_t *pos_list)
+
+{
+    augment_window_t    *window = &out->window;
+    augment_sub_t       *sub;
+    augment_id_t        *parent;
+    char                strand;
+    
+    augment_write_region(out, window->chrom, window->chrom_num, gene->start,
+			 gene->end, &window->types[gene->type], gene->strand);
+    // Write out upstream regions for likely regulatory elements
+    if ( gene->strand == '+' )
+	generate_upstream_features(out, window->chrom, gene->start, gene->end,
+				   gene->strand, pos_list);
+
+    strand = gene->strand;
+    for (sub = gene->subs; sub < gene->subs + gene->sub_count; ++sub)
+    {
+	// Generate introns between exons
+	if ( sub->exon )
+	{
+	    parent = &gene->ids[sub->parent];
+	    // Strand of the previous subfeature, as before grouping by Parent
+	    if ( parent->exon_seen )
+		augment_write_region(out, window->chrom, window->chrom_num,
+				     parent->exon_end, sub->start,
+				     &out->intron, strand);
+	    parent->exon_end = sub->end;
+	    parent->exon_seen = true;
+	}
+	augment_write_region(out, window->chrom, window->chrom_num,
+			     sub->start, sub->end, &window->types[sub->type],
+			     sub->strand);
+	strand = sub->strand;
+    }
+
+    if ( gene->strand == '-' )
+	generate_upstream_features(out, window->chrom, gene->start, gene->end,
+				   gene->strand, pos_list);
+    augment_end_block(out);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Generate upstream region features for a gene with the given BED
+ *      coordinates and a list of upstream distances
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2021-04-17  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Compute regions with upstream_region() and
+ *                          record the gene
+ *  2026-10-16  Jason Bacon Write with augment_write_region() and the
+ *                          precomputed labels
+ *  2026-10-16  Jason Bacon Take the gene position instead of bl_gff3_t
+ ***************************************************************************/
+
+void    generate_upstream_features(augment_out_t *out, const char *chrom,
+				   int64_t start, int64_t end, char strand,
+				   bl_pos_list_t *pos_list)
+
+{
+    size_t          c;
+    uint32_t        chrom_num;
+    int64_t         tss,
+		    region_start,
+		    region_end;
+    
+    chrom_num = out->sorter == NULL ? 0 : feature_sort_chrom(out->sorter, chrom);
+    tss = strand == '+' ? start : end;
+    if ( (out->genes != NULL) && (out->sorter != NULL) )
+	upstream_genes_add(out->genes, chrom_num, tss, strand);
+
+    // Regions are written in order of position either way
+    if ( strand == '-' )
+    {
+	for (c = 0; c < out->upstream_count; ++c)
+	{
+	    upstream_region(tss, strand, pos_list, c, &region_start,
+			    &region_end);
+	    augment_write_region(out, chrom, chrom_num, region_start,
+				 region_end, &out->upstream[c], strand);
+	}
+    }
+    else
+    {
+	for (c = out->upstream_count; c-- > 0; )
+	{
+	    upstream_region(tss, strand, pos_list, c, &region_start,
+			    &region_end);
+	    augment_write_region(out, chrom, chrom_num, region_start,
+				 region_end, &out->upstream[c], strand);
+	}
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Check an --upstream-boundaries argument.  It must be a
+ *      comma-separated list of positions with no space.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+bool    upstream_boundaries_valid(const char *upstream_boundaries)
+
+{
+    const char  *p;
+    
+    for (p = upstream_boundaries; *p != '\0'; ++p)
+	if ( !isdigit(*p) && (*p != ',') )
+	    return false;
+    return true;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Convert an --upstream-boundaries list to the sorted positions
+ *      used by generate_upstream_features().  Upstream features are 1
+ *      to first pos, first + 1 to second, etc., so 0 is added.  An
+ *      empty list means no upstream features.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Allow an empty list for --tss-distance
+ ***************************************************************************/
+
+void    upstream_pos_list(bl_pos_list_t *pos_list,
+			  const char *upstream_boundaries)
+
+{
+    // An empty list leaves only the 0, but from_csv() allocates the list
+    if ( *upstream_boundaries == '\0' )
+	bl_pos_list_from_csv(pos_list, "0", MAX_UPSTREAM_BOUNDARIES);
+    else
+    {
+	bl_pos_list_from_csv(pos_list, upstream_boundaries,
+			     MAX_UPSTREAM_BOUNDARIES);
+	bl_pos_list_add_position(pos_list, 0);
+    }
+    bl_pos_list_sort(pos_list, BL_POS_LIST_ASCENDING);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Compute BED coordinates of upstream region c, between positions
+ *      c and c + 1 of pos_list, for a gene with the given TSS and
+ *      strand.  tss is the BED start of a + strand gene or the BED end
+ *      of a - strand gene.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    upstream_region(int64_t tss, char strand, bl_pos_list_t *pos_list,
+			int c, int64_t *start, int64_t *end)
+
+{
+    if ( strand == '+' )
+    {
+	*start = tss - BL_POS_LIST_POSITIONS_AE(pos_list, c + 1);
+	*end = tss - BL_POS_LIST_POSITIONS_AE(pos_list, c);
+    }
+    else
+    {
+	*start = tss + BL_POS_LIST_POSITIONS_AE(pos_list, c);
+	*end = tss + BL_POS_LIST_POSITIONS_AE(pos_list, c + 1);
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Set up the upstream regions that --tss-distance computes from
+ *      the TSS at classification time instead of storing them in the
+ *      feature index.  Bounds and names are those upstream_region() and
+ *      generate_upstream_features() would have used.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    tss_regions_init(tss_regions_t *regions,
+			 const char *upstream_boundaries)
+
+{
+    bl_pos_list_t   pos_list = BL_POS_LIST_INIT;
+    char            name[BL_BED_NAME_MAX_CHARS + 1];
+    size_t          c;
+
+    upstream_pos_list(&pos_list, upstream_boundaries);
+    regions->count = BL_POS_LIST_COUNT(&pos_list) - 1;
+    regions->bounds = xt_malloc(regions->count + 1, sizeof(*regions->bounds));
+    regions->region_names = xt_malloc(regions->count,
+				      sizeof(*regions->region_names));
+    regions->names = xt_malloc(regions->count, sizeof(*regions->names));
+    for (c = 0; c <= regions->count; ++c)
+	regions->bounds[c] = BL_POS_LIST_POSITIONS_AE(&pos_list, c);
+    for (c = 0; c < regions->count; ++c)
+    {
+	snprintf(name, BL_BED_NAME_MAX_CHARS, "upstream%" PRId64,
+		 regions->bounds[c + 1]);
+	regions->region_names[c] = strdup(name);
+	regions->names[c] = 0;
+    }
+    bl_pos_list_free(&pos_list);
+}
+
+
+void    tss_regions_free(tss_regions_t *regions)
+
+{
+    size_t  c;
+
+    for (c = 0; c < regions->count; ++c)
+	free(regions->region_names[c]);
+    free(regions->region_names);
+    free(regions->names);
+    free(regions->bounds);
+    regions->count = 0;
+}
+
+
+void    upstream_genes_add(upstream_genes_t *genes, uint32_t chrom,
+			   int64_t tss, char strand)
+
+{
+    upstream_gene_t *gene;
+
+    if ( genes->count == genes->array_size )
+    {
+	genes->array_size = genes->array_size == 0 ? 4096 :
+			    genes->array_size * 2;
+	genes->genes = xt_realloc(genes->genes, genes->array_size,
+				  sizeof(*genes->genes));
+    }
+    gene = &genes->genes[genes->count++];
+    memset(gene, 0, sizeof(*gene));     // No garbage padding in the index
+    gene->tss = tss;
+    gene->chrom = chrom;
+    gene->strand = strand;
+}
+
+
+void    upstream_genes_free(upstream_genes_t *genes)
+
+{
+    free(genes->genes);
+    *genes = (upstream_genes_t)UPSTREAM_GENES_INIT;
+}
@@ -0,0 +1,155 @@
+#ifndef _AUGMENT_H_
+#define _AUGMENT_H_
+
+#define MAX_UPSTREAM_BOUNDARIES 64
+#define DEFAULT_UPSTREAM_BOUNDARIES \
+    "1000,10000,100000,200000,300000,400000,500000,600000,700000,800000"
+// Added to the GFF stem for the --tss-distance index, which has no regions
+#define TSS_INDEX_SUFFIX        "-tss"
+
+/*
+ *  A gene for which upstream regions are generated.  The regions
+ *  depend only on the TSS, strand, and upstream boundaries, so the
+ *  feature index stores these to regenerate the regions for new
+ *  boundaries without reprocessing the GFF.
+ */
+
+typedef struct
+{
+    int64_t         tss;        // Upstream regions are measured from here
+    uint32_t        chrom;      // Sorter or index chromosome number
+    char            strand;
+}   upstream_gene_t;
+
+typedef struct
+{
+    upstream_gene_t *genes;
+    size_t          count;
+    size_t          array_size;
+}   upstream_genes_t;
+
+#define UPSTREAM_GENES_INIT { NULL, 0, 0 }
+
+/*
+ *  A generated feature name, formatted once rather than per feature,
+ *  and its sorter name number
+ */
+
+typedef struct
+{
+    char            *name;
+    size_t          len;
+    uint16_t        num;
+}   augment_label_t;
+
+/*
+ *  An ID within an open gene: the gene's own or a subfeature's.  While
+ *  the gene is written, exons are chained into introns by Parent, so
+ *  each ID also tracks the end of the last exon it was the parent of.
+ */
+
+typedef struct
+{
+    char            *id;
+    int64_t         exon_end;
+    bool            exon_seen;
+}   augment_id_t;
+
+// A subfeature held until its gene is written
+typedef struct
+{
+    int64_t         start;          // BED coordinates
+    int64_t         end;
+    size_t          type;           // Index into augment_window_t types
+    size_t          parent;         // Index into the gene's ids, for exons
+    char            strand;
+    bool            exon;
+}   augment_sub_t;
+
+typedef struct
+{
+    int64_t         start;          // BED coordinates
+    int64_t         end;
+    size_t          type;
+    char            strand;
+    augment_id_t    *ids;           // ids[0] is the gene's own ID
+    size_t          id_count;
+    size_t          id_array_size;
+    augment_sub_t   *subs;
+    size_t          sub_count;
+    size_t          sub_array_size;
+}   augment_gene_t;
+
+/*
+ *  Genes that may still have subfeatures to come.  Subfeatures are
+ *  attached to their gene through their Parent attributes, so neither
+ *  ### separators nor grouping of subfeatures under their gene is
+ *  required.  A gene is written once the GFF moves past its end, to
+ *  another chromosome, or to a ### line, so only the genes overlapping
+ *  the current position are held in memory.
+ */
+
+typedef struct
+{
+    char            chrom[BL_CHROM_MAX_CHARS + 1];
+    uint32_t        chrom_num;      // Sorter chromosome number
+    augment_gene_t  *genes;         // In GFF order
+    size_t          count;
+    size_t          array_size;
+    augment_label_t *types;         // Feature types seen so far
+    size_t          type_count;
+    size_t          type_array_size;
+    size_t          last_gene;      // Where the last Parent was found
+    size_t          last_id;
+}   augment_window_t;
+
+/*
+ *  Destinations for augmented features: the augmented BED file, which
+ *  keeps the ### block separators for extract-genes, and optionally a
+ *  sorter feeding the feature index.  Either may be NULL.  Genes are
+ *  recorded in genes if it and the sorter are not NULL.
+ */
+
+typedef struct
+{
+    FILE            *bed_stream;
+    fast_write_t    bed;            // Buffers bed_stream
+    feature_sort_t  *sorter;
+    upstream_genes_t *genes;
+    augment_label_t intron;
+    augment_label_t *upstream;      // Region c of pos_list is upstream[c]
+    size_t          upstream_count;
+    augment_window_t window;
+}   augment_out_t;
+
+/* augment.c */
+int     gff3_augment(FILE *gff3_stream, const char *upstream_boundaries,
+		     const char *augmented_filename, feature_sort_t *sorter,
+		     upstream_genes_t *genes);
+void    augment_write(augment_out_t *out, bl_bed_t *bed_feature);
+void    augment_write_region(augment_out_t *out, const char *chrom,
+			     uint32_t chrom_num, int64_t start, int64_t end,
+			     const augment_label_t *label, char strand);
+void    augment_end_block(augment_out_t *out);
+void    augment_open_gene(augment_out_t *out, bl_gff3_t *gff3_feature);
+bool    augment_add_subfeature(augment_out_t *out, bl_gff3_t *subfeature);
+void    augment_flush_genes(augment_out_t *out, bl_pos_list_t *pos_list,
+			    int64_t pos);
+void    augment_write_gene(augment_out_t *out, augment_gene_t *gene,
+			   bl_pos_list_t *pos_list);
+void    generate_upstream_features(augment_out_t *out, const char *chrom,
+				   int64_t start, int64_t end, char strand,
+				   bl_pos_list_t *pos_list);
+bool    upstream_boundaries_valid(const char *upstream_boundaries);
+void    upstream_pos_list(bl_pos_list_t *pos_list,
+			  const char *upstream_boundaries);
+void    upstream_region(int64_t tss, char strand, bl_pos_list_t *pos_list,
+			int c, int64_t *start, int64_t *end);
+void    upstream_genes_add(upstream_genes_t *genes, uint32_t chrom,
+			   int64_t tss, char strand);
+void    upstream_genes_free(upstream_genes_t *genes);
+void    tss_regions_init(tss_regions_t *regions,
+			 const char *upstream_boundaries);
+void    tss_regions_free(tss_regions_t *regions);
+
+#endif  // _AUGMENT_H_
@@ -0,0 +1,321 @@
+/***************************************************************************
+ *  Description:
+ *      Batch mode.  Classify every peak file listed in a manifest
+ *      against one mapped feature set, so the index is mapped once
+ *      per cohort instead of once per sample and parameter set.
+ *      Samples are independent, so with multiple threads each worker
+ *      claims whole samples and runs the ordinary serial sweep on them.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <xtend/mem.h>
+#include <xtend/file.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "overlaps-bin.h"
+#include "rank.h"
+#include "batch.h"
+#include "decompress.h"
+
+/***************************************************************************
+ *  Description:
+ *      Read a batch manifest.  Blank lines and lines beginning with
+ *      '#' are ignored.  Overlap options on a line start from
+ *      default_params, i.e. those given on the command line.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     batch_read_manifest(batch_t *batch, const char *manifest_filename,
+			    overlap_params_t *default_params)
+
+{
+    FILE        *manifest_stream;
+    char        *line = NULL,
+		*fields[BATCH_MAX_FIELDS],
+		*save,
+		*p;
+    size_t      line_size = 0,
+		line_num = 0,
+		c;
+    int         field_count,
+		f,
+		used,
+		status = EX_OK;
+    batch_job_t *job;
+
+    if ( (manifest_stream = fopen(manifest_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		manifest_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+
+    while ( (status == EX_OK) &&
+	    (getline(&line, &line_size, manifest_stream) != -1) )
+    {
+	++line_num;
+	for (field_count = 0, p = strtok_r(line, " \t\r\n", &save);
+	     (p != NULL) && (field_count < BATCH_MAX_FIELDS);
+	     p = strtok_r(NULL, " \t\r\n", &save))
+	    fields[field_count++] = p;
+	if ( (field_count == 0) || (*fields[0] == '#') )
+	    continue;
+	if ( (field_count < 2) || (p != NULL) ||
+	     !xt_valid_extension(fields[0], ".bed") ||
+	     !(xt_valid_extension(fields[1], ".tsv") ||
+	       xt_valid_extension(fields[1], OVERLAPS_BIN_EXT)) )
+	{
+	    fprintf(stderr, "peak-classifier: %s line %zu: "
+		    "Expected peaks.bed overlaps.tsv [options].\n",
+		    manifest_filename, line_num);
+	    status = EX_DATAERR;
+	    break;
+	}
+
+	if ( batch->count == batch->array_size )
+	{
+	    batch->array_size = batch->array_size == 0 ? 64 :
+				batch->array_size * 2;
+	    batch->jobs = xt_realloc(batch->jobs, batch->array_size,
+				     sizeof(*batch->jobs));
+	}
+	job = &batch->jobs[batch->count];
+	memset(job, 0, sizeof(*job));
+	job->params = *default_params;
+	job->params.binary_output = xt_valid_extension(fields[1],
+						       OVERLAPS_BIN_EXT);
+	job->status = EX_OK;
+	for (f = 2; f < field_count; f += used)
+	{
+	    if ( (used = overlap_params_parse(&job->params, field_count,
+					      fields, f)) <= 0 )
+	    {
+		fprintf(stderr, "peak-classifier: %s line %zu: "
+			"Invalid option %s.\n", manifest_filename, line_num,
+			fields[f]);
+		status = EX_DATAERR;
+		break;
+	    }
+	}
+	job->own_rank_features = job->params.rank_features !=
+				 default_params->rank_features;
+	if ( status != EX_OK )
+	{
+	    if ( job->own_rank_features )
+		free(job->params.rank_features);
+	    break;
+	}
+
+	// Two jobs writing the same file at once would corrupt it
+	for (c = 0; c < batch->count; ++c)
+	{
+	    if ( strcmp(batch->jobs[c].overlaps_filename, fields[1]) == 0 )
+	    {
+		fprintf(stderr, "peak-classifier: %s line %zu: "
+			"%s is already an output.\n", manifest_filename,
+			line_num, fields[1]);
+		status = EX_DATAERR;
+		break;
+	    }
+	}
+	if ( status != EX_OK )
+	{
+	    if ( job->own_rank_features )
+		free(job->params.rank_features);
+	    break;
+	}
+
+	job->peak_filename = strdup(fields[0]);
+	job->overlaps_filename = strdup(fields[1]);
+	if ( (job->peak_filename == NULL) || (job->overlaps_filename == NULL) )
+	{
+	    fputs("peak-classifier: batch_read_manifest(): "
+		  "Could not allocate filenames.\n", stderr);
+	    exit(EX_UNAVAILABLE);
+	}
+	++batch->count;
+    }
+    free(line);
+    fclose(manifest_stream);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify one manifest entry
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static int  batch_classify_job(feature_set_t *fs, batch_job_t *job)
+
+{
+    FILE    *peak_stream,
+	    *overlaps_stream;
+    int     status;
+
+    // Other jobs occupy the remaining threads
+    if ( (peak_stream = decompress_fopen(job->peak_filename, 1)) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		job->peak_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    if ( (overlaps_stream = fopen(job->overlaps_filename, "w")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot create %s: %s\n",
+		job->overlaps_filename, strerror(errno));
+	xt_fclose(peak_stream);
+	return EX_CANTCREAT;
+    }
+
+    fprintf(stderr, "Classifying %s...\n", job->peak_filename);
+    if ( job->params.rank_features != NULL )
+    {
+	rank_init(&job->rank, job->params.rank_features, fs);
+	status = classify_peaks(fs, peak_stream, overlaps_stream,
+				&job->params, &job->rank, &job->counts);
+    }
+    else
+	status = classify_peaks(fs, peak_stream, overlaps_stream,
+				&job->params, NULL, &job->counts);
+    if ( fclose(overlaps_stream) != 0 )
+    {
+	fprintf(stderr, "peak-classifier: Error writing %s: %s\n",
+		job->overlaps_filename, strerror(errno));
+	status = EX_IOERR;
+    }
+    xt_fclose(peak_stream);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Worker thread: claim jobs in manifest order until none are left
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void *batch_worker(void *arg)
+
+{
+    batch_t     *batch = arg;
+    batch_job_t *job;
+
+    for (;;)
+    {
+	pthread_mutex_lock(&batch->lock);
+	if ( batch->next == batch->count )
+	{
+	    pthread_mutex_unlock(&batch->lock);
+	    break;
+	}
+	job = &batch->jobs[batch->next++];
+	pthread_mutex_unlock(&batch->lock);
+
+	job->status = batch_classify_job(batch->fs, job);
+    }
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify all jobs in the batch, up to threads at a time.  A
+ *      failed job does not stop the others.  Return EX_OK if all
+ *      succeeded, otherwise the status of the first failure.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     batch_classify(batch_t *batch, feature_set_t *fs, unsigned threads)
+
+{
+    pthread_t   *tids;
+    unsigned    t,
+		started;
+    size_t      c;
+
+    batch->fs = fs;
+    batch->next = 0;
+    if ( threads > batch->count )
+	threads = batch->count;
+    if ( threads <= 1 )
+	batch_worker(batch);
+    else
+    {
+	tids = xt_malloc(threads, sizeof(*tids));
+	for (t = started = 0; t < threads; ++t)
+	    if ( pthread_create(&tids[started], NULL, batch_worker, batch) == 0 )
+		++started;
+	// Finish the work in this thread if no workers could be created
+	if ( started == 0 )
+	    batch_worker(batch);
+	for (t = 0; t < started; ++t)
+	    pthread_join(tids[t], NULL);
+	free(tids);
+    }
+
+    // Print --rank summaries after all jobs, so they are not interleaved
+    for (c = 0; c < batch->count; ++c)
+    {
+	if ( (batch->jobs[c].status == EX_OK) &&
+	     (batch->jobs[c].params.rank_features != NULL) )
+	{
+	    printf("%s:\n", batch->jobs[c].overlaps_filename);
+	    rank_summary(&batch->jobs[c].rank, stdout);
+	}
+    }
+
+    for (c = 0; c < batch->count; ++c)
+    {
+	if ( batch->jobs[c].status != EX_OK )
+	{
+	    fprintf(stderr, "peak-classifier: Failed to classify %s.\n",
+		    batch->jobs[c].peak_filename);
+	    return batch->jobs[c].status;
+	}
+    }
+    return EX_OK;
+}
+
+
+void    batch_free(batch_t *batch)
+
+{
+    size_t  c;
+
+    for (c = 0; c < batch->count; ++c)
+    {
+	free(batch->jobs[c].peak_filename);
+	free(batch->jobs[c].overlaps_filename);
+	rank_free(&batch->jobs[c].rank);
+	if ( batch->jobs[c].own_rank_features )
+	    free(batch->jobs[c].params.rank_features);
+    }
+    free(batch->jobs);
+    batch->jobs = NULL;
+    batch->count = batch->array_size = batch->next = 0;
+}
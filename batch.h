@@ -0,0 +1,47 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+/*
+ *  Batch classification of many peak files against one mapped feature
+ *  set.  Each manifest line names a peak BED file and an output TSV,
+ *  or binary overlaps file if it ends in OVERLAPS_BIN_EXT, optionally
+ *  followed by overlap options that override the command line for that
+ *  line only:
+ *
+ *      sample1.bed sample1-overlaps.tsv
+ *      sample1.bed sample1-peak-20-overlaps.tsv --min-peak-overlap 0.2
+ *      sample1.bed sample1-filtered.tsv --rank exon,intron,upstream1000
+ */
+
+#define BATCH_MAX_FIELDS    16
+
+typedef struct
+{
+    char                *peak_filename;
+    char                *overlaps_filename;
+    overlap_params_t    params;
+    bool                own_rank_features;  // --rank given on this line
+    rank_t              rank;
+    classify_counts_t   counts;
+    int                 status;
+}   batch_job_t;
+
+typedef struct
+{
+    batch_job_t         *jobs;
+    size_t              count;
+    size_t              array_size;
+    size_t              next;       // Next job to claim
+    feature_set_t       *fs;
+    pthread_mutex_t     lock;
+}   batch_t;
+
+#define BATCH_INIT  { NULL, 0, 0, 0, NULL, PTHREAD_MUTEX_INITIALIZER }
+
+/* batch.c */
+int     batch_read_manifest(batch_t *batch, const char *manifest_filename,
+			    overlap_params_t *default_params);
+int     batch_classify(batch_t *batch, feature_set_t *fs, unsigned threads);
+void    batch_free(batch_t *batch);
+
+#endif  // _BATCH_H_
@@ -0,0 +1,848 @@
+/***************************************************************************
+ *  Description:
+ *      In-process peak classification.  The sorted augmented feature
+ *      list is loaded into per-chromosome arrays, and each chromosome's
+ *      peaks are swept against its features in a single pass, replacing
+ *      bedtools intersect -wao and the awk reformatting that followed it.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <xtend/mem.h>
+#include <xtend/math.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "fast-write.h"
+#include "overlap-kernel.h"
+#include "overlaps-bin.h"
+#include "peak-reader.h"
+#include "rank.h"
+
+/***************************************************************************
+ *  Description:
+ *      Load a sorted augmented feature BED file into per-chromosome
+ *      arrays.  Features must be grouped by chromosome and sorted by
+ *      start, end, and name within each, as produced by the sort stage.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Store features as parallel arrays
+ ***************************************************************************/
+
+int     feature_set_load(feature_set_t *fs, FILE *feature_stream)
+
+{
+    bl_bed_t            bed_feature = BL_BED_INIT;
+    chrom_features_t    *chrom = NULL;
+    size_t              c;
+
+    while ( bl_bed_read(&bed_feature, feature_stream, BL_BED_FIELD_ALL) != EOF )
+    {
+	if ( (chrom == NULL) ||
+	     (strcmp(chrom->chrom, BL_BED_CHROM(&bed_feature)) != 0) )
+	    chrom = feature_set_add_chrom(fs, BL_BED_CHROM(&bed_feature));
+
+	// Only a few dozen distinct feature names, so linear search is fine
+	for (c = 0; (c < fs->name_count) &&
+		    (strcmp(fs->names[c], BL_BED_NAME(&bed_feature)) != 0); ++c)
+	    ;
+	if ( c == fs->name_count )
+	{
+	    if ( fs->name_count == USHRT_MAX )
+	    {
+		fputs("feature_set_load(): Too many distinct feature names.\n",
+		      stderr);
+		return EX_DATAERR;
+	    }
+	    if ( fs->name_count == fs->name_array_size )
+	    {
+		fs->name_array_size = fs->name_array_size == 0 ? 64 :
+				      fs->name_array_size * 2;
+		fs->names = xt_realloc(fs->names, fs->name_array_size,
+				       sizeof(*fs->names));
+	    }
+	    fs->names[fs->name_count++] = strdup(BL_BED_NAME(&bed_feature));
+	}
+	chrom_features_add(chrom, BL_BED_CHROM_START(&bed_feature),
+			   BL_BED_CHROM_END(&bed_feature), c,
+			   BL_BED_STRAND(&bed_feature));
+    }
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append an empty chromosome to a feature set and return it
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+chrom_features_t *feature_set_add_chrom(feature_set_t *fs, const char *chrom)
+
+{
+    chrom_features_t    *new_chrom;
+
+    if ( fs->count == fs->array_size )
+    {
+	fs->array_size = fs->array_size == 0 ? 64 : fs->array_size * 2;
+	fs->chroms = xt_realloc(fs->chroms, fs->array_size,
+				sizeof(*fs->chroms));
+    }
+    new_chrom = &fs->chroms[fs->count++];
+    memset(new_chrom, 0, sizeof(*new_chrom));
+    strncpy(new_chrom->chrom, chrom, BL_CHROM_MAX_CHARS);
+    return new_chrom;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append one feature to a chromosome.  Features must be added in
+ *      sorted order.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    chrom_features_add(chrom_features_t *chrom, int64_t start, int64_t end,
+			   unsigned short name, char strand)
+
+{
+    size_t  f;
+
+    if ( chrom->count == chrom->array_size )
+    {
+	chrom->array_size = chrom->array_size == 0 ? 1024 :
+			    chrom->array_size * 2;
+	chrom->starts = xt_realloc(chrom->starts, chrom->array_size,
+				   sizeof(*chrom->starts));
+	chrom->ends = xt_realloc(chrom->ends, chrom->array_size,
+				 sizeof(*chrom->ends));
+	chrom->max_ends = xt_realloc(chrom->max_ends, chrom->array_size,
+				     sizeof(*chrom->max_ends));
+	chrom->names = xt_realloc(chrom->names, chrom->array_size,
+				  sizeof(*chrom->names));
+	chrom->strands = xt_realloc(chrom->strands, chrom->array_size,
+				    sizeof(*chrom->strands));
+    }
+    f = chrom->count++;
+    chrom->starts[f] = start;
+    chrom->ends[f] = end;
+    chrom->max_ends[f] = f == 0 ? end : XT_MAX(chrom->max_ends[f - 1], end);
+    chrom->names[f] = name;
+    chrom->strands[f] = strand;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the index of the first feature at or after low that ends
+ *      after pos, or chrom->count if there is none.  Every feature
+ *      before it ends at or before pos, so it cannot overlap anything
+ *      starting at pos or later.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+size_t  chrom_features_first_ending_after(chrom_features_t *chrom,
+			   size_t low, int64_t pos)
+
+{
+    size_t  high,
+	    mid;
+
+    // max_ends[] is nondecreasing
+    for (high = chrom->count; low < high; )
+    {
+	mid = low + (high - low) / 2;
+	if ( chrom->max_ends[mid] <= pos )
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    return low;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Free all memory allocated by feature_set_load() or
+ *      feature_index_map()
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Free names added to a mapped index
+ ***************************************************************************/
+
+void    feature_set_free(feature_set_t *fs)
+
+{
+    size_t  c;
+
+    // Features and names in a mapped index belong to the map
+    if ( fs->map != NULL )
+    {
+	munmap(fs->map, fs->map_size);
+	for (c = fs->map_name_count; c < fs->name_count; ++c)
+	    free(fs->names[c]);
+    }
+    else
+    {
+	for (c = 0; c < fs->count; ++c)
+	{
+	    free(fs->chroms[c].starts);
+	    free(fs->chroms[c].ends);
+	    free(fs->chroms[c].max_ends);
+	    free(fs->chroms[c].names);
+	    free(fs->chroms[c].strands);
+	    free(fs->chroms[c].plus_tss);
+	    free(fs->chroms[c].minus_tss);
+	}
+	for (c = 0; c < fs->name_count; ++c)
+	    free(fs->names[c]);
+    }
+    free(fs->chroms);
+    free(fs->names);
+    *fs = (feature_set_t)FEATURE_SET_INIT;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the feature list for a chromosome, or NULL if the GFF
+ *      has no features on it.  There are few enough chromosomes that
+ *      a linear search is fine, and it is only done when the peak
+ *      chromosome changes.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+chrom_features_t *feature_set_find_chrom(feature_set_t *fs, const char *chrom)
+
+{
+    size_t  c;
+
+    for (c = 0; c < fs->count; ++c)
+	if ( strcmp(fs->chroms[c].chrom, chrom) == 0 )
+	    return &fs->chroms[c];
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add the --tss-distance region names to a feature set, so that
+ *      overlap output and --rank can refer to them like stored
+ *      features, and record their indexes in regions->names.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     feature_set_add_tss_names(feature_set_t *fs, tss_regions_t *regions)
+
+{
+    size_t  c;
+
+    if ( fs->name_count + regions->count > USHRT_MAX + 1 )
+    {
+	fprintf(stderr, "peak-classifier: More than %d feature names.\n",
+		USHRT_MAX + 1);
+	return EX_DATAERR;
+    }
+    fs->names = xt_realloc(fs->names, fs->name_count + regions->count,
+			   sizeof(*fs->names));
+    for (c = 0; c < regions->count; ++c)
+    {
+	regions->names[c] = fs->name_count;
+	fs->names[fs->name_count++] = strdup(regions->region_names[c]);
+    }
+    fs->name_array_size = fs->name_count;
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify all peaks in a BED stream, writing one line to
+ *      overlaps_stream for each peak/feature overlap.  Output matches
+ *      the former bedtools intersect -wao | awk pipeline, except that the
+ *      overlap column holds the bases of overlap, not the peak length.
+ *      With params->binary_output, the overlaps are written in the
+ *      binary format of overlaps-bin.h instead.  If overlaps_stream
+ *      is NULL, rank must not be, and only the rank counts are
+ *      updated, so memory use is independent of the number of peaks
+ *      and overlaps.  If counts is not NULL, peaks read and lines
+ *      written are added to it.  Peaks are read and parsed ahead by a
+ *      peak_reader_t thread.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Add binary output
+ *  2026-10-16  Jason Bacon Allow NULL overlaps_stream for --summary-only
+ *  2026-10-16  Jason Bacon Add TSS-distance column
+ *  2026-10-16  Jason Bacon Read peaks with peak_reader_t
+ *  2026-10-16  Jason Bacon Document the overlap column change
+ ***************************************************************************/
+
+int     classify_peaks(feature_set_t *fs, FILE *peak_stream,
+		       FILE *overlaps_stream, overlap_params_t *params,
+		       rank_t *rank, classify_counts_t *counts)
+
+{
+    peak_reader_t   reader;
+    const peak_line_t   *peak;
+    sweep_t     sweep = SWEEP_INIT;
+    int64_t     peak_start,
+		peak_end;
+    unsigned long   peaks = 0;
+    overlaps_bin_writer_t   writer;
+    int         status,
+		bin_status;
+
+    if ( (overlaps_stream != NULL) && params->binary_output )
+    {
+	if ( (status = overlaps_bin_open(&writer, overlaps_stream, fs->names,
+		    fs->name_count, overlaps_bin_flags(params, rank != NULL)))
+		    != EX_OK )
+	    return status;
+	overlaps_bin_write_header(&writer);
+	if ( rank != NULL )
+	{
+	    rank->emit = overlaps_bin_emit;
+	    rank->emit_arg = &writer;
+	}
+	else
+	{
+	    sweep.emit = overlaps_bin_emit;
+	    sweep.emit_arg = &writer;
+	}
+    }
+    // Ranked output matches filter-overlaps, which drops the header
+    else if ( (overlaps_stream != NULL) && (rank == NULL) )
+	fputs(params->tss_regions != NULL ? OVERLAPS_TSS_HEADER :
+	      OVERLAPS_HEADER, overlaps_stream);
+    peak_reader_open(&reader, peak_stream, true);
+    while ( (peak = peak_reader_next(&reader)) != NULL )
+    {
+	peak_start = peak->start;
+	peak_end = peak->end;
+	if ( params->midpoints_only )
+	{
+	    // Replace peak start/end with midpoint coordinates
+	    peak_start = (peak_start + peak_end) / 2;
+	    peak_end = peak_start + 1;
+	}
+	classify_peak(fs, &sweep, peak->chrom,
+		      peak_start, peak_end, params, rank, overlaps_stream);
+	++peaks;
+    }
+    status = peak_reader_close(&reader);
+    if ( rank != NULL )
+    {
+	rank_finish(rank, overlaps_stream);
+	rank->emit = NULL;
+    }
+    if ( (overlaps_stream != NULL) && params->binary_output )
+    {
+	bin_status = overlaps_bin_close(&writer, true);
+	if ( status == EX_OK )
+	    status = bin_status;
+    }
+    if ( counts != NULL )
+    {
+	counts->peaks += peaks;
+	counts->rows += rank != NULL ? rank_kept(rank) : sweep.rows;
+    }
+    sweep_free(&sweep);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Parse one overlap option at argv[c], from the command line or a
+ *      batch manifest.  Return the number of arguments used, 0 if
+ *      argv[c] is not an overlap option, or -1 if its value is invalid.
+ *      Minimum overlap fractions must be greater than 0 and at most 1,
+ *      as a fraction outside this range would match all features or
+ *      none.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Report out-of-range overlap fractions
+ ***************************************************************************/
+
+int     overlap_params_parse(overlap_params_t *params, int argc, char *argv[],
+			     int c)
+
+{
+    double  *value;
+    char    *end;
+
+    if ( strcmp(argv[c], "--min-either-overlap") == 0 )
+    {
+	params->min_either_overlap = true;
+	return 1;
+    }
+    else if ( strcmp(argv[c], "--midpoints") == 0 )
+    {
+	params->midpoints_only = true;
+	return 1;
+    }
+    else if ( strcmp(argv[c], "--rank") == 0 )
+    {
+	if ( (c + 1 >= argc) ||
+	     ((params->rank_features = rank_list_parse(argv[c + 1])) == NULL) )
+	    return -1;
+	return 2;
+    }
+    else if ( strcmp(argv[c], "--min-peak-overlap") == 0 )
+	value = &params->min_peak_overlap;
+    else if ( strcmp(argv[c], "--min-gff-overlap") == 0 )
+	value = &params->min_gff3_overlap;
+    else
+	return 0;
+
+    if ( c + 1 >= argc )
+	return -1;
+    *value = strtod(argv[c + 1], &end);
+    if ( (*end != '\0') || (*value <= 0.0) || (*value > 1.0) )
+    {
+	fprintf(stderr, "peak-classifier: %s must be a number greater than 0 "
+		"and at most 1.\n", argv[c]);
+	return -1;
+    }
+    return 2;
+}
+
+
+/*
+ *  Pass one overlap to the sweep's emit function, or write it as TSV
+ */
+
+static void sweep_write(sweep_t *sweep, FILE *overlaps_stream,
+			const char *chrom, int64_t peak_start, int64_t peak_end,
+			int64_t feature_start, int64_t feature_end,
+			const char *feature_name, char strand, int64_t overlap)
+
+{
+    overlap_t   record;
+
+    if ( sweep->emit != NULL )
+    {
+	record.chrom = chrom;
+	record.peak_start = peak_start;
+	record.peak_end = peak_end;
+	record.feature_start = feature_start;
+	record.feature_end = feature_end;
+	record.feature_name = feature_name;
+	record.overlap = overlap;
+	record.strand = strand;
+	record.tss_distance = sweep->tss_distance;
+	sweep->emit(sweep->emit_arg, &record);
+    }
+    else
+	overlap_write(overlaps_stream, chrom, peak_start, peak_end,
+		      feature_start, feature_end, feature_name, strand,
+		      overlap, sweep->tss_distance);
+    ++sweep->rows;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Find the TSS nearest to a peak among the genes the peak lies
+ *      upstream of or overlaps, i.e. the first + strand TSS after the
+ *      peak start and the last - strand TSS before the peak end.  The
+ *      distance is 0 if the peak contains the TSS.  Ties go to the +
+ *      strand.  Return false if neither is closer than the last
+ *      region bound, in which case the peak overlaps no region.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static bool tss_nearest(const chrom_features_t *features,
+			const tss_regions_t *regions,
+			int64_t peak_start, int64_t peak_end,
+			int64_t *tss, char *strand, int64_t *distance)
+
+{
+    size_t  low,
+	    high,
+	    mid;
+    int64_t d,
+	    limit = regions->bounds[regions->count];
+    bool    found = false;
+
+    for (low = 0, high = features->plus_tss_count; low < high; )
+    {
+	mid = low + (high - low) / 2;
+	if ( features->plus_tss[mid] <= peak_start )
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    if ( low < features->plus_tss_count )
+    {
+	d = XT_MAX(features->plus_tss[low] - peak_end, 0);
+	if ( d < limit )
+	{
+	    *tss = features->plus_tss[low];
+	    *strand = '+';
+	    *distance = d;
+	    found = true;
+	}
+    }
+
+    for (low = 0, high = features->minus_tss_count; low < high; )
+    {
+	mid = low + (high - low) / 2;
+	if ( features->minus_tss[mid] < peak_end )
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    if ( low > 0 )
+    {
+	d = XT_MAX(peak_start - features->minus_tss[low - 1], 0);
+	if ( (d < limit) && (!found || (d < *distance)) )
+	{
+	    *tss = features->minus_tss[low - 1];
+	    *strand = '-';
+	    *distance = d;
+	    found = true;
+	}
+    }
+    return found;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Report all features overlapping one peak.  Peaks should arrive
+ *      sorted by start within each chromosome, in which case each
+ *      feature is added to and removed from the active list once.
+ *      Out-of-order peaks restart the sweep for their chromosome, so
+ *      output remains correct, only slower.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Test active features with overlap_flags()
+ *  2026-10-16  Jason Bacon Compute the upstream region from the nearest
+ *                          TSS with --tss-distance
+ ***************************************************************************/
+
+void    classify_peak(feature_set_t *fs, sweep_t *sweep, const char *chrom,
+		      int64_t peak_start, int64_t peak_end,
+		      overlap_params_t *params, rank_t *rank,
+		      FILE *overlaps_stream)
+
+{
+    chrom_features_t    *features;
+    size_t      c,
+		f,
+		kept;
+    int64_t     overlap,
+		tss = 0,
+		tss_start,
+		tss_end,
+		distance = -1;
+    char        tss_strand = '.';
+    bool        found = false,
+		near_tss = false;
+    unsigned char   tss_flags;
+    tss_regions_t   *regions = params->tss_regions;
+
+    if ( strcmp(chrom, sweep->last_chrom) != 0 )
+    {
+	strncpy(sweep->last_chrom, chrom, BL_CHROM_MAX_CHARS);
+	sweep->last_chrom[BL_CHROM_MAX_CHARS] = '\0';
+	sweep->chrom = feature_set_find_chrom(fs, chrom);
+	sweep->next = sweep->active_count = 0;
+    }
+    else if ( peak_start < sweep->last_start )
+	sweep->next = sweep->active_count = 0;
+    sweep->last_start = peak_start;
+
+    // Every row of the peak reports its distance from the nearest TSS
+    if ( regions != NULL )
+    {
+	if ( sweep->chrom != NULL )
+	    near_tss = tss_nearest(sweep->chrom, regions, peak_start,
+				   peak_end, &tss, &tss_strand, &distance);
+	sweep->tss_distance = near_tss ? distance : -1;
+    }
+
+    if ( (features = sweep->chrom) != NULL )
+    {
+	// Skip features that all end before this peak, e.g. after a gap
+	if ( (sweep->next < features->count) &&
+	     (features->max_ends[sweep->next] <= peak_start) )
+	    sweep->next = chrom_features_first_ending_after(features,
+					sweep->next, peak_start);
+
+	// Activate features starting before the end of this peak
+	while ( (sweep->next < features->count) &&
+		(features->starts[sweep->next] < peak_end) )
+	{
+	    f = sweep->next++;
+	    // Empty features can never meet the minimum overlap
+	    if ( features->ends[f] <= features->starts[f] )
+		continue;
+	    if ( sweep->active_count == sweep->active_array_size )
+	    {
+		sweep->active_array_size = sweep->active_array_size == 0 ?
+		    256 : sweep->active_array_size * 2;
+		sweep->active = xt_realloc(sweep->active,
+		    sweep->active_array_size, sizeof(*sweep->active));
+		sweep->active_starts = xt_realloc(sweep->active_starts,
+		    sweep->active_array_size, sizeof(*sweep->active_starts));
+		sweep->active_ends = xt_realloc(sweep->active_ends,
+		    sweep->active_array_size, sizeof(*sweep->active_ends));
+		sweep->active_flags = xt_realloc(sweep->active_flags,
+		    sweep->active_array_size, sizeof(*sweep->active_flags));
+	    }
+	    sweep->active[sweep->active_count] = f;
+	    sweep->active_starts[sweep->active_count] = features->starts[f];
+	    sweep->active_ends[sweep->active_count] = features->ends[f];
+	    ++sweep->active_count;
+	}
+
+	overlap_flags(sweep->active_starts, sweep->active_ends,
+		      sweep->active_count, peak_start, peak_end, params,
+		      sweep->active_flags);
+
+	/*
+	 *  Retire features ending before this peak.  Later peaks start
+	 *  no earlier, so they cannot overlap them either.  Keep the
+	 *  survivors in feature order so output order matches the
+	 *  sorted feature file.
+	 */
+	for (c = kept = 0; c < sweep->active_count; ++c)
+	{
+	    if ( !(sweep->active_flags[c] & OVERLAP_FLAG_ACTIVE) )
+		continue;
+	    f = sweep->active[c];
+	    sweep->active[kept] = f;
+	    sweep->active_starts[kept] = sweep->active_starts[c];
+	    sweep->active_ends[kept] = sweep->active_ends[c];
+	    ++kept;
+
+	    if ( sweep->active_flags[c] & OVERLAP_FLAG_PASS )
+	    {
+		overlap = XT_MIN(peak_end, features->ends[f]) -
+			  XT_MAX(peak_start, features->starts[f]);
+		if ( rank != NULL )
+		    rank_add(rank, overlaps_stream, chrom, peak_start, peak_end,
+			     features->starts[f], features->ends[f],
+			     fs->names[features->names[f]],
+			     rank->name_ranks[features->names[f]],
+			     features->strands[f], overlap,
+			     sweep->tss_distance);
+		else
+		    sweep_write(sweep, overlaps_stream, chrom, peak_start,
+				peak_end, features->starts[f], features->ends[f],
+				fs->names[features->names[f]],
+				features->strands[f], overlap);
+		found = true;
+	    }
+	}
+	sweep->active_count = kept;
+    }
+
+    /*
+     *  Region c lies bounds[c] to bounds[c + 1] bases upstream of the
+     *  TSS, the same interval upstream_region() would have stored as a
+     *  feature.  Only the region holding the nearest TSS is reported.
+     */
+    if ( near_tss )
+    {
+	for (c = 0; distance >= regions->bounds[c + 1]; ++c)
+	    ;
+	if ( tss_strand == '+' )
+	{
+	    tss_start = tss - regions->bounds[c + 1];
+	    tss_end = tss - regions->bounds[c];
+	}
+	else
+	{
+	    tss_start = tss + regions->bounds[c];
+	    tss_end = tss + regions->bounds[c + 1];
+	}
+	overlap_flags(&tss_start, &tss_end, 1, peak_start, peak_end, params,
+		      &tss_flags);
+	if ( tss_flags & OVERLAP_FLAG_PASS )
+	{
+	    overlap = XT_MIN(peak_end, tss_end) - XT_MAX(peak_start, tss_start);
+	    f = regions->names[c];
+	    if ( rank != NULL )
+		rank_add(rank, overlaps_stream, chrom, peak_start, peak_end,
+			 tss_start, tss_end, fs->names[f], rank->name_ranks[f],
+			 tss_strand, overlap, sweep->tss_distance);
+	    else
+		sweep_write(sweep, overlaps_stream, chrom, peak_start,
+			    peak_end, tss_start, tss_end, fs->names[f],
+			    tss_strand, overlap);
+	    found = true;
+	}
+    }
+
+    /*
+     *  Peaks not overlapping anything else are labeled
+     *  upstream-beyond.  The entire peak length must overlap the
+     *  beyond region since none of it overlaps anything else.
+     */
+    if ( found )
+	return;
+    if ( rank != NULL )
+	rank_add(rank, overlaps_stream, chrom, peak_start, peak_end, -1, -1,
+		 BEYOND_FEATURE_NAME, rank->beyond_rank, '.',
+		 peak_end - peak_start, sweep->tss_distance);
+    else
+	sweep_write(sweep, overlaps_stream, chrom, peak_start, peak_end, -1, -1,
+		    BEYOND_FEATURE_NAME, '.', peak_end - peak_start);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Format one line of the overlaps TSV, including the newline, at
+ *      p, which must have room for FAST_WRITE_RECORD_MAX bytes.  Return
+ *      the end of the line.  There is no terminating '\0'.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+char    *overlap_format(char *p, const char *chrom,
+			int64_t peak_start, int64_t peak_end,
+			int64_t feature_start, int64_t feature_end,
+			const char *feature_name, char strand,
+			int64_t overlap, int64_t tss_distance)
+
+{
+    p = fast_format_str(p, chrom, strlen(chrom));
+    *p++ = '\t';
+    p = fast_format_int64(p, peak_start);
+    *p++ = '\t';
+    p = fast_format_int64(p, peak_end);
+    *p++ = '\t';
+    p = fast_format_int64(p, feature_start);
+    *p++ = '\t';
+    p = fast_format_int64(p, feature_end);
+    *p++ = '\t';
+    p = fast_format_str(p, feature_name, strlen(feature_name));
+    *p++ = '\t';
+    *p++ = strand;
+    *p++ = '\t';
+    p = fast_format_int64(p, overlap);
+    if ( tss_distance != OVERLAP_NO_TSS_DISTANCE )
+    {
+	*p++ = '\t';
+	p = fast_format_int64(p, tss_distance);
+    }
+    *p++ = '\n';
+    return p;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write one line of the overlaps TSV, with a TSS-distance column
+ *      unless tss_distance is OVERLAP_NO_TSS_DISTANCE
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Add tss_distance
+ *  2026-10-16  Jason Bacon Format with fast-write.h instead of fprintf()
+ ***************************************************************************/
+
+void    overlap_write(FILE *overlaps_stream, const char *chrom,
+		      int64_t peak_start, int64_t peak_end,
+		      int64_t feature_start, int64_t feature_end,
+		      const char *feature_name, char strand, int64_t overlap,
+		      int64_t tss_distance)
+
+{
+    char    line[FAST_WRITE_RECORD_MAX],
+	    *p;
+
+    p = overlap_format(line, chrom, peak_start, peak_end, feature_start,
+		       feature_end, feature_name, strand, overlap,
+		       tss_distance);
+    fwrite(line, p - line, 1, overlaps_stream);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Position a sweep for an arbitrary peak, so that the next
+ *      classify_peak() for chrom and peak_start skips every feature
+ *      that ends before the peak instead of sweeping from the start of
+ *      the chromosome.  Output is the same as for an unpositioned sweep.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Search max_ends[] instead of backing off by
+ *                          the longest feature
+ ***************************************************************************/
+
+void    sweep_seek(sweep_t *sweep, feature_set_t *fs, const char *chrom,
+		   int64_t peak_start)
+
+{
+    if ( strcmp(chrom, sweep->last_chrom) != 0 )
+    {
+	strncpy(sweep->last_chrom, chrom, BL_CHROM_MAX_CHARS);
+	sweep->last_chrom[BL_CHROM_MAX_CHARS] = '\0';
+	sweep->chrom = feature_set_find_chrom(fs, chrom);
+    }
+    sweep->last_start = peak_start;
+    sweep->active_count = 0;
+    sweep->next = 0;
+    if ( sweep->chrom != NULL )
+	sweep->next = chrom_features_first_ending_after(sweep->chrom, 0,
+							peak_start);
+}
+
+
+void    sweep_free(sweep_t *sweep)
+
+{
+    free(sweep->active);
+    free(sweep->active_starts);
+    free(sweep->active_ends);
+    free(sweep->active_flags);
+    *sweep = (sweep_t)SWEEP_INIT;
+}
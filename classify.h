@@ -0,0 +1,194 @@
+#ifndef _CLASSIFY_H_
+#define _CLASSIFY_H_
+
+#define OVERLAPS_HEADER \
+    "#Chr\tP-start\tP-end\tF-start\tF-end\tF-name\tStrand\tOverlap\n"
+// With --tss-distance
+#define OVERLAPS_TSS_HEADER \
+    "#Chr\tP-start\tP-end\tF-start\tF-end\tF-name\tStrand\tOverlap" \
+    "\tTSS-distance\n"
+
+// Reported for peaks that overlap no features at all
+#define BEYOND_FEATURE_NAME     "upstream-beyond"
+
+/*
+ *  All features on one chromosome, sorted by start, end, name, and
+ *  stored as parallel arrays rather than an array of structures, so
+ *  that the overlap tests in classify_peak() read only the starts and
+ *  ends, with several per cache line or SIMD register.  The feature
+ *  name (exon, intron, upstream1000, ...) is an index into the name
+ *  table of the feature set, since there are only a few dozen distinct
+ *  names among millions of features.  max_ends[f] is the largest end
+ *  among features 0 through f, so the first feature that may overlap
+ *  a position can be found by binary search.  plus_tss[] and
+ *  minus_tss[] are the sorted TSS positions of genes on each strand,
+ *  for --tss-distance, as defined for upstream_region().
+ */
+
+typedef struct
+{
+    char            chrom[BL_CHROM_MAX_CHARS + 1];
+    int64_t         *starts;
+    int64_t         *ends;
+    int64_t         *max_ends;
+    unsigned short  *names;
+    char            *strands;
+    size_t          count;
+    size_t          array_size;
+    int64_t         *plus_tss;
+    size_t          plus_tss_count;
+    int64_t         *minus_tss;
+    size_t          minus_tss_count;
+}   chrom_features_t;
+
+typedef struct
+{
+    chrom_features_t    *chroms;
+    size_t              count;
+    size_t              array_size;
+    char                **names;
+    size_t              name_count;
+    size_t              name_array_size;
+    void                *map;       // Features and names in a mapped index
+    size_t              map_size;
+    size_t              map_name_count; // Names after these are allocated
+}   feature_set_t;
+
+#define FEATURE_SET_INIT    { NULL, 0, 0, NULL, 0, 0, NULL, 0, 0 }
+
+#define FEATURE_SET_CHROM_COUNT(fs)     ((fs)->count)
+#define FEATURE_SET_NAME_AE(fs,c)       ((fs)->names[c])
+
+/*
+ *  Upstream regions computed from TSS positions with --tss-distance
+ *  rather than stored as features.  Region c lies bounds[c] to
+ *  bounds[c + 1] bases upstream of a TSS and its name is
+ *  fs->names[names[c]], added by feature_set_add_tss_names().
+ */
+
+typedef struct
+{
+    int64_t         *bounds;        // count + 1, ascending from 0
+    char            **region_names;
+    unsigned short  *names;
+    size_t          count;
+}   tss_regions_t;
+
+/*
+ *  Overlap criteria, equivalent to bedtools intersect -f, -F, and -e
+ */
+
+typedef struct
+{
+    double          min_peak_overlap;
+    double          min_gff3_overlap;
+    bool            min_either_overlap;
+    bool            midpoints_only;
+    char            **rank_features;    // --rank list, NULL for all overlaps
+    bool            binary_output;      // Write overlaps-bin.h format
+    tss_regions_t   *tss_regions;       // --tss-distance, else NULL
+}   overlap_params_t;
+
+#define OVERLAP_PARAMS_INIT { 1.0e-9, 1.0e-9, false, false, NULL, false, NULL }
+
+// Defined in rank.h
+typedef struct rank rank_t;
+
+/*
+ *  One peak/feature overlap, for callers that take results in memory
+ *  rather than as TSV text.  Columns are the same as the TSV.
+ */
+
+typedef struct
+{
+    const char      *chrom;
+    int64_t         peak_start;
+    int64_t         peak_end;
+    int64_t         feature_start;
+    int64_t         feature_end;
+    const char      *feature_name;
+    int64_t         overlap;
+    char            strand;
+    int64_t         tss_distance;   // OVERLAP_NO_TSS_DISTANCE if not used
+}   overlap_t;
+
+// No TSS-distance column, i.e. not --tss-distance
+#define OVERLAP_NO_TSS_DISTANCE INT64_MIN
+
+typedef void (*overlap_emit_t)(void *arg, const overlap_t *overlap);
+
+/*
+ *  Records processed by a classification, for --stats
+ */
+
+typedef struct
+{
+    unsigned long   peaks;
+    unsigned long   rows;       // Overlap lines written
+}   classify_counts_t;
+
+#define CLASSIFY_COUNTS_INIT    { 0, 0 }
+
+/*
+ *  Sweep-line state for one pass over the peaks of a chromosome.
+ *  active[] holds indexes of features that may still overlap the
+ *  current or later peaks, in feature list order.  Their starts and
+ *  ends are copied to active_starts[] and active_ends[] so that
+ *  overlap_flags() reads contiguous memory.
+ */
+
+typedef struct
+{
+    chrom_features_t    *chrom;
+    char                last_chrom[BL_CHROM_MAX_CHARS + 1];
+    int64_t             last_start;
+    size_t              next;
+    size_t              *active;
+    int64_t             *active_starts;
+    int64_t             *active_ends;
+    unsigned char       *active_flags;
+    size_t              active_count;
+    size_t              active_array_size;
+    unsigned long       rows;   // Lines written without --rank
+    overlap_emit_t      emit;   // Receives overlaps instead of the stream
+    void                *emit_arg;
+    int64_t             tss_distance;   // Of the current peak
+}   sweep_t;
+
+#define SWEEP_INIT  { NULL, "", 0, 0, NULL, NULL, NULL, NULL, 0, 0, 0, NULL, \
+		      NULL, OVERLAP_NO_TSS_DISTANCE }
+
+/* classify.c */
+int     feature_set_load(feature_set_t *fs, FILE *feature_stream);
+void    feature_set_free(feature_set_t *fs);
+chrom_features_t *feature_set_find_chrom(feature_set_t *fs, const char *chrom);
+chrom_features_t *feature_set_add_chrom(feature_set_t *fs, const char *chrom);
+void    chrom_features_add(chrom_features_t *chrom, int64_t start, int64_t end,
+			   unsigned short name, char strand);
+size_t  chrom_features_first_ending_after(chrom_features_t *chrom,
+			   size_t low, int64_t pos);
+int     feature_set_add_tss_names(feature_set_t *fs, tss_regions_t *regions);
+int     classify_peaks(feature_set_t *fs, FILE *peak_stream,
+		       FILE *overlaps_stream, overlap_params_t *params,
+		       rank_t *rank, classify_counts_t *counts);
+void    classify_peak(feature_set_t *fs, sweep_t *sweep, const char *chrom,
+		      int64_t peak_start, int64_t peak_end,
+		      overlap_params_t *params, rank_t *rank,
+		      FILE *overlaps_stream);
+char    *overlap_format(char *p, const char *chrom,
+			int64_t peak_start, int64_t peak_end,
+			int64_t feature_start, int64_t feature_end,
+			const char *feature_name, char strand,
+			int64_t overlap, int64_t tss_distance);
+void    overlap_write(FILE *overlaps_stream, const char *chrom,
+		      int64_t peak_start, int64_t peak_end,
+		      int64_t feature_start, int64_t feature_end,
+		      const char *feature_name, char strand, int64_t overlap,
+		      int64_t tss_distance);
+void    sweep_seek(sweep_t *sweep, feature_set_t *fs, const char *chrom,
+		   int64_t peak_start);
+void    sweep_free(sweep_t *sweep);
+int     overlap_params_parse(overlap_params_t *params, int argc, char *argv[],
+			     int c);
+
+#endif  // _CLASSIFY_H_
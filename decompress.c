@@ -0,0 +1,164 @@
+/***************************************************************************
+ *  Description:
+ *      Open compressed input for reading through the fastest available
+ *      decompressor.  Like xt_fopen(), decompression runs in a child
+ *      process feeding a pipe, so it overlaps with parsing in this
+ *      process.  Where a multithreaded decompressor is installed it is
+ *      used instead of the standard tool, including bgzip for BGZF
+ *      files, whose independent blocks decompress in parallel.
+ *      The stream is closed with xt_fclose() like any other.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <xtend/file.h>
+#include "decompress.h"
+
+/***************************************************************************
+ *  Description:
+ *      Open filename for reading.  Files ending in .gz, .bz2, or .xz
+ *      are decompressed using up to threads threads where the tool
+ *      allows.  Other files, and compressed files when no tool below
+ *      is installed, are opened with xt_fopen().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+FILE    *decompress_fopen(const char *filename, unsigned threads)
+
+{
+    FILE        *stream;
+    const char  *ext,
+		*p;
+    char        cmd[PATH_MAX * 4 + 64],
+		quoted[PATH_MAX * 4 + 3],
+		*q;
+    size_t      len;
+
+    if ( (ext = strrchr(filename, '.')) == NULL )
+	ext = "";
+    if ( threads < 1 )
+	threads = 1;
+
+    // Quote for sh -c, rendering ' as '\''
+    q = quoted;
+    *q++ = '\'';
+    for (p = filename; (*p != '\0') && (q - quoted < PATH_MAX * 4 - 4); ++p)
+    {
+	if ( *p == '\'' )
+	{
+	    memcpy(q, "'\\''", 4);
+	    q += 4;
+	}
+	else
+	    *q++ = *p;
+    }
+    *q++ = '\'';
+    *q = '\0';
+
+    len = sizeof(cmd);
+    *cmd = '\0';
+    if ( strcmp(ext, ".gz") == 0 )
+    {
+	if ( decompress_is_bgzf(filename) && decompress_in_path("bgzip") )
+	    snprintf(cmd, len, "bgzip -dc -@ %u %s", threads, quoted);
+	else if ( decompress_in_path("pigz") )
+	    // pigz decompression is serial, but reads, writes, and checks on
+	    // separate threads
+	    snprintf(cmd, len, "pigz -dc -p %u %s", threads, quoted);
+    }
+    else if ( strcmp(ext, ".bz2") == 0 )
+    {
+	if ( decompress_in_path("lbzip2") )
+	    snprintf(cmd, len, "lbzip2 -dc -n %u %s", threads, quoted);
+	else if ( decompress_in_path("pbzip2") )
+	    snprintf(cmd, len, "pbzip2 -dc -p%u %s", threads, quoted);
+    }
+    else if ( (strcmp(ext, ".xz") == 0) && (threads > 1) &&
+	      decompress_in_path("xz") )
+	snprintf(cmd, len, "xz -dc -T %u %s", threads, quoted);
+
+    // Check the file exists so errors match xt_fopen()
+    if ( (*cmd != '\0') && (access(filename, R_OK) == 0) )
+	stream = popen(cmd, "r");
+    else
+	stream = xt_fopen(filename, "r");
+
+    if ( stream != NULL )
+	setvbuf(stream, NULL, _IOFBF, DECOMPRESS_BUFF_SIZE);
+    return stream;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return true if filename is in BGZF format, i.e. its first gzip
+ *      member has the BC extra subfield written by bgzip and htslib.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+bool    decompress_is_bgzf(const char *filename)
+
+{
+    FILE            *fp;
+    unsigned char   header[16];
+    size_t          count;
+
+    if ( (fp = fopen(filename, "r")) == NULL )
+	return false;
+    count = fread(header, 1, sizeof(header), fp);
+    fclose(fp);
+    // ID1 ID2 CM FLG(FEXTRA) ... XLEN(2) SI1 SI2
+    return (count == sizeof(header)) &&
+	   (header[0] == 0x1f) && (header[1] == 0x8b) && (header[2] == 8) &&
+	   (header[3] & 4) && (header[12] == 'B') && (header[13] == 'C');
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return true if command is an executable file in a PATH directory
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+bool    decompress_in_path(const char *command)
+
+{
+    const char  *path,
+		*dir,
+		*colon;
+    char        filename[PATH_MAX + 1];
+
+    if ( (path = getenv("PATH")) == NULL )
+	return false;
+    for (dir = path; *dir != '\0'; dir = *colon == '\0' ? colon : colon + 1)
+    {
+	if ( (colon = strchr(dir, ':')) == NULL )
+	    colon = dir + strlen(dir);
+	// Empty PATH entries mean the current directory
+	if ( colon == dir )
+	    snprintf(filename, sizeof(filename), "./%s", command);
+	else
+	    snprintf(filename, sizeof(filename), "%.*s/%s",
+		     (int)(colon - dir), dir, command);
+	if ( access(filename, X_OK) == 0 )
+	    return true;
+    }
+    return false;
+}
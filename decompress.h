@@ -0,0 +1,15 @@
+#ifndef _DECOMPRESS_H_
+#define _DECOMPRESS_H_
+
+/*
+ *  Larger than a pipe buffer, so bl_gff3_read() and friends refill
+ *  from the decompressor in few, large reads
+ */
+#define DECOMPRESS_BUFF_SIZE    (1024 * 1024)
+
+/* decompress.c */
+FILE    *decompress_fopen(const char *filename, unsigned threads);
+bool    decompress_is_bgzf(const char *filename);
+bool    decompress_in_path(const char *command);
+
+#endif  // _DECOMPRESS_H_
@@ -0,0 +1,409 @@
+/***************************************************************************
+ *  Description:
+ *      Extract the genes from a BED file of augmented GFF features, such
+ *      as that written by peak-classifier, into one packed file of gene
+ *      blocks with an index of gene names and offsets.  A single gene is
+ *      later retrieved with --lookup, which seeks directly to its block.
+ *
+ *      Major features are separated by lines containing ###, and a block
+ *      is a gene if the first feature contains "gene", as for gene,
+ *      ncRNA_gene, and pseudogene.  Genes are named chrom-start-end.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <xtend/file.h>
+#include <xtend/mem.h>
+
+#define GENES_PREFIX        "Genes-"
+#define GENES_INDEX_HEADER  "#Gene\tFeature\tOffset\tLength\n"
+
+typedef struct
+{
+    char        *name;
+    char        *feature;
+    uint64_t    offset;
+    uint64_t    length;
+}   gene_t;
+
+int     extract_genes(const char *bed_filename, const char *data_filename,
+		      const char *index_filename);
+int     gene_lookup(const char *data_filename, const char *index_filename,
+		    char *names[], int name_count);
+char    *genes_filename(const char *bed_filename, const char *suffix);
+void    usage(char *argv[]);
+
+int     main(int argc,char *argv[])
+
+{
+    char    *data_filename,
+	    *index_filename;
+    int     c,
+	    status;
+    bool    lookup = false;
+
+    if ( (argc == 2) && (strcmp(argv[1],"--version")) == 0 )
+    {
+	printf("%s %s\n", argv[0], VERSION);
+	return EX_OK;
+    }
+
+    for (c = 1; (c < argc) && (*argv[c] == '-'); ++c)
+    {
+	if ( strcmp(argv[c], "--lookup") == 0 )
+	    lookup = true;
+	else
+	    usage(argv);
+    }
+    if ( lookup ? argc - c < 2 : argc - c != 1 )
+	usage(argv);
+
+    data_filename = genes_filename(argv[c], ".bed");
+    index_filename = genes_filename(argv[c], ".idx");
+    if ( lookup )
+	status = gene_lookup(data_filename, index_filename,
+			     argv + c + 1, argc - c - 1);
+    else
+	status = extract_genes(argv[c], data_filename, index_filename);
+    free(data_filename);
+    free(index_filename);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Name an output file after the feature file, in the same directory:
+ *      dir/features.bed becomes dir/Genes-features<suffix>.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+char    *genes_filename(const char *bed_filename, const char *suffix)
+
+{
+    const char  *base,
+		*ext;
+    char        *filename;
+    size_t      dir_len,
+		stem_len;
+
+    base = (base = strrchr(bed_filename, '/')) == NULL ?
+	   bed_filename : base + 1;
+    dir_len = base - bed_filename;
+    ext = strrchr(base, '.');
+    stem_len = (ext != NULL) && (strcmp(ext, ".bed") == 0) ?
+	       (size_t)(ext - base) : strlen(base);
+    filename = xt_malloc(dir_len + sizeof(GENES_PREFIX) + stem_len +
+			 strlen(suffix), sizeof(*filename));
+    sprintf(filename, "%.*s" GENES_PREFIX "%.*s%s", (int)dir_len,
+	    bed_filename, (int)stem_len, base, suffix);
+    return filename;
+}
+
+
+/*
+ *  Name a gene chrom-start-end from the first line of its block, and
+ *  copy the feature type.  Returns false if the line has too few fields.
+ */
+
+static bool gene_parse(gene_t *gene, const char *line)
+
+{
+    const char  *fields[4],
+		*p = line;
+    size_t      len[4];
+    int         c;
+
+    for (c = 0; c < 4; ++c)
+    {
+	fields[c] = p;
+	len[c] = strcspn(p, "\t\n");
+	p += len[c];
+	if ( (c < 3) && (*p++ != '\t') )
+	    return false;
+    }
+    gene->name = xt_malloc(len[0] + len[1] + len[2] + 3, 1);
+    sprintf(gene->name, "%.*s-%.*s-%.*s", (int)len[0], fields[0],
+	    (int)len[1], fields[1], (int)len[2], fields[2]);
+    gene->feature = xt_malloc(len[3] + 1, 1);
+    sprintf(gene->feature, "%.*s", (int)len[3], fields[3]);
+    return true;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Copy each gene block of the feature file to the data file in one
+ *      pass, and write one index line per gene with its name, feature
+ *      type, offset, and length in the data file.  The ### separators and
+ *      header are not copied, so each block is a BED file of one gene.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     extract_genes(const char *bed_filename, const char *data_filename,
+		      const char *index_filename)
+
+{
+    FILE        *bed_stream,
+		*data_stream,
+		*index_stream;
+    char        *line = NULL;
+    size_t      line_size = 0;
+    ssize_t     len;
+    uint64_t    offset = 0;
+    gene_t      gene = { NULL, NULL, 0, 0 };
+    bool        block_start = true;
+    int         status = EX_OK;
+
+    if ( (bed_stream = xt_fopen(bed_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "extract-genes: Cannot open %s: %s\n",
+		bed_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    if ( (data_stream = fopen(data_filename, "w")) == NULL )
+    {
+	fprintf(stderr, "extract-genes: Cannot create %s: %s\n",
+		data_filename, strerror(errno));
+	return EX_CANTCREAT;
+    }
+    if ( (index_stream = fopen(index_filename, "w")) == NULL )
+    {
+	fprintf(stderr, "extract-genes: Cannot create %s: %s\n",
+		index_filename, strerror(errno));
+	return EX_CANTCREAT;
+    }
+    fputs(GENES_INDEX_HEADER, index_stream);
+
+    /*
+     *  A trailing ### line sends the last gene to the index, and the
+     *  extra pass at EOF does it for files without one
+     */
+    do
+    {
+	len = getline(&line, &line_size, bed_stream);
+	if ( (len == -1) || (strcmp(line, "###\n") == 0) )
+	{
+	    if ( gene.name != NULL )
+	    {
+		fprintf(index_stream, "%s\t%s\t%" PRIu64 "\t%" PRIu64 "\n",
+			gene.name, gene.feature, gene.offset,
+			offset - gene.offset);
+		free(gene.name);
+		free(gene.feature);
+		gene.name = NULL;
+	    }
+	    block_start = true;
+	}
+	else if ( *line == '#' )
+	    continue;   // Header
+	else
+	{
+	    if ( block_start )
+	    {
+		if ( !gene_parse(&gene, line) )
+		{
+		    fprintf(stderr, "extract-genes: Invalid feature in %s: %s",
+			    bed_filename, line);
+		    status = EX_DATAERR;
+		    break;
+		}
+		if ( strstr(gene.feature, "gene") == NULL )
+		{
+		    free(gene.name);
+		    free(gene.feature);
+		    gene.name = NULL;
+		}
+		gene.offset = offset;
+		block_start = false;
+	    }
+	    if ( gene.name != NULL )
+	    {
+		fwrite(line, len, 1, data_stream);
+		offset += len;
+	    }
+	}
+    }   while ( len != -1 );
+    free(line);
+    if ( gene.name != NULL )
+    {
+	free(gene.name);
+	free(gene.feature);
+    }
+
+    xt_fclose(bed_stream);
+    if ( ferror(data_stream) | (fclose(data_stream) != 0) )
+    {
+	fprintf(stderr, "extract-genes: Error writing %s.\n", data_filename);
+	status = EX_IOERR;
+    }
+    if ( ferror(index_stream) | (fclose(index_stream) != 0) )
+    {
+	fprintf(stderr, "extract-genes: Error writing %s.\n", index_filename);
+	status = EX_IOERR;
+    }
+    return status;
+}
+
+
+static int  gene_cmp(const void *p1, const void *p2)
+
+{
+    return strcmp(((const gene_t *)p1)->name, ((const gene_t *)p2)->name);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the blocks of the named genes to the standard output,
+ *      seeking to each in the data file.  The index is sorted by name in
+ *      memory, so any number of genes are found with one read of it.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     gene_lookup(const char *data_filename, const char *index_filename,
+		    char *names[], int name_count)
+
+{
+    FILE        *data_stream,
+		*index_stream;
+    gene_t      *genes = NULL,
+		key,
+		*gene;
+    size_t      gene_count = 0,
+		array_size = 0,
+		line_size = 0,
+		c,
+		bytes;
+    char        *line = NULL,
+		*name,
+		*feature,
+		*end,
+		buff[65536];
+    uint64_t    remaining;
+    int         n,
+		status = EX_OK;
+
+    if ( (index_stream = fopen(index_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "extract-genes: Cannot open %s: %s\n",
+		index_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    while ( getline(&line, &line_size, index_stream) != -1 )
+    {
+	if ( *line == '#' )
+	    continue;
+	if ( gene_count == array_size )
+	{
+	    array_size = array_size == 0 ? 1024 : array_size * 2;
+	    genes = xt_realloc(genes, array_size, sizeof(*genes));
+	}
+	name = strtok(line, "\t");
+	feature = strtok(NULL, "\t");
+	if ( (feature == NULL) || ((end = strtok(NULL, "\n")) == NULL) )
+	{
+	    fprintf(stderr, "extract-genes: Invalid index line in %s.\n",
+		    index_filename);
+	    status = EX_DATAERR;
+	    break;
+	}
+	genes[gene_count].name = strdup(name);
+	genes[gene_count].feature = NULL;
+	genes[gene_count].offset = strtoull(end, &end, 10);
+	genes[gene_count].length = strtoull(end, NULL, 10);
+	++gene_count;
+    }
+    free(line);
+    fclose(index_stream);
+
+    if ( (status == EX_OK) &&
+	 ((data_stream = fopen(data_filename, "r")) == NULL) )
+    {
+	fprintf(stderr, "extract-genes: Cannot open %s: %s\n",
+		data_filename, strerror(errno));
+	status = EX_NOINPUT;
+    }
+    if ( status == EX_OK )
+    {
+	qsort(genes, gene_count, sizeof(*genes), gene_cmp);
+	for (n = 0; n < name_count; ++n)
+	{
+	    key.name = names[n];
+	    if ( (gene = bsearch(&key, genes, gene_count, sizeof(*genes),
+				 gene_cmp)) == NULL )
+	    {
+		fprintf(stderr, "extract-genes: %s is not in %s.\n",
+			names[n], index_filename);
+		status = EX_DATAERR;
+		continue;
+	    }
+	    if ( fseeko(data_stream, gene->offset, SEEK_SET) != 0 )
+	    {
+		fprintf(stderr, "extract-genes: Cannot seek in %s: %s\n",
+			data_filename, strerror(errno));
+		status = EX_IOERR;
+		break;
+	    }
+	    for (remaining = gene->length; remaining > 0; remaining -= bytes)
+	    {
+		bytes = remaining < sizeof(buff) ? remaining : sizeof(buff);
+		if ( fread(buff, bytes, 1, data_stream) != 1 )
+		{
+		    fprintf(stderr, "extract-genes: %s is truncated.\n",
+			    data_filename);
+		    status = EX_DATAERR;
+		    break;
+		}
+		fwrite(buff, bytes, 1, stdout);
+	    }
+	}
+	fclose(data_stream);
+	if ( ferror(stdout) )
+	{
+	    fprintf(stderr, "extract-genes: Error writing output.\n");
+	    status = EX_IOERR;
+	}
+    }
+
+    for (c = 0; c < gene_count; ++c)
+	free(genes[c].name);
+    free(genes);
+    return status;
+}
+
+
+void    usage(char *argv[])
+
+{
+    fprintf(stderr,
+	    "\nUsage: %s --version"
+	    "\n       %s features.bed"
+	    "\n       %s --lookup features.bed chrom-start-end [...]\n\n"
+	    "Extracts the genes from a BED file of augmented GFF features into\n"
+	    "Genes-features.bed, with one line per gene giving its name, type,\n"
+	    "offset, and length in Genes-features.idx.  --lookup writes the\n"
+	    "named genes to the standard output.\n\n",
+	    argv[0], argv[0], argv[0]);
+    exit(EX_USAGE);
+}
@@ -0,0 +1,66 @@
+/***************************************************************************
+ *  Description:
+ *      Buffer management for fast-write.h.  Formatting is inline in the
+ *      header since it is called for every field.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <xtend/mem.h>
+#include <biolibc/bed.h>
+#include "fast-write.h"
+
+/***************************************************************************
+ *  Description:
+ *      Start buffering output to stream.  The stream is not closed by
+ *      fast_write_close(), so it may be stdout.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     fast_write_open(fast_write_t *fw, FILE *stream)
+
+{
+    fw->stream = stream;
+    fw->buff = xt_malloc(FAST_WRITE_BUFF_SIZE, 1);
+    fw->len = 0;
+    fw->status = EX_OK;
+    return EX_OK;
+}
+
+
+/*
+ *  Write the buffered records.  Errors are recorded in fw->status and
+ *  returned by fast_write_close().
+ */
+
+int     fast_write_flush(fast_write_t *fw)
+
+{
+    if ( (fw->len > 0) &&
+	 (fwrite(fw->buff, fw->len, 1, fw->stream) != 1) )
+	fw->status = EX_IOERR;
+    fw->len = 0;
+    return fw->status;
+}
+
+
+int     fast_write_close(fast_write_t *fw)
+
+{
+    int     status;
+
+    status = fast_write_flush(fw);
+    free(fw->buff);
+    fw->buff = NULL;
+    return status;
+}
@@ -0,0 +1,107 @@
+#ifndef _FAST_WRITE_H_
+#define _FAST_WRITE_H_
+
+/*
+ *  Buffered output for the augmented BED file and overlap rows.  Each
+ *  record is formatted directly into a large reusable buffer with
+ *  hand-rolled integer conversion, instead of one stdio call with a
+ *  format string per field, and the buffer is written in large
+ *  blocks.  Records are never split between blocks.
+ */
+
+#define FAST_WRITE_BUFF_SIZE    (1024 * 1024)
+// Longest record: chrom, name, and a few integers and separators
+#define FAST_WRITE_RECORD_MAX   (BL_CHROM_MAX_CHARS + BL_BED_NAME_MAX_CHARS + 256)
+
+typedef struct
+{
+    FILE        *stream;
+    char        *buff;
+    size_t      len;
+    int         status;
+}   fast_write_t;
+
+/* fast-write.c */
+int     fast_write_open(fast_write_t *fw, FILE *stream);
+int     fast_write_flush(fast_write_t *fw);
+int     fast_write_close(fast_write_t *fw);
+
+// Two digits at a time halves the divisions
+static const char   fast_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233"
+    "34353637383940414243444546474849505152535455565758596061626364656667"
+    "6869707172737475767778798081828384858687888990919293949596979899";
+
+/*
+ *  Format value in decimal at p, with no terminating '\0', and return
+ *  the end
+ */
+
+static inline char  *fast_format_uint64(char *p, uint64_t value)
+
+{
+    char    digits[20],
+	    *d = digits + sizeof(digits);
+    size_t  len;
+
+    while ( value >= 100 )
+    {
+	d -= 2;
+	memcpy(d, fast_digit_pairs + value % 100 * 2, 2);
+	value /= 100;
+    }
+    if ( value >= 10 )
+    {
+	d -= 2;
+	memcpy(d, fast_digit_pairs + value * 2, 2);
+    }
+    else
+	*--d = '0' + value;
+    len = digits + sizeof(digits) - d;
+    memcpy(p, d, len);
+    return p + len;
+}
+
+
+static inline char  *fast_format_int64(char *p, int64_t value)
+
+{
+    if ( value < 0 )
+    {
+	*p++ = '-';
+	return fast_format_uint64(p, -(uint64_t)value);
+    }
+    return fast_format_uint64(p, value);
+}
+
+
+static inline char  *fast_format_str(char *p, const char *str, size_t len)
+
+{
+    memcpy(p, str, len);
+    return p + len;
+}
+
+
+/*
+ *  Return a pointer to room for one record of up to
+ *  FAST_WRITE_RECORD_MAX bytes, to be formatted with the functions
+ *  above and committed with fast_write_commit()
+ */
+
+static inline char  *fast_write_reserve(fast_write_t *fw)
+
+{
+    if ( fw->len > FAST_WRITE_BUFF_SIZE - FAST_WRITE_RECORD_MAX )
+	fast_write_flush(fw);
+    return fw->buff + fw->len;
+}
+
+
+static inline void  fast_write_commit(fast_write_t *fw, const char *end)
+
+{
+    fw->len = end - fw->buff;
+}
+
+#endif  // _FAST_WRITE_H_
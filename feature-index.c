@@ -0,0 +1,1192 @@
+/***************************************************************************
+ *  Description:
+ *      Build and map the binary feature index.  The augmented feature
+ *      list is sorted and parsed once per GFF, and every later run
+ *      simply mmap()s the result, so startup does not depend on the
+ *      size of the GFF.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <xtend/mem.h>
+#include <biolibc/bed.h>
+#include <biolibc/gff3.h>
+#include <biolibc/pos-list.h>
+#include "classify.h"
+#include "feature-sort.h"
+#include "fast-write.h"
+#include "augment.h"
+#include "stats.h"
+#include "feature-index.h"
+
+/*
+ *  Free the current chromosome buffer
+ */
+
+static void index_free_current(feature_index_writer_t *writer)
+
+{
+    free(writer->current.starts);
+    free(writer->current.ends);
+    free(writer->current.max_ends);
+    free(writer->current.names);
+    free(writer->current.strands);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Merge the features in a sorter into a new index file, recording
+ *      the upstream boundaries, genes, and GFF identity for
+ *      feature_index_check().  The sort stage is timed in stats if not
+ *      NULL.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static int  index_write_sorted(feature_sort_t *sorter,
+			       const char *index_filename,
+			       bl_pos_list_t *pos_list, upstream_genes_t *genes,
+			       uint64_t gff3_size, int64_t gff3_mtime,
+			       stats_t *stats)
+
+{
+    feature_index_writer_t  writer;
+    stats_stage_t           *stage;
+    int                     status;
+
+    fputs("Sorting...\n", stderr);
+    stage = stats_begin(stats, "sort");
+    if ( (status = feature_index_open(&writer, index_filename)) != EX_OK )
+	return status;
+    writer.pos_list = pos_list;
+    writer.genes = genes;
+    writer.gene_chroms = sorter->chroms;
+    writer.gff3_size = gff3_size;
+    writer.gff3_mtime = gff3_mtime;
+    status = feature_sort_finish(sorter, feature_index_add, &writer);
+    if ( status == EX_OK )
+    {
+	status = feature_index_close(&writer, sorter->names,
+				     sorter->name_count);
+	stats_end(stage, sorter->total, sorter->total, -1, writer.offset);
+    }
+    else
+    {
+	fclose(writer.stream);
+	free(writer.dir);
+	index_free_current(&writer);
+	unlink(index_filename);
+    }
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Generate the augmented BED file for a GFF, sort the features
+ *      in-process, and stream them into the binary feature index.
+ *      gff3_filename is used only to record the identity of the GFF,
+ *      and may be NULL if gff3_stream is not a file.  The augment and
+ *      sort stages are timed in stats if not NULL.  Sort spill files go
+ *      in temp_dir, or $TMPDIR or /tmp if temp_dir is NULL.
+ *
+ *      Both files are written under temporary names and renamed when
+ *      complete, so other processes see either no file or a whole one.
+ *      The index is renamed last, so a current index means the BED file
+ *      is complete as well.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Record the GFF, boundaries, and genes.  Do
+ *                          not reuse an augmented BED file, which may
+ *                          have been generated with other boundaries.
+ *  2026-10-16  Jason Bacon Write to temporary files and rename
+ *  2026-10-16  Jason Bacon Add temp_dir for --temp-dir
+ ***************************************************************************/
+
+int     feature_index_create(FILE *gff3_stream, const char *gff3_filename,
+			     const char *gff3_stem,
+			     const char *upstream_boundaries,
+			     const char *index_filename, const char *temp_dir,
+			     stats_t *stats)
+
+{
+    char                    augmented_filename[PATH_MAX + 1],
+			    tmp_augmented_filename[PATH_MAX + 32],
+			    tmp_index_filename[PATH_MAX + 32];
+    struct stat             file_info;
+    feature_sort_t          sorter;
+    upstream_genes_t        genes = UPSTREAM_GENES_INIT;
+    bl_pos_list_t           pos_list = BL_POS_LIST_INIT;
+    stats_stage_t           *stage;
+    uint64_t                gff3_size = 0;
+    int64_t                 gff3_mtime = 0;
+    int                     status;
+
+    if ( (gff3_filename != NULL) && (stat(gff3_filename, &file_info) == 0) )
+    {
+	gff3_size = file_info.st_size;
+	gff3_mtime = file_info.st_mtime;
+    }
+
+    feature_sort_init(&sorter, FEATURE_SORT_MAX_RECS, temp_dir);
+    snprintf(augmented_filename, PATH_MAX, "%s-augmented.bed", gff3_stem);
+    snprintf(tmp_augmented_filename, sizeof(tmp_augmented_filename),
+	     "%s.%ld.tmp", augmented_filename, (long)getpid());
+    snprintf(tmp_index_filename, sizeof(tmp_index_filename), "%s.%ld.tmp",
+	     index_filename, (long)getpid());
+    stage = stats_begin(stats, "augment");
+    if ( gff3_augment(gff3_stream, upstream_boundaries,
+		      tmp_augmented_filename, &sorter, &genes) != EX_OK )
+    {
+	fprintf(stderr, "gff3_augment() failed.  Removing %s...\n",
+		tmp_augmented_filename);
+	unlink(tmp_augmented_filename);
+	feature_sort_free(&sorter);
+	upstream_genes_free(&genes);
+	return EX_DATAERR;
+    }
+
+    // GFF records are not counted, only the features generated
+    stats_end(stage, -1, sorter.total, -1,
+	      stats_path_bytes(tmp_augmented_filename));
+
+    upstream_pos_list(&pos_list, upstream_boundaries);
+    status = index_write_sorted(&sorter, tmp_index_filename, &pos_list,
+				&genes, gff3_size, gff3_mtime, stats);
+    bl_pos_list_free(&pos_list);
+    upstream_genes_free(&genes);
+    feature_sort_free(&sorter);
+
+    if ( (status == EX_OK) &&
+	 ((rename(tmp_augmented_filename, augmented_filename) != 0) ||
+	  (rename(tmp_index_filename, index_filename) != 0)) )
+    {
+	fprintf(stderr, "peak-classifier: Cannot create %s: %s\n",
+		index_filename, strerror(errno));
+	status = EX_CANTCREAT;
+    }
+    if ( status != EX_OK )
+    {
+	unlink(tmp_augmented_filename);
+	unlink(tmp_index_filename);
+    }
+    return status;
+}
+
+
+/*
+ *  Return true if an index header was written by this version on a
+ *  compatible host and its sections lie within file_size bytes
+ */
+
+static bool index_header_ok(const feature_index_header_t *header,
+			    uint64_t file_size)
+
+{
+    return (memcmp(header->magic, FEATURE_INDEX_MAGIC,
+		   sizeof(FEATURE_INDEX_MAGIC)) == 0) &&
+	   (header->version == FEATURE_INDEX_VERSION) &&
+	   (header->byte_order == FEATURE_INDEX_BYTE_ORDER) &&
+	   (header->feature_size == FEATURE_INDEX_FEATURE_SIZE) &&
+	   (header->chrom_size == sizeof(feature_index_chrom_t)) &&
+	   (header->gene_size == sizeof(upstream_gene_t)) &&
+	   (header->file_size == file_size) &&
+	   (header->chrom_offset + header->chrom_count *
+		sizeof(feature_index_chrom_t) <= header->name_offset) &&
+	   (header->name_offset <= header->boundary_offset) &&
+	   (header->boundary_offset % FEATURE_INDEX_ALIGN == 0) &&
+	   (header->boundary_offset + header->boundary_count *
+		sizeof(int64_t) <= header->gene_offset) &&
+	   (header->gene_offset % FEATURE_INDEX_ALIGN == 0) &&
+	   (header->gene_offset + header->gene_count * header->gene_size <=
+		file_size);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Check whether an existing index can be used for a GFF and
+ *      upstream boundaries.  Return FEATURE_INDEX_CURRENT if so,
+ *      FEATURE_INDEX_BOUNDARIES if only the boundaries differ, so that
+ *      feature_index_update() can regenerate the upstream regions,
+ *      and FEATURE_INDEX_MISSING or FEATURE_INDEX_STALE if the index
+ *      must be built from the GFF.  The identity of the GFF is not
+ *      checked if gff3_filename is NULL, e.g. for stdin.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     feature_index_check(const char *index_filename,
+			    const char *gff3_filename,
+			    const char *upstream_boundaries)
+
+{
+    FILE                    *stream;
+    struct stat             file_info;
+    feature_index_header_t  header;
+    bl_pos_list_t           pos_list = BL_POS_LIST_INIT;
+    int64_t                 pos;
+    size_t                  c;
+    int                     status;
+
+    if ( (stream = fopen(index_filename, "r")) == NULL )
+	return FEATURE_INDEX_MISSING;
+    if ( (fstat(fileno(stream), &file_info) != 0) ||
+	 (fread(&header, sizeof(header), 1, stream) != 1) ||
+	 !index_header_ok(&header, file_info.st_size) )
+    {
+	fclose(stream);
+	return FEATURE_INDEX_STALE;
+    }
+    if ( (gff3_filename != NULL) &&
+	 ((stat(gff3_filename, &file_info) != 0) ||
+	  (header.gff3_size != (uint64_t)file_info.st_size) ||
+	  (header.gff3_mtime != (int64_t)file_info.st_mtime)) )
+    {
+	fclose(stream);
+	return FEATURE_INDEX_STALE;
+    }
+
+    upstream_pos_list(&pos_list, upstream_boundaries);
+    status = FEATURE_INDEX_CURRENT;
+    if ( header.boundary_count != BL_POS_LIST_COUNT(&pos_list) )
+	status = FEATURE_INDEX_BOUNDARIES;
+    else if ( fseek(stream, header.boundary_offset, SEEK_SET) != 0 )
+	status = FEATURE_INDEX_STALE;
+    else
+    {
+	for (c = 0; (c < header.boundary_count) &&
+		    (status == FEATURE_INDEX_CURRENT); ++c)
+	{
+	    if ( fread(&pos, sizeof(pos), 1, stream) != 1 )
+		status = FEATURE_INDEX_STALE;
+	    else if ( pos != BL_POS_LIST_POSITIONS_AE(&pos_list, c) )
+		status = FEATURE_INDEX_BOUNDARIES;
+	}
+    }
+    bl_pos_list_free(&pos_list);
+    fclose(stream);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Replace the upstream regions in an existing index with those
+ *      for new boundaries.  Other features are copied from the index,
+ *      already sorted, and the new regions are generated from the gene
+ *      table, so the GFF is not read.  The result is the same as
+ *      rebuilding from the GFF.  The new index is written to a
+ *      temporary file and renamed, since the old one is mapped while
+ *      reading.  The augmented BED file no longer matches and is
+ *      removed.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Make the temporary name unique per process
+ *  2026-10-16  Jason Bacon Add temp_dir for --temp-dir
+ ***************************************************************************/
+
+int     feature_index_update(const char *index_filename,
+			     const char *gff3_stem,
+			     const char *upstream_boundaries,
+			     const char *temp_dir, stats_t *stats)
+
+{
+    feature_set_t           fs = FEATURE_SET_INIT;
+    feature_index_header_t  *header;
+    const int64_t           *old_positions;
+    const upstream_gene_t   *old_genes;
+    feature_sort_t          sorter;
+    feature_rec_t           rec;
+    upstream_genes_t        genes = UPSTREAM_GENES_INIT;
+    bl_pos_list_t           pos_list = BL_POS_LIST_INIT;
+    chrom_features_t        *chrom;
+    stats_stage_t           *stage;
+    char                    tmp_filename[PATH_MAX + 1],
+			    augmented_filename[PATH_MAX + 1],
+			    name[BL_BED_NAME_MAX_CHARS + 1];
+    bool                    *old_region;
+    uint16_t                *name_nums,
+			    *region_names;
+    uint32_t                *chrom_nums;
+    size_t                  c,
+			    f,
+			    g,
+			    b,
+			    regions;
+    int                     status = EX_OK;
+
+    if ( (status = feature_index_map(&fs, index_filename)) != EX_OK )
+	return status;
+    header = fs.map;
+    old_positions = (const int64_t *)((char *)fs.map + header->boundary_offset);
+    old_genes = (const upstream_gene_t *)((char *)fs.map + header->gene_offset);
+
+    stage = stats_begin(stats, "upstream");
+    feature_sort_init(&sorter, FEATURE_SORT_MAX_RECS, temp_dir);
+
+    // Renumber names, flagging the old upstream regions to drop
+    old_region = xt_malloc(fs.name_count, sizeof(*old_region));
+    name_nums = xt_malloc(fs.name_count, sizeof(*name_nums));
+    for (f = 0; (f < fs.name_count) && (status == EX_OK); ++f)
+    {
+	old_region[f] = false;
+	for (b = 1; (b < header->boundary_count) && !old_region[f]; ++b)
+	{
+	    snprintf(name, BL_BED_NAME_MAX_CHARS, "upstream%" PRId64,
+		     old_positions[b]);
+	    old_region[f] = strcmp(fs.names[f], name) == 0;
+	}
+	if ( !old_region[f] )
+	    status = feature_sort_name(&sorter, fs.names[f], &name_nums[f]);
+    }
+
+    upstream_pos_list(&pos_list, upstream_boundaries);
+    regions = BL_POS_LIST_COUNT(&pos_list) - 1;
+    region_names = xt_malloc(regions + 1, sizeof(*region_names));
+    for (b = 0; (b < regions) && (status == EX_OK); ++b)
+    {
+	snprintf(name, BL_BED_NAME_MAX_CHARS, "upstream%" PRId64,
+		 BL_POS_LIST_POSITIONS_AE(&pos_list, b + 1));
+	status = feature_sort_name(&sorter, name, &region_names[b]);
+    }
+
+    // Everything but the old upstream regions, one sorted run
+    chrom_nums = xt_malloc(fs.count, sizeof(*chrom_nums));
+    for (c = 0; (c < fs.count) && (status == EX_OK); ++c)
+    {
+	chrom = &fs.chroms[c];
+	rec.chrom = chrom_nums[c] = feature_sort_chrom(&sorter, chrom->chrom);
+	for (f = 0; (f < chrom->count) && (status == EX_OK); ++f)
+	{
+	    if ( old_region[chrom->names[f]] )
+		continue;
+	    rec.start = chrom->starts[f];
+	    rec.end = chrom->ends[f];
+	    rec.name = name_nums[chrom->names[f]];
+	    rec.strand = chrom->strands[f];
+	    status = feature_sort_add_rec(&sorter, &rec);
+	}
+	if ( status == EX_OK )
+	    status = feature_sort_end_run(&sorter);
+    }
+
+    // New upstream regions, one more run to merge
+    for (g = 0; (g < header->gene_count) && (status == EX_OK); ++g)
+    {
+	if ( old_genes[g].chrom >= fs.count )
+	{
+	    fprintf(stderr, "peak-classifier: Corrupt gene table in %s.\n",
+		    index_filename);
+	    status = EX_DATAERR;
+	    break;
+	}
+	rec.chrom = chrom_nums[old_genes[g].chrom];
+	rec.strand = old_genes[g].strand;
+	upstream_genes_add(&genes, rec.chrom, old_genes[g].tss, rec.strand);
+	for (b = 0; (b < regions) && (status == EX_OK); ++b)
+	{
+	    upstream_region(old_genes[g].tss, rec.strand, &pos_list, b,
+			    &rec.start, &rec.end);
+	    rec.name = region_names[b];
+	    status = feature_sort_add_rec(&sorter, &rec);
+	}
+    }
+    if ( status == EX_OK )
+	status = feature_sort_end_run(&sorter);
+    stats_end(stage, header->gene_count, sorter.total, fs.map_size, -1);
+
+    snprintf(tmp_filename, PATH_MAX, "%s.%ld.tmp", index_filename,
+	     (long)getpid());
+    if ( status == EX_OK )
+	status = index_write_sorted(&sorter, tmp_filename, &pos_list, &genes,
+				    header->gff3_size, header->gff3_mtime,
+				    stats);
+    free(old_region);
+    free(name_nums);
+    free(region_names);
+    free(chrom_nums);
+    bl_pos_list_free(&pos_list);
+    upstream_genes_free(&genes);
+    feature_sort_free(&sorter);
+    feature_set_free(&fs);
+
+    if ( status == EX_OK )
+    {
+	if ( rename(tmp_filename, index_filename) != 0 )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot replace %s: %s\n",
+		    index_filename, strerror(errno));
+	    unlink(tmp_filename);
+	    return EX_CANTCREAT;
+	}
+	snprintf(augmented_filename, PATH_MAX, "%s-augmented.bed", gff3_stem);
+	if ( unlink(augmented_filename) == 0 )
+	    fprintf(stderr, "Removed %s, which has the old upstream regions.\n",
+		    augmented_filename);
+    }
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write padding to bring a file offset up to FEATURE_INDEX_ALIGN
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void index_align(FILE *index_stream, uint64_t *offset)
+
+{
+    while ( *offset % FEATURE_INDEX_ALIGN != 0 )
+    {
+	putc('\0', index_stream);
+	++*offset;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Start writing a binary index file.  A zeroed header is written
+ *      first and filled in by feature_index_close(), so a truncated
+ *      index is never mistaken for a complete one.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     feature_index_open(feature_index_writer_t *writer,
+			   const char *index_filename)
+
+{
+    feature_index_header_t  header;
+
+    memset(writer, 0, sizeof(*writer));
+    if ( (writer->stream = fopen(index_filename, "w")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot create %s: %s\n",
+		index_filename, strerror(errno));
+	return EX_CANTCREAT;
+    }
+    writer->filename = index_filename;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, writer->stream);
+    writer->offset = sizeof(header);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the arrays of the chromosome being collected, if any
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static int  index_write_chrom(feature_index_writer_t *writer)
+
+{
+    chrom_features_t    *chrom = &writer->current;
+    size_t              count = chrom->count;
+
+    if ( count == 0 )
+	return EX_OK;
+    if ( (fwrite(chrom->starts, sizeof(*chrom->starts), count,
+		 writer->stream) != count) ||
+	 (fwrite(chrom->ends, sizeof(*chrom->ends), count,
+		 writer->stream) != count) ||
+	 (fwrite(chrom->max_ends, sizeof(*chrom->max_ends), count,
+		 writer->stream) != count) ||
+	 (fwrite(chrom->names, sizeof(*chrom->names), count,
+		 writer->stream) != count) ||
+	 (fwrite(chrom->strands, sizeof(*chrom->strands), count,
+		 writer->stream) != count) )
+	return EX_IOERR;
+    writer->offset += count * FEATURE_INDEX_FEATURE_SIZE;
+    writer->dir[writer->dir_count - 1].count = count;
+    chrom->count = 0;
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Append one feature to the index.  Features must arrive grouped
+ *      by chromosome and sorted within each.  The signature matches
+ *      feature_emit_t so this can be passed to feature_sort_finish().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Collect each chromosome as parallel arrays
+ ***************************************************************************/
+
+int     feature_index_add(void *arg, const char *chrom, feature_rec_t *rec)
+
+{
+    feature_index_writer_t  *writer = arg;
+    feature_index_chrom_t   *dir;
+    int                     status;
+
+    if ( (writer->dir_count == 0) ||
+	 (strcmp(writer->dir[writer->dir_count - 1].chrom, chrom) != 0) )
+    {
+	if ( (status = index_write_chrom(writer)) != EX_OK )
+	    return status;
+	if ( writer->dir_count == writer->dir_array_size )
+	{
+	    writer->dir_array_size = writer->dir_array_size == 0 ? 64 :
+				     writer->dir_array_size * 2;
+	    writer->dir = xt_realloc(writer->dir, writer->dir_array_size,
+				     sizeof(*writer->dir));
+	}
+	index_align(writer->stream, &writer->offset);
+	dir = &writer->dir[writer->dir_count++];
+	memset(dir, 0, sizeof(*dir));
+	strncpy(dir->chrom, chrom, BL_CHROM_MAX_CHARS);
+	dir->features_offset = writer->offset;
+    }
+    chrom_features_add(&writer->current, rec->start, rec->end, rec->name,
+		       rec->strand);
+    return EX_OK;
+}
+
+
+/*
+ *  Order genes by chromosome, then + strand before others, then TSS,
+ *  so that each chromosome's TSS arrays are contiguous runs.  Strands
+ *  other than + are measured like -, as in upstream_region().
+ */
+
+static int  gene_cmp(const void *a, const void *b)
+
+{
+    const upstream_gene_t   *g1 = a,
+			    *g2 = b;
+    int     s1 = g1->strand != '+',
+	    s2 = g2->strand != '+';
+
+    if ( g1->chrom != g2->chrom )
+	return g1->chrom < g2->chrom ? -1 : 1;
+    if ( s1 != s2 )
+	return s1 - s2;
+    return (g1->tss > g2->tss) - (g1->tss < g2->tss);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the chromosome directory and feature name table, then the
+ *      completed header, and close the index.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Write the last chromosome's arrays
+ *  2026-10-16  Jason Bacon Write the boundaries and gene table
+ *  2026-10-16  Jason Bacon Write per-strand TSS arrays
+ ***************************************************************************/
+
+int     feature_index_close(feature_index_writer_t *writer,
+			    char **names, size_t name_count)
+
+{
+    feature_index_header_t  header;
+    upstream_gene_t         *genes;
+    feature_index_chrom_t   *dir;
+    int64_t                 pos;
+    size_t                  c,
+			    d,
+			    len,
+			    gene_count;
+    uint32_t                last_chrom = UINT32_MAX;
+    int                     status;
+
+    status = index_write_chrom(writer);
+    index_free_current(writer);
+    memset(&header, 0, sizeof(header));
+
+    // Renumber gene chromosomes to directory entries
+    genes = xt_malloc(writer->genes->count + 1, sizeof(*genes));
+    for (c = gene_count = 0, d = writer->dir_count;
+	 c < writer->genes->count; ++c)
+    {
+	genes[gene_count] = writer->genes->genes[c];
+	if ( genes[gene_count].chrom != last_chrom )
+	{
+	    last_chrom = genes[gene_count].chrom;
+	    for (d = 0; (d < writer->dir_count) &&
+			(strcmp(writer->dir[d].chrom,
+				writer->gene_chroms[last_chrom]) != 0); ++d)
+		;
+	}
+	// Every gene is itself a feature, so this is not expected
+	if ( d == writer->dir_count )
+	    continue;
+	genes[gene_count++].chrom = d;
+    }
+
+    // TSS arrays for --tss-distance
+    qsort(genes, gene_count, sizeof(*genes), gene_cmp);
+    for (c = 0; c < gene_count; )
+    {
+	index_align(writer->stream, &writer->offset);
+	dir = &writer->dir[genes[c].chrom];
+	dir->tss_offset = writer->offset;
+	for (; (c < gene_count) && (&writer->dir[genes[c].chrom] == dir); ++c)
+	{
+	    fwrite(&genes[c].tss, sizeof(genes[c].tss), 1, writer->stream);
+	    if ( genes[c].strand == '+' )
+		++dir->plus_tss_count;
+	    else
+		++dir->minus_tss_count;
+	}
+	writer->offset += (dir->plus_tss_count + dir->minus_tss_count) *
+			  sizeof(genes[c].tss);
+    }
+
+    index_align(writer->stream, &writer->offset);
+    header.chrom_offset = writer->offset;
+    fwrite(writer->dir, sizeof(*writer->dir), writer->dir_count,
+	   writer->stream);
+    writer->offset += writer->dir_count * sizeof(*writer->dir);
+
+    header.name_offset = writer->offset;
+    for (c = 0; c < name_count; ++c)
+    {
+	len = strlen(names[c]) + 1;
+	fwrite(names[c], len, 1, writer->stream);
+	writer->offset += len;
+    }
+
+    index_align(writer->stream, &writer->offset);
+    header.boundary_offset = writer->offset;
+    header.boundary_count = BL_POS_LIST_COUNT(writer->pos_list);
+    for (c = 0; c < header.boundary_count; ++c)
+    {
+	pos = BL_POS_LIST_POSITIONS_AE(writer->pos_list, c);
+	fwrite(&pos, sizeof(pos), 1, writer->stream);
+    }
+    writer->offset += header.boundary_count * sizeof(pos);
+
+    header.gene_offset = writer->offset;
+    header.gene_count = gene_count;
+    fwrite(genes, sizeof(*genes), gene_count, writer->stream);
+    writer->offset += gene_count * sizeof(*genes);
+    free(genes);
+
+    memcpy(header.magic, FEATURE_INDEX_MAGIC, sizeof(FEATURE_INDEX_MAGIC));
+    header.version = FEATURE_INDEX_VERSION;
+    header.byte_order = FEATURE_INDEX_BYTE_ORDER;
+    header.feature_size = FEATURE_INDEX_FEATURE_SIZE;
+    header.chrom_size = sizeof(feature_index_chrom_t);
+    header.chrom_count = writer->dir_count;
+    header.name_count = name_count;
+    header.file_size = writer->offset;
+    header.gene_size = sizeof(upstream_gene_t);
+    header.gff3_size = writer->gff3_size;
+    header.gff3_mtime = writer->gff3_mtime;
+
+    rewind(writer->stream);
+    fwrite(&header, sizeof(header), 1, writer->stream);
+    free(writer->dir);
+    if ( (status != EX_OK) | ferror(writer->stream) |
+	 (fclose(writer->stream) != 0) )
+    {
+	fprintf(stderr, "peak-classifier: Error writing %s.  Removing...\n",
+		writer->filename);
+	unlink(writer->filename);
+	return EX_IOERR;
+    }
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Map a binary feature index into a feature set.  Only the small
+ *      chromosome directory and name pointer table are allocated.  The
+ *      feature arrays are used in place.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Map parallel feature arrays
+ *  2026-10-16  Jason Bacon Map TSS arrays
+ ***************************************************************************/
+
+int     feature_index_map(feature_set_t *fs, const char *index_filename)
+
+{
+    int                     fd;
+    struct stat             file_info;
+    char                    *map,
+			    *name,
+			    *map_end;
+    feature_index_header_t  *header;
+    feature_index_chrom_t   *dir;
+    size_t                  c,
+			    count;
+    chrom_features_t        *chrom;
+
+    if ( (fd = open(index_filename, O_RDONLY)) == -1 )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		index_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    if ( (fstat(fd, &file_info) != 0) ||
+	 (file_info.st_size < (off_t)sizeof(*header)) )
+    {
+	fprintf(stderr, "peak-classifier: %s is not a feature index.\n",
+		index_filename);
+	close(fd);
+	return EX_DATAERR;
+    }
+    map = mmap(NULL, file_info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if ( map == MAP_FAILED )
+    {
+	fprintf(stderr, "peak-classifier: Cannot map %s: %s\n",
+		index_filename, strerror(errno));
+	return EX_OSERR;
+    }
+
+    header = (feature_index_header_t *)map;
+    if ( !index_header_ok(header, file_info.st_size) )
+    {
+	fprintf(stderr, "peak-classifier: %s is incomplete or was built "
+		"by an incompatible version.\n"
+		"Remove it and rerun to rebuild.\n", index_filename);
+	munmap(map, file_info.st_size);
+	return EX_DATAERR;
+    }
+
+    fs->map = map;
+    fs->map_size = file_info.st_size;
+
+    dir = (feature_index_chrom_t *)(map + header->chrom_offset);
+    fs->count = fs->array_size = header->chrom_count;
+    fs->chroms = xt_malloc(fs->count, sizeof(*fs->chroms));
+    for (c = 0; c < fs->count; ++c)
+    {
+	count = dir[c].count;
+	if ( (dir[c].features_offset % FEATURE_INDEX_ALIGN != 0) ||
+	     (dir[c].features_offset + count * FEATURE_INDEX_FEATURE_SIZE >
+		header->chrom_offset) ||
+	     (dir[c].tss_offset % FEATURE_INDEX_ALIGN != 0) ||
+	     (dir[c].tss_offset + (dir[c].plus_tss_count +
+		dir[c].minus_tss_count) * sizeof(int64_t) >
+		header->chrom_offset) )
+	{
+	    fprintf(stderr, "peak-classifier: Corrupt directory in %s.\n",
+		    index_filename);
+	    feature_set_free(fs);
+	    return EX_DATAERR;
+	}
+	chrom = &fs->chroms[c];
+	strcpy(chrom->chrom, dir[c].chrom);
+	chrom->starts = (int64_t *)(map + dir[c].features_offset);
+	chrom->ends = chrom->starts + count;
+	chrom->max_ends = chrom->ends + count;
+	chrom->names = (unsigned short *)(chrom->max_ends + count);
+	chrom->strands = (char *)(chrom->names + count);
+	chrom->count = chrom->array_size = count;
+	chrom->plus_tss = (int64_t *)(map + dir[c].tss_offset);
+	chrom->plus_tss_count = dir[c].plus_tss_count;
+	chrom->minus_tss = chrom->plus_tss + chrom->plus_tss_count;
+	chrom->minus_tss_count = dir[c].minus_tss_count;
+    }
+
+    fs->name_count = fs->name_array_size = header->name_count;
+    fs->map_name_count = fs->name_count;
+    fs->names = xt_malloc(fs->name_count, sizeof(*fs->names));
+    map_end = map + header->file_size;
+    name = map + header->name_offset;
+    for (c = 0; c < fs->name_count; ++c)
+    {
+	if ( (name >= map_end) || (memchr(name, '\0', map_end - name) == NULL) )
+	{
+	    fprintf(stderr, "peak-classifier: Corrupt name table in %s.\n",
+		    index_filename);
+	    feature_set_free(fs);
+	    return EX_DATAERR;
+	}
+	fs->names[c] = name;
+	name += strlen(name) + 1;
+    }
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return true if the upstream boundaries of an index mapped by
+ *      feature_index_map() are upstream_boundaries.  An index checked
+ *      by feature_index_check() may be replaced for other boundaries by
+ *      another process before it is mapped, so a caller that maps it
+ *      without holding the lock must check again.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+bool    feature_index_boundaries_match(const feature_set_t *fs,
+				       const char *upstream_boundaries)
+
+{
+    const feature_index_header_t    *header = fs->map;
+    const int64_t   *positions;
+    bl_pos_list_t   pos_list = BL_POS_LIST_INIT;
+    size_t          c;
+    bool            match;
+
+    upstream_pos_list(&pos_list, upstream_boundaries);
+    positions = (const int64_t *)((char *)fs->map + header->boundary_offset);
+    match = header->boundary_count == BL_POS_LIST_COUNT(&pos_list);
+    for (c = 0; match && (c < header->boundary_count); ++c)
+	match = positions[c] == BL_POS_LIST_POSITIONS_AE(&pos_list, c);
+    bl_pos_list_free(&pos_list);
+    return match;
+}
+
+
+/*
+ *  Mix one 64-bit word into both hash lanes.  Each lane is a bijection
+ *  of its state for a given word, and the rotations carry the high
+ *  bits of the products down into the low bits.
+ */
+
+static inline void  hash_word(uint64_t hash[2], uint64_t word)
+
+{
+    hash[0] = (hash[0] ^ word) * 0x100000001b3ULL;
+    hash[0] = (hash[0] << 29) | (hash[0] >> 35);
+    hash[1] = (hash[1] ^ word) * 0x9e3779b97f4a7c15ULL;
+    hash[1] = (hash[1] << 31) | (hash[1] >> 33);
+}
+
+
+/*
+ *  Hash bytes bytes of buff, which must have room for up to 7 more,
+ *  as whole words, padding the last with zeros
+ */
+
+static void hash_buff(uint64_t hash[2], unsigned char *buff, size_t bytes)
+
+{
+    uint64_t    word;
+    size_t      c;
+
+    while ( bytes % sizeof(word) != 0 )
+	buff[bytes++] = 0;
+    for (c = 0; c < bytes; c += sizeof(word))
+    {
+	memcpy(&word, buff + c, sizeof(word));
+	hash_word(hash, word);
+    }
+}
+
+
+/*
+ *  Hash the content of a GFF.  Reading a large GFF takes far longer
+ *  than mapping its index, so the hash is remembered in a small sum
+ *  file in cache_dir, named by a hash of the absolute path of the GFF
+ *  and holding its size, mtime, device, and inode.  The GFF is read
+ *  again only if one of those has changed.
+ */
+
+static int  gff3_content_hash(const char *cache_dir,
+			      const char *gff3_filename,
+			      const char *base, size_t len, uint64_t hash[2])
+
+{
+    FILE            *stream;
+    struct stat     file_info;
+    unsigned char   *buff;
+    char            path[PATH_MAX + 8],
+		    sum_filename[PATH_MAX + 1],
+		    temp_filename[PATH_MAX + 32];
+    uint64_t        path_hash[2] = { 0xcbf29ce484222325ULL,
+				     0x84222325cbf29ce4ULL },
+		    sum_hash[2],
+		    sum_size,
+		    total = 0;
+    int64_t         sum_mtime;
+    uintmax_t       sum_dev,
+		    sum_ino;
+    size_t          bytes;
+    bool            have_sum = false;
+
+    if ( stat(gff3_filename, &file_info) != 0 )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		gff3_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    // Without an absolute path, just hash the content every time
+    if ( realpath(gff3_filename, path) != NULL )
+    {
+	hash_buff(path_hash, (unsigned char *)path, strlen(path));
+	snprintf(sum_filename, PATH_MAX, "%s/%.*s-%016" PRIx64
+		 FEATURE_INDEX_SUM_EXT, cache_dir, (int)len, base,
+		 path_hash[0]);
+	have_sum = true;
+	if ( (stream = fopen(sum_filename, "r")) != NULL )
+	{
+	    if ( (fscanf(stream, "%" SCNu64 " %" SCNd64 " %ju %ju %"
+			 SCNx64 " %" SCNx64, &sum_size, &sum_mtime, &sum_dev,
+			 &sum_ino, &sum_hash[0], &sum_hash[1]) == 6) &&
+		 (sum_size == (uint64_t)file_info.st_size) &&
+		 (sum_mtime == (int64_t)file_info.st_mtime) &&
+		 (sum_dev == (uintmax_t)file_info.st_dev) &&
+		 (sum_ino == (uintmax_t)file_info.st_ino) )
+	    {
+		fclose(stream);
+		hash[0] = sum_hash[0];
+		hash[1] = sum_hash[1];
+		return EX_OK;
+	    }
+	    fclose(stream);
+	}
+    }
+
+    if ( (stream = fopen(gff3_filename, "r")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		gff3_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    fprintf(stderr, "Hashing %s...\n", gff3_filename);
+    buff = xt_malloc(FEATURE_INDEX_HASH_BUFF_SIZE + sizeof(uint64_t), 1);
+    while ( (bytes = fread(buff, 1, FEATURE_INDEX_HASH_BUFF_SIZE,
+			   stream)) > 0 )
+    {
+	total += bytes;
+	hash_buff(hash, buff, bytes);
+    }
+    free(buff);
+    if ( ferror(stream) )
+    {
+	fprintf(stderr, "peak-classifier: Error reading %s.\n", gff3_filename);
+	fclose(stream);
+	return EX_IOERR;
+    }
+    fclose(stream);
+    hash_word(hash, total);
+
+    // The sum file only saves time, so failing to write it is harmless
+    if ( have_sum )
+    {
+	snprintf(temp_filename, sizeof(temp_filename), "%s.%ld.tmp",
+		 sum_filename, (long)getpid());
+	if ( (stream = fopen(temp_filename, "w")) != NULL )
+	{
+	    fprintf(stream, "%" PRIu64 " %" PRId64 " %ju %ju %016" PRIx64
+		    " %016" PRIx64 "\n", (uint64_t)file_info.st_size,
+		    (int64_t)file_info.st_mtime, (uintmax_t)file_info.st_dev,
+		    (uintmax_t)file_info.st_ino, hash[0], hash[1]);
+	    if ( (fclose(stream) != 0) ||
+		 (rename(temp_filename, sum_filename) != 0) )
+		unlink(temp_filename);
+	}
+    }
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Name the cached index files for a GFF in cache_dir.  The stem
+ *      is the GFF name without its path or .gff3 extension, followed by
+ *      a 128-bit hash of the GFF content and the upstream boundaries,
+ *      so that copies of the same GFF anywhere share one index, and a
+ *      changed GFF never matches an index built from an older one.
+ *      Each boundary set has its own index, so concurrent jobs with
+ *      different boundaries never replace each other's index.
+ *      The content hash is remembered, so an unchanged GFF is read only
+ *      once.  cache_dir is created if it does not exist.  The stem is
+ *      allocated and must be freed by the caller.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Remember the content hash in a sum file
+ *  2026-10-16  Jason Bacon Leave the boundaries to feature_index_update()
+ *  2026-10-16  Jason Bacon Hash the boundaries again, so that concurrent
+ *                          jobs do not update a shared index
+ ***************************************************************************/
+
+int     feature_index_cache_stem(const char *cache_dir,
+				 const char *gff3_filename,
+				 const char *upstream_boundaries, char **stem)
+
+{
+    uint64_t        hash[2] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL };
+    bl_pos_list_t   pos_list = BL_POS_LIST_INIT;
+    const char      *base;
+    size_t          c,
+		    len;
+    int             status;
+
+    if ( (mkdir(cache_dir, 0777) != 0) && (errno != EEXIST) )
+    {
+	fprintf(stderr, "peak-classifier: Cannot create %s: %s\n",
+		cache_dir, strerror(errno));
+	return EX_CANTCREAT;
+    }
+    base = (base = strrchr(gff3_filename, '/')) == NULL ?
+	   gff3_filename : base + 1;
+    len = strstr(base, ".gff3") - base;  // Extension already checked
+    if ( (status = gff3_content_hash(cache_dir, gff3_filename, base, len,
+				     hash)) != EX_OK )
+	return status;
+
+    // The same boundaries in any order build the same index
+    upstream_pos_list(&pos_list, upstream_boundaries);
+    for (c = 0; c < BL_POS_LIST_COUNT(&pos_list); ++c)
+	hash_word(hash, BL_POS_LIST_POSITIONS_AE(&pos_list, c));
+    hash_word(hash, BL_POS_LIST_COUNT(&pos_list));
+    bl_pos_list_free(&pos_list);
+
+    *stem = xt_malloc(strlen(cache_dir) + len + 35, 1);
+    sprintf(*stem, "%s/%.*s-%016" PRIx64 "%016" PRIx64, cache_dir,
+	    (int)len, base, hash[0], hash[1]);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Lock index_filename for building, waiting for any other process
+ *      building it to finish.  The lock is an fcntl() lock on a
+ *      separate lock file, which works over NFS where flock() may not,
+ *      and is released if the holder dies.  The holder removes the lock
+ *      file when done, so none is left next to the GFF.  A waiter that
+ *      then gets the lock on the removed file tries again, so that two
+ *      processes never hold locks on different files at once.  The
+ *      caller should check the index again once the lock is held,
+ *      since another process may have just built it.  Returns the lock
+ *      file descriptor for feature_index_unlock(), or -1 if locking is
+ *      not possible, in which case the index is built unlocked.  Since
+ *      all index files are renamed into place, that costs only
+ *      duplicate work.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Remove the lock file in feature_index_unlock()
+ ***************************************************************************/
+
+int     feature_index_lock(const char *index_filename)
+
+{
+    char            lock_filename[PATH_MAX + 1];
+    struct flock    lock;
+    struct stat     fd_info,
+		    path_info;
+    int             fd,
+		    status;
+    bool            waiting = false;
+
+    snprintf(lock_filename, PATH_MAX, "%s" FEATURE_INDEX_LOCK_EXT,
+	     index_filename);
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    for (;;)
+    {
+	if ( (fd = open(lock_filename, O_RDWR | O_CREAT, 0666)) == -1 )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot create %s: %s\n"
+		    "Building %s without a lock.\n", lock_filename,
+		    strerror(errno), index_filename);
+	    return -1;
+	}
+	if ( ((status = fcntl(fd, F_SETLK, &lock)) != 0) &&
+	     ((errno == EACCES) || (errno == EAGAIN)) )
+	{
+	    if ( !waiting )
+		fprintf(stderr, "Waiting for another process to build %s...\n",
+			index_filename);
+	    waiting = true;
+	    while ( ((status = fcntl(fd, F_SETLKW, &lock)) != 0) &&
+		    (errno == EINTR) )
+		;
+	}
+	if ( status != 0 )
+	    break;
+	// Still the lock file, not one removed by the last holder
+	if ( (fstat(fd, &fd_info) == 0) &&
+	     (stat(lock_filename, &path_info) == 0) &&
+	     (fd_info.st_dev == path_info.st_dev) &&
+	     (fd_info.st_ino == path_info.st_ino) )
+	    return fd;
+	close(fd);
+    }
+    fprintf(stderr, "peak-classifier: Cannot lock %s: %s\n"
+	    "Building %s without a lock.\n", lock_filename,
+	    strerror(errno), index_filename);
+    close(fd);
+    return -1;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Release a lock from feature_index_lock() and remove the lock
+ *      file.  It is removed while still locked, so a process waiting on
+ *      it sees that it is gone and locks a new one.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Remove the lock file
+ ***************************************************************************/
+
+void    feature_index_unlock(const char *index_filename, int fd)
+
+{
+    char    lock_filename[PATH_MAX + 1];
+
+    if ( fd != -1 )
+    {
+	snprintf(lock_filename, PATH_MAX, "%s" FEATURE_INDEX_LOCK_EXT,
+		 index_filename);
+	unlink(lock_filename);
+	// Closing releases the fcntl() lock
+	close(fd);
+    }
+}
@@ -0,0 +1,147 @@
+#ifndef _FEATURE_INDEX_H_
+#define _FEATURE_INDEX_H_
+
+/*
+ *  Binary feature index, written once per GFF by peak-classifier-index
+ *  or the first peak-classifier run, and mmap()ed by later runs.
+ *
+ *  Layout:
+ *      feature_index_header_t
+ *      Feature arrays, one block per chromosome, sorted as for
+ *      classify_peak(), each holding the chrom_features_t arrays
+ *      starts[], ends[], max_ends[], names[], strands[] in that order
+ *      TSS arrays, one block per chromosome with genes, holding the
+ *      sorted chrom_features_t plus_tss[] and minus_tss[]
+ *      feature_index_chrom_t directory, chrom_count entries
+ *      Feature name table, name_count NUL-terminated strings
+ *      Upstream boundary positions, boundary_count int64_t, starting
+ *      with 0 as from upstream_pos_list()
+ *      Genes with upstream regions, gene_count upstream_gene_t, whose
+ *      chrom is a directory index
+ *
+ *  The index is written in native byte order and struct layout.  The
+ *  byte order and record sizes are stored in the header so that an
+ *  index copied from an incompatible host is rejected rather than
+ *  misread.
+ *
+ *  The size and modification time of the GFF and the boundaries are
+ *  recorded so that a stale index is detected.  If only the boundaries
+ *  differ, the upstream regions are regenerated from the gene table
+ *  and merged with the other features, without reading the GFF.  A
+ *  rebuilt or updated index is mapped before the lock is released, and
+ *  an index mapped without the lock is checked again for the expected
+ *  boundaries, since another job may have updated it in between.
+ *
+ *  With --cache-dir or FEATURE_INDEX_CACHE_ENV, indexes are kept in a
+ *  shared directory instead of next to the GFF, named by a hash of the
+ *  GFF content and boundaries, so jobs with different boundaries use
+ *  different indexes and never update one in place.  The content
+ *  hash is remembered in a sum file keyed on the path, size, and mtime
+ *  of the GFF, so that a cached index is found without reading the
+ *  GFF.  Index files are always written under temporary names and
+ *  renamed into place, and a lock file lets one process build a
+ *  missing index while others wait to use it.  The lock file is removed
+ *  by the process that built the index.
+ */
+
+#define FEATURE_INDEX_EXT       "-augmented.pci"
+#define FEATURE_INDEX_MAGIC     "PCINDEX"
+#define FEATURE_INDEX_VERSION   4
+#define FEATURE_INDEX_BYTE_ORDER 0x01020304
+#define FEATURE_INDEX_ALIGN     8
+#define FEATURE_INDEX_LOCK_EXT  ".lock"
+#define FEATURE_INDEX_CACHE_ENV "PEAK_CLASSIFIER_CACHE_DIR"
+#define FEATURE_INDEX_HASH_BUFF_SIZE    (1024 * 1024)
+#define FEATURE_INDEX_SUM_EXT   ".sum"
+// Bytes per feature across all arrays of a chromosome block
+#define FEATURE_INDEX_FEATURE_SIZE \
+    (3 * sizeof(int64_t) + sizeof(unsigned short) + sizeof(char))
+
+typedef struct
+{
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    byte_order;
+    uint32_t    feature_size;
+    uint32_t    chrom_size;
+    uint64_t    chrom_count;
+    uint64_t    chrom_offset;
+    uint64_t    name_count;
+    uint64_t    name_offset;
+    uint64_t    file_size;
+    uint32_t    gene_size;
+    uint32_t    boundary_count;
+    uint64_t    boundary_offset;
+    uint64_t    gene_count;
+    uint64_t    gene_offset;
+    uint64_t    gff3_size;      // 0 if the GFF was read from stdin
+    int64_t     gff3_mtime;
+}   feature_index_header_t;
+
+typedef struct
+{
+    char        chrom[BL_CHROM_MAX_CHARS + 1];
+    uint64_t    features_offset;
+    uint64_t    count;
+    uint64_t    tss_offset;
+    uint64_t    plus_tss_count;
+    uint64_t    minus_tss_count;
+}   feature_index_chrom_t;
+
+/*
+ *  Streaming index writer.  Features arrive in sorted order from the
+ *  sorter, so each chromosome's arrays are written as it completes and
+ *  only one chromosome is held in memory.
+ */
+
+typedef struct
+{
+    FILE                    *stream;
+    const char              *filename;
+    uint64_t                offset;
+    chrom_features_t        current;
+    feature_index_chrom_t   *dir;
+    size_t                  dir_count;
+    size_t                  dir_array_size;
+    // Set before feature_index_close(), from feature_index_create()
+    bl_pos_list_t           *pos_list;
+    upstream_genes_t        *genes;     // chrom refers to gene_chroms
+    char                    **gene_chroms;
+    uint64_t                gff3_size;
+    int64_t                 gff3_mtime;
+}   feature_index_writer_t;
+
+// feature_index_check() results
+#define FEATURE_INDEX_CURRENT       0
+#define FEATURE_INDEX_MISSING       1
+#define FEATURE_INDEX_STALE         2   // Wrong version or GFF changed
+#define FEATURE_INDEX_BOUNDARIES    3   // Only upstream boundaries changed
+
+/* feature-index.c */
+int     feature_index_create(FILE *gff3_stream, const char *gff3_filename,
+			     const char *gff3_stem,
+			     const char *upstream_boundaries,
+			     const char *index_filename, const char *temp_dir,
+			     stats_t *stats);
+int     feature_index_check(const char *index_filename,
+			    const char *gff3_filename,
+			    const char *upstream_boundaries);
+int     feature_index_update(const char *index_filename,
+			     const char *gff3_stem,
+			     const char *upstream_boundaries,
+			     const char *temp_dir, stats_t *stats);
+int     feature_index_open(feature_index_writer_t *writer,
+			   const char *index_filename);
+int     feature_index_add(void *arg, const char *chrom, feature_rec_t *rec);
+int     feature_index_close(feature_index_writer_t *writer,
+			    char **names, size_t name_count);
+int     feature_index_map(feature_set_t *fs, const char *index_filename);
+bool    feature_index_boundaries_match(const feature_set_t *fs,
+				       const char *upstream_boundaries);
+int     feature_index_cache_stem(const char *cache_dir,
+				 const char *gff3_filename,
+				 const char *upstream_boundaries, char **stem);
+int     feature_index_lock(const char *index_filename);
+void    feature_index_unlock(const char *index_filename, int fd);
+
+#endif  // _FEATURE_INDEX_H_
@@ -0,0 +1,663 @@
+/***************************************************************************
+ *  Description:
+ *      Sort augmented features in-process, replacing grep | sort.
+ *
+ *      gff3_augment() output is nearly sorted already: each gene block
+ *      is short, and blocks follow GFF order.  Each block is sorted as
+ *      a run when it ends, and consecutive runs that are already in
+ *      order are coalesced.  The runs are then combined with a k-way
+ *      heap merge.  If the buffer fills, its runs are merged into a
+ *      temporary spill file and the spill files are merged at the end,
+ *      so memory use is bounded regardless of genome size.
+ *
+ *      The order matches LC_ALL=C sort -n -k 1 -k 2 -k 3 on the BED
+ *      text: chromosome number, start, end, then the rest of the line,
+ *      which is the feature name and strand.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xtend/mem.h>
+#include <xtend/math.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "rank.h"
+#include "peak-sort.h"
+#include "feature-sort.h"
+
+/***************************************************************************
+ *  Description:
+ *      Initialize a sorter holding at most max_recs records in memory.
+ *      Spill files go in temp_dir, or $TMPDIR or /tmp if temp_dir is
+ *      NULL.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Add temp_dir for --temp-dir
+ ***************************************************************************/
+
+void    feature_sort_init(feature_sort_t *sorter, size_t max_recs,
+			  const char *temp_dir)
+
+{
+    memset(sorter, 0, sizeof(*sorter));
+    sorter->max_recs = max_recs;
+    if ( (temp_dir == NULL) && ((temp_dir = getenv("TMPDIR")) == NULL) )
+	temp_dir = "/tmp";
+    sorter->temp_dir = temp_dir;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Free all memory and spill files used by a sorter
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    feature_sort_free(feature_sort_t *sorter)
+
+{
+    size_t  c;
+
+    for (c = 0; c < sorter->chrom_count; ++c)
+	free(sorter->chroms[c]);
+    for (c = 0; c < sorter->name_count; ++c)
+	free(sorter->names[c]);
+    for (c = 0; c < sorter->spill_count; ++c)
+	fclose(sorter->spills[c]);
+    free(sorter->recs);
+    free(sorter->runs);
+    free(sorter->chroms);
+    free(sorter->chrom_nums);
+    free(sorter->names);
+    free(sorter->spills);
+    memset(sorter, 0, sizeof(*sorter));
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the index of a string in a table, adding it if necessary.
+ *      Tables are small (chromosomes and feature names), and the most
+ *      recent entry is checked first since consecutive features usually
+ *      share a chromosome.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static size_t   intern(char ***table, size_t *count, size_t *array_size,
+		       const char *str)
+
+{
+    size_t  c;
+
+    if ( (*count > 0) && (strcmp((*table)[*count - 1], str) == 0) )
+	return *count - 1;
+    for (c = 0; c < *count; ++c)
+	if ( strcmp((*table)[c], str) == 0 )
+	    return c;
+    if ( *count == *array_size )
+    {
+	*array_size = *array_size == 0 ? 64 : *array_size * 2;
+	*table = xt_realloc(*table, *array_size, sizeof(**table));
+    }
+    (*table)[*count] = strdup(str);
+    return (*count)++;
+}
+
+
+static int  rec_cmp(feature_sort_t *sorter,
+		    const feature_rec_t *r1, const feature_rec_t *r2)
+
+{
+    int     status;
+
+    if ( r1->chrom != r2->chrom )
+    {
+	if ( sorter->chrom_nums[r1->chrom] != sorter->chrom_nums[r2->chrom] )
+	    return sorter->chrom_nums[r1->chrom] <
+		   sorter->chrom_nums[r2->chrom] ? -1 : 1;
+	return strcmp(sorter->chroms[r1->chrom], sorter->chroms[r2->chrom]);
+    }
+    if ( r1->start != r2->start )
+	return r1->start < r2->start ? -1 : 1;
+    if ( r1->end != r2->end )
+	return r1->end < r2->end ? -1 : 1;
+    if ( r1->name != r2->name )
+    {
+	status = strcmp(sorter->names[r1->name], sorter->names[r2->name]);
+	if ( status != 0 )
+	    return status;
+    }
+    return r1->strand - r2->strand;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Restore the max-heap property of recs[0] to recs[count - 1],
+ *      moving recs[top] down to its place.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void run_sift_down(feature_sort_t *sorter, feature_rec_t *recs,
+			  size_t count, size_t top)
+
+{
+    feature_rec_t   rec = recs[top];
+    size_t          child;
+
+    while ( (child = 2 * top + 1) < count )
+    {
+	if ( (child + 1 < count) &&
+	     (rec_cmp(sorter, &recs[child + 1], &recs[child]) > 0) )
+	    ++child;
+	if ( rec_cmp(sorter, &recs[child], &rec) <= 0 )
+	    break;
+	recs[top] = recs[child];
+	top = child;
+    }
+    recs[top] = rec;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Sort one run in place.  Unlike qsort(), this passes the sorter to
+ *      rec_cmp() directly, so sorters in different threads, such as
+ *      pc_features_from_gff3() callers, share no state.  Runs are
+ *      usually short gene blocks, often nearly sorted, which insertion
+ *      sort handles best.  Longer runs that are not sorted already are
+ *      heap sorted, which needs no memory beyond the buffer.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void run_sort(feature_sort_t *sorter, feature_rec_t *recs,
+		     size_t count)
+
+{
+    feature_rec_t   rec;
+    size_t          c,
+		    d;
+
+    if ( count > FEATURE_SORT_INSERTION_MAX )
+    {
+	for (c = 1; (c < count) &&
+		    (rec_cmp(sorter, &recs[c - 1], &recs[c]) <= 0); ++c)
+	    ;
+	if ( c == count )
+	    return;
+	for (c = count / 2; c-- > 0; )
+	    run_sift_down(sorter, recs, count, c);
+	for (c = count - 1; c > 0; --c)
+	{
+	    rec = recs[0];
+	    recs[0] = recs[c];
+	    recs[c] = rec;
+	    run_sift_down(sorter, recs, c, 0);
+	}
+	return;
+    }
+
+    for (c = 1; c < count; ++c)
+    {
+	rec = recs[c];
+	for (d = c; (d > 0) && (rec_cmp(sorter, &recs[d - 1], &rec) > 0); --d)
+	    recs[d] = recs[d - 1];
+	recs[d] = rec;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the number of a chromosome name in the sorter, adding it
+ *      if necessary
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+uint32_t    feature_sort_chrom(feature_sort_t *sorter, const char *chrom)
+
+{
+    size_t  c,
+	    chrom_count;
+
+    chrom_count = sorter->chrom_count;
+    c = intern(&sorter->chroms, &sorter->chrom_count,
+	       &sorter->chrom_array_size, chrom);
+    if ( sorter->chrom_count > chrom_count )
+    {
+	sorter->chrom_nums = xt_realloc(sorter->chrom_nums,
+			sorter->chrom_array_size, sizeof(*sorter->chrom_nums));
+	// Same as sort -n: leading digits, 0 if none
+	sorter->chrom_nums[c] = strtol(sorter->chroms[c], NULL, 10);
+    }
+    return c;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Set *name_num to the number of a feature name in the sorter,
+ *      adding it if necessary
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     feature_sort_name(feature_sort_t *sorter, const char *name,
+			  uint16_t *name_num)
+
+{
+    size_t  c;
+
+    c = intern(&sorter->names, &sorter->name_count,
+	       &sorter->name_array_size, name);
+    if ( c > UINT16_MAX )
+    {
+	fputs("feature_sort_name(): Too many distinct feature names.\n", stderr);
+	return EX_DATAERR;
+    }
+    *name_num = c;
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add one feature to the open run
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     feature_sort_add(feature_sort_t *sorter, bl_bed_t *bed_feature)
+
+{
+    feature_rec_t   rec;
+    int             status;
+
+    rec.start = BL_BED_CHROM_START(bed_feature);
+    rec.end = BL_BED_CHROM_END(bed_feature);
+    rec.strand = BL_BED_STRAND(bed_feature);
+    rec.chrom = feature_sort_chrom(sorter, BL_BED_CHROM(bed_feature));
+    if ( (status = feature_sort_name(sorter, BL_BED_NAME(bed_feature),
+				     &rec.name)) != EX_OK )
+	return status;
+    return feature_sort_add_rec(sorter, &rec);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add one feature whose chromosome and name numbers are already
+ *      known to the open run
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     feature_sort_add_rec(feature_sort_t *sorter, const feature_rec_t *rec)
+
+{
+    int     status;
+
+    if ( sorter->count == sorter->max_recs )
+    {
+	// A single run larger than the buffer is split, which is harmless
+	if ( (status = feature_sort_end_run(sorter)) != EX_OK )
+	    return status;
+	if ( (status = feature_sort_spill(sorter)) != EX_OK )
+	    return status;
+    }
+    else if ( sorter->count == sorter->array_size )
+    {
+	sorter->array_size = sorter->array_size == 0 ?
+			     XT_MIN(65536, sorter->max_recs) :
+			     XT_MIN(sorter->array_size * 2, sorter->max_recs);
+	sorter->recs = xt_realloc(sorter->recs, sorter->array_size,
+				  sizeof(*sorter->recs));
+    }
+
+    sorter->recs[sorter->count++] = *rec;
+    ++sorter->total;
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Close the open run, normally at the end of a gene block.  If the
+ *      sorted run continues the previous one, the two are coalesced.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Sort with run_sort() instead of qsort()
+ ***************************************************************************/
+
+int     feature_sort_end_run(feature_sort_t *sorter)
+
+{
+    size_t  run_len = sorter->count - sorter->run_start;
+
+    if ( run_len == 0 )
+	return EX_OK;
+
+    run_sort(sorter, sorter->recs + sorter->run_start, run_len);
+
+    if ( (sorter->run_count == 0) ||
+	 (rec_cmp(sorter, &sorter->recs[sorter->run_start - 1],
+		  &sorter->recs[sorter->run_start]) > 0) )
+    {
+	if ( sorter->run_count == sorter->run_array_size )
+	{
+	    sorter->run_array_size = sorter->run_array_size == 0 ? 1024 :
+				     sorter->run_array_size * 2;
+	    sorter->runs = xt_realloc(sorter->runs, sorter->run_array_size,
+				      sizeof(*sorter->runs));
+	}
+	sorter->runs[sorter->run_count++] = sorter->run_start;
+    }
+    sorter->run_start = sorter->count;
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Maintain the min-heap property for a k-way merge, moving
+ *      heap[top] down to its place.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void heap_sift_down(feature_sort_t *sorter, sort_source_t **heap,
+			   size_t count, size_t top)
+
+{
+    size_t          child;
+    sort_source_t   *temp;
+
+    while ( (child = top * 2 + 1) < count )
+    {
+	if ( (child + 1 < count) &&
+	     (rec_cmp(sorter, heap[child + 1]->next, heap[child]->next) < 0) )
+	    ++child;
+	if ( rec_cmp(sorter, heap[top]->next, heap[child]->next) <= 0 )
+	    break;
+	temp = heap[top];
+	heap[top] = heap[child];
+	heap[child] = temp;
+	top = child;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Refill a spill file source.  Return false when it is exhausted.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static bool source_refill(sort_source_t *source)
+
+{
+    size_t  count;
+
+    if ( source->stream == NULL )
+	return false;
+    count = fread(source->buf, sizeof(*source->buf), FEATURE_SORT_SPILL_BUF,
+		  source->stream);
+    source->next = source->buf;
+    source->end = source->buf + count;
+    return count > 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Merge sorted sources, passing each record to emit() in order
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static int  merge_sources(feature_sort_t *sorter, sort_source_t *sources,
+			  size_t source_count, feature_emit_t emit, void *arg)
+
+{
+    sort_source_t   **heap,
+		    *top;
+    size_t          c,
+		    count;
+    int             status = EX_OK;
+
+    heap = xt_malloc(source_count, sizeof(*heap));
+    for (c = count = 0; c < source_count; ++c)
+	if ( (sources[c].next < sources[c].end) || source_refill(&sources[c]) )
+	    heap[count++] = &sources[c];
+    for (c = count / 2; c-- > 0; )
+	heap_sift_down(sorter, heap, count, c);
+
+    while ( count > 0 )
+    {
+	top = heap[0];
+	status = emit(arg, sorter->chroms[top->next->chrom], top->next);
+	if ( status != EX_OK )
+	    break;
+	if ( (++top->next == top->end) && !source_refill(top) )
+	    heap[0] = heap[--count];
+	heap_sift_down(sorter, heap, count, 0);
+    }
+    free(heap);
+    return status;
+}
+
+
+static int  spill_emit(void *arg, const char *chrom, feature_rec_t *rec)
+
+{
+    // Spill files hold chrom indexes, not names
+    (void)chrom;
+    return fwrite(rec, sizeof(*rec), 1, (FILE *)arg) == 1 ? EX_OK : EX_IOERR;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Set up one merge source per closed run in the buffer
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static sort_source_t *buffer_sources(feature_sort_t *sorter)
+
+{
+    sort_source_t   *sources;
+    size_t          c;
+
+    sources = xt_malloc(sorter->run_count, sizeof(*sources));
+    for (c = 0; c < sorter->run_count; ++c)
+    {
+	sources[c].next = sources[c].buf = sorter->recs + sorter->runs[c];
+	sources[c].end = c + 1 < sorter->run_count ?
+			 sorter->recs + sorter->runs[c + 1] :
+			 sorter->recs + sorter->count;
+	sources[c].stream = NULL;
+    }
+    return sources;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Merge the runs in the buffer into a new spill file and empty the
+ *      buffer.  Spill files go in the sorter's temp_dir, and are
+ *      unlinked immediately so they cannot be left behind.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Use temp_file_create() in temp_dir
+ ***************************************************************************/
+
+int     feature_sort_spill(feature_sort_t *sorter)
+
+{
+    int             status;
+    FILE            *spill_stream;
+    sort_source_t   *sources;
+
+    if ( (spill_stream = temp_file_create(sorter->temp_dir)) == NULL )
+	return EX_CANTCREAT;
+
+    sources = buffer_sources(sorter);
+    status = merge_sources(sorter, sources, sorter->run_count, spill_emit,
+			   spill_stream);
+    free(sources);
+    if ( (status != EX_OK) || (fflush(spill_stream) != 0) )
+    {
+	fprintf(stderr, "peak-classifier: Error writing spill file in %s.\n",
+		sorter->temp_dir);
+	fclose(spill_stream);
+	return EX_IOERR;
+    }
+    rewind(spill_stream);
+
+    if ( sorter->spill_count == sorter->spill_array_size )
+    {
+	sorter->spill_array_size = sorter->spill_array_size == 0 ? 16 :
+				   sorter->spill_array_size * 2;
+	sorter->spills = xt_realloc(sorter->spills, sorter->spill_array_size,
+				    sizeof(*sorter->spills));
+    }
+    sorter->spills[sorter->spill_count++] = spill_stream;
+    sorter->count = sorter->run_start = sorter->run_count = 0;
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add features from an existing augmented BED file.  Header and
+ *      "###" lines are skipped, and the latter end a run.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     feature_sort_read_bed(feature_sort_t *sorter, FILE *bed_stream)
+
+{
+    bl_bed_t    bed_feature = BL_BED_INIT;
+    int         ch,
+		status;
+
+    for (;;)
+    {
+	while ( (ch = getc(bed_stream)) == '#' )
+	{
+	    while ( ((ch = getc(bed_stream)) != '\n') && (ch != EOF) )
+		;
+	    if ( (status = feature_sort_end_run(sorter)) != EX_OK )
+		return status;
+	}
+	if ( ch == EOF )
+	    break;
+	ungetc(ch, bed_stream);
+	if ( bl_bed_read(&bed_feature, bed_stream, BL_BED_FIELD_ALL) != BL_READ_OK )
+	    break;
+	if ( (status = feature_sort_add(sorter, &bed_feature)) != EX_OK )
+	    return status;
+    }
+    return feature_sort_end_run(sorter);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Merge everything added so far, passing features to emit() in
+ *      sorted order
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     feature_sort_finish(feature_sort_t *sorter, feature_emit_t emit,
+			    void *arg)
+
+{
+    sort_source_t   *sources;
+    size_t          c;
+    int             status;
+
+    if ( (status = feature_sort_end_run(sorter)) != EX_OK )
+	return status;
+
+    if ( sorter->spill_count == 0 )
+    {
+	sources = buffer_sources(sorter);
+	status = merge_sources(sorter, sources, sorter->run_count, emit, arg);
+	free(sources);
+    }
+    else
+    {
+	if ( (sorter->count > 0) &&
+	     ((status = feature_sort_spill(sorter)) != EX_OK) )
+	    return status;
+	// Reuse the empty buffer to read back the spill files
+	if ( sorter->spill_count * FEATURE_SORT_SPILL_BUF > sorter->array_size )
+	{
+	    sorter->array_size = sorter->spill_count * FEATURE_SORT_SPILL_BUF;
+	    sorter->recs = xt_realloc(sorter->recs, sorter->array_size,
+				      sizeof(*sorter->recs));
+	}
+	sources = xt_malloc(sorter->spill_count, sizeof(*sources));
+	for (c = 0; c < sorter->spill_count; ++c)
+	{
+	    sources[c].buf = sorter->recs + c * FEATURE_SORT_SPILL_BUF;
+	    sources[c].next = sources[c].end = sources[c].buf;
+	    sources[c].stream = sorter->spills[c];
+	}
+	status = merge_sources(sorter, sources, sorter->spill_count, emit, arg);
+	free(sources);
+    }
+    return status;
+}
@@ -0,0 +1,86 @@
+#ifndef _FEATURE_SORT_H_
+#define _FEATURE_SORT_H_
+
+/*
+ *  Default cap on augmented features held in memory while sorting.
+ *  Beyond this, sorted chunks are spilled to temporary files and
+ *  merged at the end.  32 bytes per feature, so about 256 MiB.
+ */
+#ifndef FEATURE_SORT_MAX_RECS
+#define FEATURE_SORT_MAX_RECS   (8 * 1024 * 1024)
+#endif
+
+// Longer runs are heap sorted instead of insertion sorted
+#define FEATURE_SORT_INSERTION_MAX  32
+
+// Records read back from each spill file at a time during the final merge
+#define FEATURE_SORT_SPILL_BUF  4096
+
+typedef struct
+{
+    int64_t         start;
+    int64_t         end;
+    uint32_t        chrom;      // Index into sorter chrom table
+    uint16_t        name;       // Index into sorter name table
+    char            strand;
+}   feature_rec_t;
+
+/*
+ *  A sorted sequence of records being merged, either part of the
+ *  in-memory buffer or a spill file read back a block at a time.
+ */
+
+typedef struct
+{
+    feature_rec_t   *next;
+    feature_rec_t   *end;
+    feature_rec_t   *buf;
+    FILE            *stream;
+}   sort_source_t;
+
+typedef int (*feature_emit_t)(void *arg, const char *chrom,
+			      feature_rec_t *rec);
+
+typedef struct
+{
+    feature_rec_t   *recs;
+    size_t          count;
+    size_t          array_size;
+    size_t          max_recs;
+    size_t          total;          // Records added, including spilled
+    size_t          run_start;      // First record of the open run
+    size_t          *runs;          // First record of each closed run
+    size_t          run_count;
+    size_t          run_array_size;
+    char            **chroms;
+    long            *chrom_nums;    // Numeric value of each chrom name
+    size_t          chrom_count;
+    size_t          chrom_array_size;
+    char            **names;
+    size_t          name_count;
+    size_t          name_array_size;
+    const char      *temp_dir;      // For spill files
+    FILE            **spills;
+    size_t          spill_count;
+    size_t          spill_array_size;
+}   feature_sort_t;
+
+#define FEATURE_SORT_NAME_AE(s,c)   ((s)->names[c])
+#define FEATURE_SORT_NAME_COUNT(s)  ((s)->name_count)
+
+/* feature-sort.c */
+void    feature_sort_init(feature_sort_t *sorter, size_t max_recs,
+			  const char *temp_dir);
+void    feature_sort_free(feature_sort_t *sorter);
+uint32_t    feature_sort_chrom(feature_sort_t *sorter, const char *chrom);
+int     feature_sort_name(feature_sort_t *sorter, const char *name,
+			  uint16_t *name_num);
+int     feature_sort_add(feature_sort_t *sorter, bl_bed_t *bed_feature);
+int     feature_sort_add_rec(feature_sort_t *sorter, const feature_rec_t *rec);
+int     feature_sort_end_run(feature_sort_t *sorter);
+int     feature_sort_spill(feature_sort_t *sorter);
+int     feature_sort_read_bed(feature_sort_t *sorter, FILE *bed_stream);
+int     feature_sort_finish(feature_sort_t *sorter, feature_emit_t emit,
+			    void *arg);
+
+#endif  // _FEATURE_SORT_H_
@@ -10,6 +10,7 @@
 #   History: 
 #   Date        Name        Modification
 #   2021-04-21  Jason Bacon Begin
+#   2026-10-16  Jason Bacon Read the standard input for "-"
 
 import sys,os
 # Pkgsrc
@@ -30,11 +31,15 @@ bed_file=sys.argv[1]
 #############################################################################
 #   Read BED file into lists of positions and feature names for bar graph
 
-f=open(bed_file,"r")
+# "-" reads a gene from extract-genes --lookup
+if bed_file == "-":
+    f=sys.stdin
+else:
+    f=open(bed_file,"r")
 features=[]
 lengths=[]
 fstarts=[]
-for line in f.readlines():
+for line in f:
     a=line.split()
     features.append(a[3])
     lengths.append(int(a[2])-int(a[1]))
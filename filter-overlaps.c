@@ -12,9 +12,24 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <strings.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <xtend/file.h>
-#include <xtend/dsv.h>
+#include <xtend/mem.h>
+#include <xtend/math.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "fast-write.h"
+#include "overlaps-bin.h"
+#include "stats.h"
 #include "filter-overlaps.h"
 
 int     main(int argc,char *argv[])
@@ -22,178 +37,826 @@ int     main(int argc,char *argv[])
 {
     char    *overlaps_file,
 	    *output_file,
-	    **features;
+	    **features,
+	    *end;
+    int     c,
+	    used;
+    unsigned long   threads = 1;
+    stats_t stats = STATS_INIT("filter-overlaps");
 
-    switch(argc)
+    for (c = 1; (c < argc) && (memcmp(argv[c], "--", 2) == 0); ++c)
     {
-	case    1:
-	case    2:
-	case    3:
+	if ( (strcmp(argv[c], "--threads") == 0) && (c < argc - 1) )
+	{
+	    threads = strtoul(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (threads < 1) || (threads > 1024) )
+		usage(argv);
+	}
+	else if ( (used = stats_parse(&stats, argv[c])) != 0 )
+	{
+	    if ( used < 0 )
+		usage(argv);
+	}
+	else
 	    usage(argv);
-
-	default:
-	    overlaps_file = argv[1];
-	    output_file = argv[2];
-	    features = argv + 3;
-	    break;
     }
-    return filter_overlaps(overlaps_file, output_file, features);
+    if ( argc - c < 3 )
+	usage(argv);
+
+    overlaps_file = argv[c];
+    output_file = argv[c + 1];
+    features = argv + c + 2;
+    return filter_overlaps(overlaps_file, output_file, features, threads,
+			   &stats);
 }
 
 
 /***************************************************************************
  *  Description:
- *      Process overlaps
+ *      Process overlaps.  Uncompressed files are split into chunks
+ *      filtered in parallel when threads > 1.  Otherwise, input is
+ *      streamed, which also handles pipes, compressed files, and
+ *      binary overlaps files from peak-classifier.
  *
  *  History: 
  *  Date        Name        Modification
  *  2021-04-30  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Replace DSV copies with swapped line buffers
+ *  2026-10-16  Jason Bacon Add chunked multithreaded filtering
+ *  2026-10-16  Jason Bacon Add --stats
  ***************************************************************************/
 
 int     filter_overlaps(const char *overlaps_file, const char *output_file,
-			char *features[])
+			char *features[], unsigned threads, stats_t *stats)
 
 {
     FILE        *infile,
 		*outfile;
-    xt_dsv_line_t  *dsv_line = xt_dsv_line_new(),
-		*keeper = xt_dsv_line_new(),
-		*last_line = xt_dsv_line_new();
-    int         delim;
-    size_t      keeper_rank,
-		new_rank,
-		c;
-    unsigned long   unique_peaks = 0,
-		    feature_overlaps[MAX_OVERLAP_FEATURES];
+    feature_hash_t  hash;
+    filter_t    filter;
+    overlaps_bin_reader_t   reader;
+    overlap_t   record;
+    stats_stage_t   *stage;
+    int64_t     bytes_out;
+    unsigned long   kept;
+    int         status;
+    size_t      c;
     
-    if ( strcmp(overlaps_file, "-") == 0 )
-	infile = stdin;
-    else if ( (infile = xt_fopen(overlaps_file, "r")) == NULL )
+    for (c = 0; features[c] != NULL; ++c)
+	;
+    if ( c > MAX_OVERLAP_FEATURES )
     {
-	fprintf(stderr, "filter-overlaps: Cannot open %s: %s\n",
-		overlaps_file, strerror(errno));
-	return EX_NOINPUT;
+	fprintf(stderr, "filter-overlaps: No more than %d features allowed.\n",
+		MAX_OVERLAP_FEATURES);
+	return EX_USAGE;
     }
-    
+    feature_hash_init(&hash, features);
+
     if ( strcmp(output_file, "-") == 0 )
 	outfile = stdout;
     else if ( (outfile = xt_fopen(output_file, "w")) == NULL )
     {
 	fprintf(stderr, "filter-overlaps: Cannot open %s: %s\n",
-		overlaps_file, strerror(errno));
+		output_file, strerror(errno));
 	return EX_CANTCREAT;
     }
-    
-    for (c = 0; c < MAX_OVERLAP_FEATURES; ++c)
-	feature_overlaps[c]= 0;
-    
-    delim = xt_dsv_line_read(dsv_line, infile, "\t");
-    while ( delim != EOF )
-    {
-	xt_dsv_line_free(last_line);
-	xt_dsv_line_copy(last_line, dsv_line);
-	/*
-	 *  If this is a keeper (in the features list), check subsequent
-	 *  lines with the same peak for higher ranking features.  Input
-	 *  is sorted by peak position, so lines with the same peak should
-	 *  be contiguous.
-	 */
-	if ( (keeper_rank = feature_rank(dsv_line, features)) != 0 )
+
+    stage = stats_begin(stats, "filter");
+    filter_init(&filter, &hash, outfile);
+    if ( (threads > 1) && (strcmp(overlaps_file, "-") != 0) &&
+	 !compressed(overlaps_file) )
+    {
+	status = filter_chunks(&filter, overlaps_file, threads);
+    }
+    else
+	status = FILTER_UNMAPPED;
+
+    // Fall back on streaming if the file could not be mapped
+    if ( status == FILTER_UNMAPPED )
+    {
+	if ( strcmp(overlaps_file, "-") == 0 )
+	    infile = stdin;
+	else if ( (infile = xt_fopen(overlaps_file, "r")) == NULL )
+	{
+	    fprintf(stderr, "filter-overlaps: Cannot open %s: %s\n",
+		    overlaps_file, strerror(errno));
+	    return EX_NOINPUT;
+	}
+	if ( overlaps_bin_detect(infile) )
 	{
-	    //fprintf(stderr, "%s %zu\n", xt_dsv_line_get_fields_ae(dsv_line, 5), keeper_rank);
-	    xt_dsv_line_copy(keeper, dsv_line);
-	    xt_dsv_line_free(dsv_line);
-	    while ( ((delim = xt_dsv_line_read(dsv_line, infile, "\t")) != EOF)
-		    && same_peak(dsv_line, keeper) )
+	    if ( (status = overlaps_bin_read_open(&reader, infile)) != EX_OK )
+		fprintf(stderr, "filter-overlaps: %s is not a valid binary "
+			"overlaps file.\n", overlaps_file);
+	    else
 	    {
-		new_rank = feature_rank(dsv_line, features);
-		// If new feature has a higher rank, replace the old one
-		if ( (new_rank != 0) && (new_rank < keeper_rank) )
+		while ( (status = overlaps_bin_read(&reader, &record)) == EX_OK )
 		{
-		    /*fprintf(stderr, "%s:%zu outranks %s:%zu.\n",
-			    xt_dsv_line_get_fields_ae(dsv_line, 5), new_rank,
-			    xt_dsv_line_get_fields_ae(keeper, 5), keeper_rank);*/
-		    xt_dsv_line_free(keeper);
-		    xt_dsv_line_copy(keeper, dsv_line);
-		    keeper_rank = new_rank;
+		    overlap_line_from_record(filter.line, &record);
+		    filter_line(&filter);
 		}
+		overlaps_bin_read_close(&reader);
 	    }
-	    ++feature_overlaps[keeper_rank - 1];
-	    xt_dsv_line_write(keeper, outfile);
-	    xt_dsv_line_free(keeper);
 	}
 	else
 	{
-	    // Not an interesting feature, toss it
-	    xt_dsv_line_free(dsv_line);
-	    delim = xt_dsv_line_read(dsv_line, infile, "\t");
+	    while ( (status = overlap_line_read(filter.line, infile)) == EX_OK )
+		filter_line(&filter);
 	}
-	if ( (delim != EOF) && !same_peak(dsv_line, last_line) )
-	    ++unique_peaks;
+	if ( status == EOF )
+	    status = EX_OK;
+	xt_fclose(infile);
     }
-    fclose(infile);
-    fclose(outfile);
+    filter_finish(&filter);
+    filter_free(&filter);
+    bytes_out = stats_stream_bytes(outfile);
+    xt_fclose(outfile);
+    if ( status != EX_OK )
+	return status;
     
-    printf("Total unique peaks: %lu\n", unique_peaks);
-    for (c = 0; features[c] != NULL; ++c)
+    printf("Total unique peaks: %lu\n", filter.unique_peaks);
+    for (c = kept = 0; features[c] != NULL; ++c)
+    {
 	printf("Overlaps with %-20s: %7lu (%3.1f%%)\n", features[c],
-		feature_overlaps[c], 100.0 * feature_overlaps[c] / unique_peaks);
+		filter.feature_overlaps[c],
+		100.0 * filter.feature_overlaps[c] / filter.unique_peaks);
+	kept += filter.feature_overlaps[c];
+    }
+    stats_end(stage, filter.line_count, kept, stats_path_bytes(overlaps_file),
+	      bytes_out);
+    stats_print(stats, stderr);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Initialize a filter writing kept lines to outfile.  Lines are
+ *      parsed into filter->line, and filter->keeper holds the best line
+ *      so far for the current peak.  A better line is kept by swapping
+ *      the two, so nothing is copied or allocated per line.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    filter_init(filter_t *filter, feature_hash_t *hash, FILE *outfile)
+
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->hash = hash;
+    filter->outfile = outfile;
+    filter->line = &filter->lines[0];
+    filter->keeper = &filter->lines[1];
+}
+
+
+/*
+ *  Write the keeper for the current peak, if any line had a listed feature
+ */
+
+static void filter_flush(filter_t *filter)
+
+{
+    overlap_line_t  *keeper = filter->keeper;
+    
+    if ( filter->keeper_rank != 0 )
+    {
+	++filter->feature_overlaps[filter->keeper_rank - 1];
+	fwrite(keeper->text, keeper->len, 1, filter->outfile);
+	// Final line of a mapped file may lack a newline
+	if ( keeper->text[keeper->len - 1] != '\n' )
+	    putc('\n', filter->outfile);
+    }
+    filter->keeper_rank = 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Process the line in filter->line.  Input is sorted by peak
+ *      position, so lines with the same peak are contiguous.  Keep the
+ *      first line with the highest ranking feature (lowest nonzero
+ *      rank) from each group.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    filter_line(filter_t *filter)
+
+{
+    overlap_line_t  *temp;
+    size_t          new_rank;
+    
+    ++filter->line_count;
+    new_rank = feature_rank(filter->hash, filter->line);
+    if ( !filter->in_group || !same_peak(filter->line, filter->keeper) )
+    {
+	filter_flush(filter);
+	++filter->unique_peaks;
+	filter->in_group = true;
+    }
+    else if ( (new_rank == 0) || ((filter->keeper_rank != 0) &&
+				  (new_rank >= filter->keeper_rank)) )
+	return;     // Not an interesting feature, toss it
+
+    // New group or new keeper: keep this line
+    temp = filter->keeper;
+    filter->keeper = filter->line;
+    filter->line = temp;
+    filter->keeper_rank = new_rank;
+}
+
+
+void    filter_finish(filter_t *filter)
+
+{
+    filter_flush(filter);
+    filter->in_group = false;
+}
+
+
+void    filter_free(filter_t *filter)
+
+{
+    overlap_line_free(&filter->lines[0]);
+    overlap_line_free(&filter->lines[1]);
+}
+
+
+/*
+ *  Return true if xt_fopen() would decompress this file
+ */
+
+bool    compressed(const char *filename)
+
+{
+    static const char   *exts[] = { ".gz", ".bz2", ".xz", ".zst", ".lz4", NULL };
+    const char  *ext;
+    int         c;
+    
+    if ( (ext = strrchr(filename, '.')) == NULL )
+	return false;
+    for (c = 0; exts[c] != NULL; ++c)
+	if ( strcmp(ext, exts[c]) == 0 )
+	    return true;
+    return false;
+}
+
+
+/*
+ *  Return the start of the line after p, or end if there is none
+ */
+
+static const char *next_line(const char *p, const char *end)
+
+{
+    const char  *nl;
+    
+    if ( (nl = memchr(p, '\n', end - p)) == NULL )
+	return end;
+    return nl + 1;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Move a chunk boundary from an arbitrary offset to the start of
+ *      the next line for a different peak, so that no group of lines
+ *      for the same peak is split between chunks.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static const char *chunk_boundary(const char *map, const char *p,
+				  const char *end)
+
+{
+    overlap_line_t  first = OVERLAP_LINE_INIT,
+		    line = OVERLAP_LINE_INIT;
+    const char      *line_end;
+    
+    // Start of the first whole line at or after p
+    if ( (p > map) && (p[-1] != '\n') )
+	p = next_line(p, end);
+    
+    // Find the first data line and skip the rest of its peak
+    for (; p < end; p = line_end)
+    {
+	line_end = next_line(p, end);
+	if ( *p == '#' )
+	    continue;
+	line.text = (char *)p;
+	line.len = line_end - p;
+	if ( overlap_line_parse(&line) != EX_OK )
+	    return p;   // Let the chunk report it
+	if ( first.text == NULL )
+	    first = line;
+	else if ( !same_peak(&line, &first) )
+	    return p;
+    }
+    return end;
+}
+
+
+/*
+ *  Filter one chunk of a mapped file into memory
+ */
+
+static void filter_chunk(filter_chunk_t *chunk)
+
+{
+    const char      *p,
+		    *line_end;
+    overlap_line_t  *line;
+    
+    if ( (chunk->filter.outfile = open_memstream(&chunk->output,
+					&chunk->output_size)) == NULL )
+    {
+	fprintf(stderr, "filter-overlaps: open_memstream() failed: %s\n",
+		strerror(errno));
+	chunk->status = EX_OSERR;
+	return;
+    }
+    for (p = chunk->begin; p < chunk->end; p = line_end)
+    {
+	line_end = next_line(p, chunk->end);
+	if ( *p == '#' )
+	    continue;
+	line = chunk->filter.line;
+	line->text = (char *)p;
+	line->len = line_end - p;
+	if ( (chunk->status = overlap_line_parse(line)) != EX_OK )
+	    break;
+	filter_line(&chunk->filter);
+    }
+    filter_finish(&chunk->filter);
+    if ( fclose(chunk->filter.outfile) != 0 )
+	chunk->status = EX_OSERR;
+}
+
+
+/*
+ *  Worker thread: claim chunks in order, staying within max_ahead
+ *  chunks of the writer
+ */
+
+static void *filter_worker(void *arg)
+
+{
+    filter_queue_t  *queue = arg;
+    filter_chunk_t  *chunk;
+
+    for (;;)
+    {
+	pthread_mutex_lock(&queue->lock);
+	while ( (queue->next < queue->count) &&
+		(queue->next >= queue->written + queue->max_ahead) )
+	    pthread_cond_wait(&queue->written_cond, &queue->lock);
+	if ( queue->next == queue->count )
+	{
+	    pthread_mutex_unlock(&queue->lock);
+	    break;
+	}
+	chunk = &queue->chunks[queue->next++];
+	pthread_mutex_unlock(&queue->lock);
+
+	filter_chunk(chunk);
+
+	pthread_mutex_lock(&queue->lock);
+	chunk->done = true;
+	pthread_cond_broadcast(&queue->done_cond);
+	pthread_mutex_unlock(&queue->lock);
+    }
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Filter a mapped, uncompressed overlaps file in parallel.  The
+ *      file is split into chunks of about FILTER_CHUNK_SIZE bytes, with
+ *      boundaries moved to the next change of peak.  Worker threads
+ *      filter chunks in order into memory buffers, and each buffer is
+ *      written and its counts merged as soon as it and all before it
+ *      are done, so the results are identical to streaming.  Workers
+ *      wait rather than run more than FILTER_CHUNKS_AHEAD chunks per
+ *      thread ahead of the writer, so memory use does not grow with
+ *      the size of the file, and input pages are released once written.
+ *      Return FILTER_UNMAPPED if the file cannot be mapped, so the
+ *      caller can stream it instead.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Write chunks as they finish, in bounded memory
+ ***************************************************************************/
+
+int     filter_chunks(filter_t *filter, const char *overlaps_file,
+		      unsigned threads)
+
+{
+    int             fd,
+		    status = EX_OK;
+    struct stat     st;
+    char            *map;
+    const char      *end,
+		    *p,
+		    *released,
+		    *page_end;
+    filter_queue_t  queue;
+    filter_chunk_t  *chunk;
+    pthread_t       *tids;
+    size_t          array_size,
+		    page_size,
+		    c,
+		    f;
+    unsigned        t,
+		    started;
+    
+    if ( (fd = open(overlaps_file, O_RDONLY)) == -1 )
+	return FILTER_UNMAPPED;
+    if ( (fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) || (st.st_size == 0) ||
+	 ((map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0))
+	    == MAP_FAILED) )
+    {
+	close(fd);
+	return FILTER_UNMAPPED;
+    }
+    close(fd);
+
+    // Binary files are streamed
+    if ( (st.st_size >= OVERLAPS_BIN_MAGIC_LEN) &&
+	 (memcmp(map, OVERLAPS_BIN_MAGIC, OVERLAPS_BIN_MAGIC_LEN) == 0) )
+    {
+	munmap(map, st.st_size);
+	return FILTER_UNMAPPED;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    end = map + st.st_size;
+    released = map;
+    page_size = sysconf(_SC_PAGESIZE);
+
+    memset(&queue, 0, sizeof(queue));
+    array_size = st.st_size / FILTER_CHUNK_SIZE + 1;
+    queue.chunks = xt_malloc(array_size, sizeof(*queue.chunks));
+    for (p = map; p < end; )
+    {
+	if ( queue.count == array_size )
+	{
+	    array_size *= 2;
+	    queue.chunks = xt_realloc(queue.chunks, array_size,
+				      sizeof(*queue.chunks));
+	}
+	chunk = &queue.chunks[queue.count++];
+	filter_init(&chunk->filter, filter->hash, NULL);
+	chunk->begin = p;
+	p = end - p > FILTER_CHUNK_SIZE ?
+	    chunk_boundary(map, p + FILTER_CHUNK_SIZE, end) : end;
+	chunk->end = p;
+	chunk->output = NULL;
+	chunk->output_size = 0;
+	chunk->status = EX_OK;
+	chunk->done = false;
+    }
+    queue.max_ahead = (size_t)threads * FILTER_CHUNKS_AHEAD;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.done_cond, NULL);
+    pthread_cond_init(&queue.written_cond, NULL);
+
+    tids = xt_malloc(threads, sizeof(*tids));
+    for (t = started = 0; t < threads; ++t)
+	if ( pthread_create(&tids[started], NULL, filter_worker, &queue) == 0 )
+	    ++started;
+
+    for (c = 0; c < queue.count; ++c)
+    {
+	chunk = &queue.chunks[c];
+	// Without threads, filter each chunk here
+	if ( started == 0 )
+	    filter_chunk(chunk);
+	else
+	{
+	    pthread_mutex_lock(&queue.lock);
+	    while ( !chunk->done )
+		pthread_cond_wait(&queue.done_cond, &queue.lock);
+	    pthread_mutex_unlock(&queue.lock);
+	}
+
+	if ( chunk->status != EX_OK )
+	    status = chunk->status;
+	else if ( status == EX_OK )
+	{
+	    fwrite(chunk->output, chunk->output_size, 1, filter->outfile);
+	    filter->line_count += chunk->filter.line_count;
+	    filter->unique_peaks += chunk->filter.unique_peaks;
+	    for (f = 0; f < MAX_OVERLAP_FEATURES; ++f)
+		filter->feature_overlaps[f] +=
+		    chunk->filter.feature_overlaps[f];
+	}
+	free(chunk->output);
+	chunk->output = NULL;
+
+	// Drop input pages no chunk still needs from the resident set
+	page_end = map + (chunk->end - map) / page_size * page_size;
+	if ( page_end > released )
+	{
+	    madvise((void *)released, page_end - released, MADV_DONTNEED);
+	    released = page_end;
+	}
+
+	pthread_mutex_lock(&queue.lock);
+	queue.written = c + 1;
+	pthread_cond_broadcast(&queue.written_cond);
+	pthread_mutex_unlock(&queue.lock);
+    }
+
+    for (t = 0; t < started; ++t)
+	pthread_join(tids[t], NULL);
+    free(tids);
+    pthread_mutex_destroy(&queue.lock);
+    pthread_cond_destroy(&queue.done_cond);
+    pthread_cond_destroy(&queue.written_cond);
+    free(queue.chunks);
+    munmap(map, st.st_size);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read the next overlap line into a reusable buffer, skipping
+ *      comments such as the header.
+ *      Return EX_OK, EOF, or EX_DATAERR for a malformed line.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     overlap_line_read(overlap_line_t *line, FILE *stream)
+
+{
+    ssize_t     len;
+    
+    do
+    {
+	if ( (len = getline(&line->buff, &line->buff_size, stream)) == -1 )
+	    return EOF;
+    }   while ( *line->buff == '#' );
+    line->text = line->buff;
+    line->len = len;
+    return overlap_line_parse(line);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Locate the chromosome and feature name in line->text and parse
+ *      the peak start and end.  The text need not be NUL-terminated,
+ *      so this works on lines in a mapped file as well as on buffers.
+ *      Return EX_OK or EX_DATAERR for a malformed line.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     overlap_line_parse(overlap_line_t *line)
+
+{
+    char        *p,
+		*tab,
+		*end,
+		*line_end = line->text + line->len;
+    int         field;
+    
+    /*
+     *  Find the tabs ending columns 1 through 6.  The positions in
+     *  columns 2 and 3 must be followed by a tab, so strtoll() cannot
+     *  run past the line.
+     */
+    for (p = line->text, field = 0; field < 6; ++field, p = tab + 1)
+    {
+	if ( (tab = memchr(p, '\t', line_end - p)) == NULL )
+	{
+	    // Column 6 may be the last
+	    if ( field == 5 )
+	    {
+		tab = line_end;
+		while ( (tab > p) && ((tab[-1] == '\n') || (tab[-1] == '\r')) )
+		    --tab;
+	    }
+	    else
+		break;
+	}
+	switch(field)
+	{
+	    case    0:
+		line->chrom_len = tab - p;
+		break;
+	    case    1:
+		line->start = strtoll(p, &end, 10);
+		break;
+	    case    2:
+		line->end = strtoll(p, &end, 10);
+		break;
+	    case    5:
+		line->name_offset = p - line->text;
+		line->name_len = tab - p;
+		break;
+	}
+	if ( ((field == 1) || (field == 2)) && ((end == p) || (end != tab)) )
+	    break;
+    }
+    if ( field != 6 )
+    {
+	fprintf(stderr, "filter-overlaps: Malformed line: %.*s",
+		(int)line->len, line->text);
+	return EX_DATAERR;
+    }
     return EX_OK;
 }
 
 
 /***************************************************************************
  *  Description:
- *      See if a DSV line has one of the features for which we're filtering.
+ *      Format a record from a binary overlaps file as the TSV line
+ *      peak-classifier would have written, and locate its fields
+ *      directly instead of parsing them back.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Add TSS-distance column
+ *  2026-10-16  Jason Bacon Format with fast-write.h
+ ***************************************************************************/
+
+void    overlap_line_from_record(overlap_line_t *line,
+				 const overlap_t *overlap)
+
+{
+    char    *p;
+
+    if ( line->buff_size < FAST_WRITE_RECORD_MAX )
+    {
+	line->buff = xt_realloc(line->buff, FAST_WRITE_RECORD_MAX, 1);
+	line->buff_size = FAST_WRITE_RECORD_MAX;
+    }
+    line->text = p = line->buff;
+    line->chrom_len = strlen(overlap->chrom);
+    line->start = overlap->peak_start;
+    line->end = overlap->peak_end;
+    p = fast_format_str(p, overlap->chrom, line->chrom_len);
+    *p++ = '\t';
+    p = fast_format_int64(p, overlap->peak_start);
+    *p++ = '\t';
+    p = fast_format_int64(p, overlap->peak_end);
+    *p++ = '\t';
+    p = fast_format_int64(p, overlap->feature_start);
+    *p++ = '\t';
+    p = fast_format_int64(p, overlap->feature_end);
+    *p++ = '\t';
+    line->name_offset = p - line->buff;
+    line->name_len = strlen(overlap->feature_name);
+    p = fast_format_str(p, overlap->feature_name, line->name_len);
+    *p++ = '\t';
+    *p++ = overlap->strand;
+    *p++ = '\t';
+    p = fast_format_int64(p, overlap->overlap);
+    if ( overlap->tss_distance != OVERLAP_NO_TSS_DISTANCE )
+    {
+	*p++ = '\t';
+	p = fast_format_int64(p, overlap->tss_distance);
+    }
+    *p++ = '\n';
+    *p = '\0';
+    line->len = p - line->buff;
+}
+
+
+void    overlap_line_free(overlap_line_t *line)
+
+{
+    free(line->buff);
+    line->buff = line->text = NULL;
+    line->buff_size = 0;
+}
+
+
+/*
+ *  FNV-1a hash of a feature name, ignoring case
+ */
+
+static size_t  feature_hash(const char *name, size_t len)
+
+{
+    size_t  h = 2166136261u,
+	    c;
+    
+    for (c = 0; c < len; ++c)
+	h = (h ^ (unsigned char)tolower((unsigned char)name[c])) * 16777619u;
+    return h & (FEATURE_HASH_SIZE - 1);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Build the feature name hash table.  If a name is listed more
+ *      than once, the first position is its rank.
+ *
+ *  History: 
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    feature_hash_init(feature_hash_t *hash, char *features[])
+
+{
+    size_t  c,
+	    len,
+	    slot;
+    
+    memset(hash, 0, sizeof(*hash));
+    for (c = 0; features[c] != NULL; ++c)
+    {
+	len = strlen(features[c]);
+	for (slot = feature_hash(features[c], len);
+	     hash->slots[slot].name != NULL;
+	     slot = (slot + 1) & (FEATURE_HASH_SIZE - 1))
+	{
+	    if ( (hash->slots[slot].len == len) &&
+		 (strncasecmp(hash->slots[slot].name, features[c], len) == 0) )
+		break;
+	}
+	if ( hash->slots[slot].name == NULL )
+	{
+	    hash->slots[slot].name = features[c];
+	    hash->slots[slot].len = len;
+	    hash->slots[slot].rank = c + 1;
+	}
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      See if a line has one of the features for which we're filtering.
  *      Return the 1-based position in the list if so, 0 if not.
  *
  *  History: 
  *  Date        Name        Modification
  *  2021-05-01  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Look up names in a hash table
  ***************************************************************************/
 
-size_t  feature_rank(xt_dsv_line_t *line, char *features[])
+size_t  feature_rank(feature_hash_t *hash, overlap_line_t *line)
 
 {
-    int     c;
+    const char  *name = line->text + line->name_offset;
+    size_t      slot;
     
-    for (c = 0; features[c] != NULL; ++c)
-	if ( strcasecmp(xt_dsv_line_get_fields_ae(line, 5), features[c]) == 0 )
-	    return c+1;
+    for (slot = feature_hash(name, line->name_len);
+	 hash->slots[slot].name != NULL;
+	 slot = (slot + 1) & (FEATURE_HASH_SIZE - 1))
+    {
+	if ( (hash->slots[slot].len == line->name_len) &&
+	     (strncasecmp(hash->slots[slot].name, name, line->name_len) == 0) )
+	    return hash->slots[slot].rank;
+    }
     return 0;
 }
 
 
 /***************************************************************************
  *  Description:
- *      Return true if two features represent the same peak, as evidenced
- *      by the start and end positions in columns 2 and 3.
+ *      Return true if two lines represent the same peak, as evidenced
+ *      by the chromosome, start, and end positions in columns 1 to 3.
  *
  *  History: 
  *  Date        Name        Modification
  *  2021-05-01  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Compare chromosome as well
+ *  2026-10-16  Jason Bacon Compare parsed positions
  ***************************************************************************/
 
-bool    same_peak(xt_dsv_line_t *line1, xt_dsv_line_t *line2)
+bool    same_peak(overlap_line_t *line1, overlap_line_t *line2)
 
 {
-    char        *start1,
-		*end1,
-		*start2,
-		*end2;
-    
-    start1 = xt_dsv_line_get_fields_ae(line1, 1);
-    end1 = xt_dsv_line_get_fields_ae(line1, 2);
-    start2 = xt_dsv_line_get_fields_ae(line2, 1);
-    end2 = xt_dsv_line_get_fields_ae(line2, 2);
-    return (strcmp(start1, start2) == 0) && (strcmp(end1, end2) == 0);
+    return (line1->start == line2->start) && (line1->end == line2->end) &&
+	   (line1->chrom_len == line2->chrom_len) &&
+	   (memcmp(line1->text, line2->text, line1->chrom_len) == 0);
 }
 
 
 void    usage(char *argv[])
 
 {
-    fprintf(stderr, "Usage: %s overlap-file.tsv outfile-tsv feature [feature ...]\n", argv[0]);
+    fprintf(stderr, "Usage: %s [--threads N] [--stats[=json]] overlap-file.{tsv|pco} outfile-tsv feature [feature ...]\n", argv[0]);
     fprintf(stderr, "Example: %s overlaps.tsv filtered.tsv exon intron upstream\n", argv[0]);
     exit(EX_USAGE);
 }
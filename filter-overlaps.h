@@ -1,9 +1,121 @@
-
 #define MAX_OVERLAP_FEATURES    64
 
+// Power of 2, at least twice MAX_OVERLAP_FEATURES to keep probes short
+#define FEATURE_HASH_SIZE       256
+
+/*
+ *  One overlaps TSV line in a reusable buffer.  Fields are located
+ *  once when the line is read and peak positions are parsed to
+ *  integers, so grouping and ranking never copy or rescan the text.
+ */
+
+typedef struct
+{
+    char        *text;          // In buff or in a mapped file
+    size_t      len;            // Length of line including newline
+    char        *buff;          // getline() buffer when streaming
+    size_t      buff_size;
+    size_t      chrom_len;      // Chromosome is text[0] to text[chrom_len-1]
+    size_t      name_offset;    // Feature name, column 6
+    size_t      name_len;
+    int64_t     start;
+    int64_t     end;
+}   overlap_line_t;
+
+#define OVERLAP_LINE_INIT   { NULL, 0, NULL, 0, 0, 0, 0, 0, 0 }
+
+/*
+ *  Open addressing hash table mapping feature names, ignoring case,
+ *  to their 1-based rank on the command line
+ */
+
+typedef struct
+{
+    const char  *name;
+    size_t      len;
+    size_t      rank;
+}   feature_hash_entry_t;
+
+typedef struct
+{
+    feature_hash_entry_t    slots[FEATURE_HASH_SIZE];
+}   feature_hash_t;
+
+/*
+ *  Grouping and ranking state for one output stream
+ */
+
+typedef struct
+{
+    feature_hash_t  *hash;
+    overlap_line_t  lines[2];
+    overlap_line_t  *line;          // Line being processed
+    overlap_line_t  *keeper;        // Best line so far for current peak
+    size_t          keeper_rank;
+    bool            in_group;
+    unsigned long   line_count;     // Input lines, for --stats
+    unsigned long   unique_peaks;
+    unsigned long   feature_overlaps[MAX_OVERLAP_FEATURES];
+    FILE            *outfile;
+}   filter_t;
+
+/*
+ *  One chunk of a mapped overlaps file, filtered by whichever thread
+ *  claims it
+ */
+
+typedef struct
+{
+    const char      *begin;
+    const char      *end;
+    filter_t        filter;
+    char            *output;        // From open_memstream()
+    size_t          output_size;
+    int             status;
+    bool            done;
+}   filter_chunk_t;
+
+/*
+ *  Chunks of a mapped file, claimed by worker threads in input order
+ *  and written by the main thread as soon as each and all chunks before
+ *  it are done.  Workers stay at most max_ahead chunks ahead of the
+ *  writer, so at most that many chunks of output are in memory.
+ */
+
+typedef struct
+{
+    filter_chunk_t  *chunks;
+    size_t          count;
+    size_t          max_ahead;
+    pthread_mutex_t lock;           // Protects the fields below
+    pthread_cond_t  done_cond;      // A chunk is done
+    pthread_cond_t  written_cond;   // A chunk was written
+    size_t          next;           // Next chunk to claim
+    size_t          written;        // Chunks written so far
+}   filter_queue_t;
+
+// Input bytes per chunk, and chunks per thread that may await writing
+#define FILTER_CHUNK_SIZE       (4 * 1024 * 1024)
+#define FILTER_CHUNKS_AHEAD     2
+
+// filter_chunks() status when the input must be streamed instead
+#define FILTER_UNMAPPED         -1
+
 void    usage(char *argv[]);
 int     filter_overlaps(const char *overlaps_file, const char *output_file,
-	char *features[]);
-size_t  feature_rank(xt_dsv_line_t *line, char *features[]);
-bool    same_peak(xt_dsv_line_t *line1, xt_dsv_line_t *line2);
-
+	char *features[], unsigned threads, stats_t *stats);
+void    filter_init(filter_t *filter, feature_hash_t *hash, FILE *outfile);
+void    filter_line(filter_t *filter);
+void    filter_finish(filter_t *filter);
+void    filter_free(filter_t *filter);
+bool    compressed(const char *filename);
+int     filter_chunks(filter_t *filter, const char *overlaps_file,
+		      unsigned threads);
+int     overlap_line_read(overlap_line_t *line, FILE *stream);
+int     overlap_line_parse(overlap_line_t *line);
+void    overlap_line_from_record(overlap_line_t *line,
+				 const overlap_t *overlap);
+void    overlap_line_free(overlap_line_t *line);
+void    feature_hash_init(feature_hash_t *hash, char *features[]);
+size_t  feature_rank(feature_hash_t *hash, overlap_line_t *line);
+bool    same_peak(overlap_line_t *line1, overlap_line_t *line2);
@@ -0,0 +1,266 @@
+/***************************************************************************
+ *  Description:
+ *      In-memory classification API for libpeakclassifier.a.  This is
+ *      a thin layer over the same augment, sort, and sweep code used by
+ *      peak-classifier, so results are identical to the overlaps TSV.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xtend/mem.h>
+#include <biolibc/bed.h>
+#include <biolibc/gff3.h>
+#include <biolibc/pos-list.h>
+#include "classify.h"
+#include "feature-sort.h"
+#include "fast-write.h"
+#include "augment.h"
+#include "stats.h"
+#include "feature-index.h"
+#include "rank.h"
+#include "libpeakclassifier.h"
+
+/*
+ *  Best overlap so far for the current peak with --rank features
+ */
+
+typedef struct
+{
+    char            **features;
+    overlap_t       keeper;
+    size_t          keeper_rank;
+}   pc_rank_t;
+
+/*
+ *  Caller's array for pc_classify_buffer()
+ */
+
+typedef struct
+{
+    overlap_t       *buff;
+    size_t          buff_size;
+    size_t          count;
+}   pc_buffer_t;
+
+/*
+ *  Append one sorted feature to a feature set.  Matches feature_emit_t.
+ */
+
+static int  feature_set_add(void *arg, const char *chrom_name,
+			    feature_rec_t *rec)
+
+{
+    feature_set_t       *fs = arg;
+
+    if ( (fs->count == 0) ||
+	 (strcmp(fs->chroms[fs->count - 1].chrom, chrom_name) != 0) )
+	feature_set_add_chrom(fs, chrom_name);
+    chrom_features_add(&fs->chroms[fs->count - 1], rec->start, rec->end,
+		       rec->name, rec->strand);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Build a feature set from a GFF3 stream entirely in memory.  The
+ *      stream is read to the end and closed with xt_fclose().
+ *      upstream_boundaries is a comma-separated list as for
+ *      --upstream-boundaries, or NULL for the default.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     pc_features_from_gff3(feature_set_t *fs, FILE *gff3_stream,
+			      const char *upstream_boundaries)
+
+{
+    feature_sort_t  sorter;
+    size_t          c;
+    int             status;
+
+    if ( upstream_boundaries == NULL )
+	upstream_boundaries = DEFAULT_UPSTREAM_BOUNDARIES;
+    if ( !upstream_boundaries_valid(upstream_boundaries) )
+	return EX_USAGE;
+
+    *fs = (feature_set_t)FEATURE_SET_INIT;
+    feature_sort_init(&sorter, FEATURE_SORT_MAX_RECS, NULL);
+    if ( ((status = gff3_augment(gff3_stream, upstream_boundaries, NULL,
+				 &sorter, NULL)) == EX_OK) &&
+	 ((status = feature_sort_finish(&sorter, feature_set_add, fs))
+	    == EX_OK) )
+    {
+	// Feature name indexes refer to the sorter's table
+	fs->name_count = fs->name_array_size = sorter.name_count;
+	fs->names = xt_malloc(fs->name_count, sizeof(*fs->names));
+	for (c = 0; c < fs->name_count; ++c)
+	    if ( (fs->names[c] = strdup(sorter.names[c])) == NULL )
+		status = EX_UNAVAILABLE;
+    }
+    feature_sort_free(&sorter);
+    if ( status != EX_OK )
+	feature_set_free(fs);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Map an existing feature index, as written by
+ *      peak-classifier-index, into a feature set
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     pc_features_from_index(feature_set_t *fs, const char *index_filename)
+
+{
+    *fs = (feature_set_t)FEATURE_SET_INIT;
+    return feature_index_map(fs, index_filename);
+}
+
+
+void    pc_features_free(feature_set_t *fs)
+
+{
+    feature_set_free(fs);
+}
+
+
+/*
+ *  Keep the first overlap with the best rank, as filter-overlaps does
+ */
+
+static void rank_emit(void *arg, const overlap_t *overlap)
+
+{
+    pc_rank_t   *rank = arg;
+    size_t      name_rank;
+
+    name_rank = feature_name_rank(overlap->feature_name, rank->features);
+    if ( (name_rank != 0) &&
+	 ((rank->keeper_rank == 0) || (name_rank < rank->keeper_rank)) )
+    {
+	rank->keeper = *overlap;
+	rank->keeper_rank = name_rank;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify an array of peaks, passing each overlap to emit in the
+ *      order the overlaps TSV would list them.  Peaks need not be
+ *      sorted, but sorted peaks are faster.  The chrom and feature_name
+ *      pointers in each overlap remain valid as long as peaks and fs.
+ *      With params->rank_features, only the best ranked overlap of
+ *      each peak is passed, as with --rank.  fs must come from
+ *      pc_features_from_gff3() or pc_features_from_index().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     pc_classify(feature_set_t *fs, bl_bed_t peaks[], size_t peak_count,
+		    overlap_params_t *params, overlap_emit_t emit, void *arg)
+
+{
+    sweep_t     sweep = SWEEP_INIT;
+    pc_rank_t   rank;
+    const char  *chrom;
+    int64_t     peak_start,
+		peak_end;
+    size_t      c;
+
+    if ( params->rank_features != NULL )
+    {
+	rank.features = params->rank_features;
+	rank.keeper_rank = 0;
+	sweep.emit = rank_emit;
+	sweep.emit_arg = &rank;
+    }
+    else
+    {
+	sweep.emit = emit;
+	sweep.emit_arg = arg;
+    }
+
+    for (c = 0; c < peak_count; ++c)
+    {
+	chrom = BL_BED_CHROM(&peaks[c]);
+	peak_start = BL_BED_CHROM_START(&peaks[c]);
+	peak_end = BL_BED_CHROM_END(&peaks[c]);
+	if ( params->midpoints_only )
+	{
+	    peak_start = (peak_start + peak_end) / 2;
+	    peak_end = peak_start + 1;
+	}
+
+	// Jump instead of restarting the chromosome for out-of-order peaks
+	if ( (strcmp(chrom, sweep.last_chrom) != 0) ||
+	     (peak_start < sweep.last_start) )
+	    sweep_seek(&sweep, fs, chrom, peak_start);
+	classify_peak(fs, &sweep, chrom, peak_start, peak_end, params, NULL,
+		      NULL);
+
+	if ( (params->rank_features != NULL) && (rank.keeper_rank != 0) )
+	{
+	    emit(arg, &rank.keeper);
+	    rank.keeper_rank = 0;
+	}
+    }
+    sweep_free(&sweep);
+    return EX_OK;
+}
+
+
+static void buffer_emit(void *arg, const overlap_t *overlap)
+
+{
+    pc_buffer_t *buffer = arg;
+
+    if ( buffer->count < buffer->buff_size )
+	buffer->buff[buffer->count] = *overlap;
+    ++buffer->count;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify an array of peaks into a caller-supplied array.  Like
+ *      snprintf(), return the total number of overlaps, of which the
+ *      first buff_size are stored, so a caller can enlarge buff and
+ *      try again if the return value exceeds buff_size.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+size_t  pc_classify_buffer(feature_set_t *fs, bl_bed_t peaks[],
+			   size_t peak_count, overlap_params_t *params,
+			   overlap_t buff[], size_t buff_size)
+
+{
+    pc_buffer_t buffer;
+
+    buffer.buff = buff;
+    buffer.buff_size = buff_size;
+    buffer.count = 0;
+    pc_classify(fs, peaks, peak_count, params, buffer_emit, &buffer);
+    return buffer.count;
+}
@@ -0,0 +1,41 @@
+#ifndef _LIBPEAKCLASSIFIER_H_
+#define _LIBPEAKCLASSIFIER_H_
+
+/*
+ *  In-memory classification API, installed with libpeakclassifier.a.
+ *  A feature set is built once from a GFF stream or an existing
+ *  feature index, after which any number of bl_bed_t peak arrays can
+ *  be classified from any number of threads, with no temporary files,
+ *  child processes, or TSV text in between.
+ *
+ *  Unlike the rest of the sources, this header includes what it needs,
+ *  so that applications can include it alone.
+ *
+ *      feature_set_t       fs;
+ *      overlap_params_t    params = OVERLAP_PARAMS_INIT;
+ *
+ *      pc_features_from_gff3(&fs, gff3_stream, NULL);
+ *      pc_classify(&fs, peaks, peak_count, &params, my_callback, my_data);
+ *      pc_features_free(&fs);
+ *
+ *  Link with -lpeakclassifier -lbiolibc -lxtend -lpthread.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+
+/* libpeakclassifier.c */
+int     pc_features_from_gff3(feature_set_t *fs, FILE *gff3_stream,
+			      const char *upstream_boundaries);
+int     pc_features_from_index(feature_set_t *fs, const char *index_filename);
+void    pc_features_free(feature_set_t *fs);
+int     pc_classify(feature_set_t *fs, bl_bed_t peaks[], size_t peak_count,
+		    overlap_params_t *params, overlap_emit_t emit, void *arg);
+size_t  pc_classify_buffer(feature_set_t *fs, bl_bed_t peaks[],
+			   size_t peak_count, overlap_params_t *params,
+			   overlap_t buff[], size_t buff_size);
+
+#endif  // _LIBPEAKCLASSIFIER_H_
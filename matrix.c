@@ -0,0 +1,678 @@
+/***************************************************************************
+ *  Description:
+ *      Count matrix of feature class, and optionally gene, by sample
+ *      for a cohort of peak files, in one merged pass.  This replaces a
+ *      classification and filter-overlaps run per sample followed by a
+ *      join of the results.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <xtend/mem.h>
+#include <xtend/file.h>
+#include <xtend/string.h>
+#include <biolibc/bed.h>
+#include <biolibc/gff3.h>
+#include "classify.h"
+#include "overlap-kernel.h"
+#include "rank.h"
+#include "decompress.h"
+#include "matrix.h"
+
+/*
+ *  Classification state shared with the emit callbacks
+ */
+
+typedef struct
+{
+    matrix_t        *matrix;
+    feature_set_t   *fs;
+    rank_t          *rank;
+    size_t          last_class;
+}   matrix_emit_t;
+
+/*
+ *  Position of the gene sweep, which follows the merged peaks
+ */
+
+typedef struct
+{
+    chrom_features_t    *chrom;
+    size_t              chrom_first;
+    char                last_chrom[BL_CHROM_MAX_CHARS + 1];
+    int64_t             last_start;
+    size_t              next;
+}   gene_sweep_t;
+
+/***************************************************************************
+ *  Description:
+ *      Read the next peak of a sample.  Return false at the end of its
+ *      file.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static bool sample_read(matrix_sample_t *sample)
+
+{
+    if ( bl_bed_read(&sample->peak, sample->stream, BL_BED_FIELD_ALL) == EOF )
+	return false;
+    // Same as sort -n: leading digits, 0 if none
+    sample->chrom_num = strtol(BL_BED_CHROM(&sample->peak), NULL, 10);
+    return true;
+}
+
+
+/*
+ *  Order peaks as in feature-sort.c, then by sample, so that identical
+ *  peaks of different samples come out together
+ */
+
+static int  sample_cmp(const matrix_t *matrix, size_t s1, size_t s2)
+
+{
+    const matrix_sample_t   *p1 = &matrix->samples[s1],
+			    *p2 = &matrix->samples[s2];
+    int                     status;
+
+    if ( p1->chrom_num != p2->chrom_num )
+	return p1->chrom_num < p2->chrom_num ? -1 : 1;
+    status = strcmp(BL_BED_CHROM(&p1->peak), BL_BED_CHROM(&p2->peak));
+    if ( status != 0 )
+	return status;
+    if ( BL_BED_CHROM_START(&p1->peak) != BL_BED_CHROM_START(&p2->peak) )
+	return BL_BED_CHROM_START(&p1->peak) < BL_BED_CHROM_START(&p2->peak) ?
+	       -1 : 1;
+    if ( BL_BED_CHROM_END(&p1->peak) != BL_BED_CHROM_END(&p2->peak) )
+	return BL_BED_CHROM_END(&p1->peak) < BL_BED_CHROM_END(&p2->peak) ?
+	       -1 : 1;
+    return s1 < s2 ? -1 : s1 > s2;
+}
+
+
+static void heap_sift_down(const matrix_t *matrix, size_t *heap, size_t count,
+			   size_t top)
+
+{
+    size_t  child,
+	    temp;
+
+    while ( (child = top * 2 + 1) < count )
+    {
+	if ( (child + 1 < count) &&
+	     (sample_cmp(matrix, heap[child + 1], heap[child]) < 0) )
+	    ++child;
+	if ( sample_cmp(matrix, heap[top], heap[child]) <= 0 )
+	    break;
+	temp = heap[top];
+	heap[top] = heap[child];
+	heap[child] = temp;
+	top = child;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Open the sorted peak files of all samples.  Samples are named
+ *      for their files, without the directory or .bed extension.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     matrix_open(matrix_t *matrix, char *peak_filenames[],
+		    size_t sample_count, unsigned threads)
+
+{
+    matrix_sample_t *sample;
+    bl_bed_t        peak = BL_BED_INIT;
+    char            *p;
+    size_t          c;
+
+    memset(matrix, 0, sizeof(*matrix));
+    matrix->samples = xt_malloc(sample_count, sizeof(*matrix->samples));
+    for (c = 0; c < sample_count; ++c)
+    {
+	if ( !xt_valid_extension(peak_filenames[c], ".bed") )
+	{
+	    fprintf(stderr, "peak-classifier: %s is not a BED file.\n",
+		    peak_filenames[c]);
+	    return EX_USAGE;
+	}
+	sample = &matrix->samples[c];
+	if ( (p = strrchr(peak_filenames[c], '/')) == NULL )
+	    p = peak_filenames[c];
+	else
+	    ++p;
+	sample->name = strdup(p);
+	*strstr(sample->name, ".bed") = '\0';
+	sample->peak = peak;
+	sample->peaks = 0;
+	if ( (sample->stream = decompress_fopen(peak_filenames[c],
+						threads)) == NULL )
+	{
+	    fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		    peak_filenames[c], strerror(errno));
+	    return EX_NOINPUT;
+	}
+	++matrix->sample_count;
+    }
+    matrix->group = xt_malloc(sample_count, sizeof(*matrix->group));
+    return EX_OK;
+}
+
+
+/*
+ *  A gene as read from the GFF, before sorting
+ */
+
+typedef struct
+{
+    int64_t         start;
+    int64_t         end;
+    size_t          chrom;      // Index into the gene feature set
+    char            *id;
+    char            strand;
+}   gene_rec_t;
+
+/*
+ *  Gene blocks follow GFF order, and a gene nested in another may start
+ *  before it, so genes are sorted by chromosome number, start, and end
+ */
+
+static int  gene_rec_cmp(const void *p1, const void *p2)
+
+{
+    const gene_rec_t    *g1 = p1,
+			*g2 = p2;
+
+    if ( g1->chrom != g2->chrom )
+	return g1->chrom < g2->chrom ? -1 : 1;
+    if ( g1->start != g2->start )
+	return g1->start < g2->start ? -1 : 1;
+    if ( g1->end != g2->end )
+	return g1->end < g2->end ? -1 : 1;
+    return 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read the genes in a GFF for --gene-matrix.  Genes are the same
+ *      top-level features gff3_augment() treats as genes, and are
+ *      identified by their ID attribute.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     matrix_load_genes(matrix_t *matrix, const char *gff3_filename,
+			  unsigned threads)
+
+{
+    matrix_genes_t      *genes = &matrix->genes;
+    FILE                *gff3_stream;
+    bl_gff3_t           gff3_feature;
+    chrom_features_t    *chrom;
+    gene_rec_t          *recs = NULL;
+    size_t              rec_count = 0,
+			array_size = 0,
+			c,
+			g;
+    int64_t             start,
+			end;
+    char                *id,
+			*parent,
+			default_id[BL_CHROM_MAX_CHARS + 64];
+
+    if ( (gff3_stream = decompress_fopen(gff3_filename, threads)) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open %s: %s\n",
+		gff3_filename, strerror(errno));
+	return EX_NOINPUT;
+    }
+    genes->set = (feature_set_t)FEATURE_SET_INIT;
+    bl_gff3_skip_header(gff3_stream);
+    bl_gff3_init(&gff3_feature);
+    while ( bl_gff3_read(&gff3_feature, gff3_stream, BL_GFF3_FIELD_ALL) ==
+	    BL_READ_OK )
+    {
+	parent = BL_GFF3_FEATURE_PARENT(&gff3_feature);
+	if ( !xt_strisint(BL_GFF3_SEQID(&gff3_feature), 10) ||
+	     (strstr(BL_GFF3_TYPE(&gff3_feature), "gene") == NULL) ||
+	     ((parent != NULL) && (*parent != '\0')) )
+	    continue;
+	// BED coordinates, as in the augmented features
+	start = BL_GFF3_START(&gff3_feature) - 1;
+	end = BL_GFF3_END(&gff3_feature);
+	if ( end <= start )
+	    continue;
+
+	if ( (chrom = feature_set_find_chrom(&genes->set,
+				BL_GFF3_SEQID(&gff3_feature))) == NULL )
+	    chrom = feature_set_add_chrom(&genes->set,
+					  BL_GFF3_SEQID(&gff3_feature));
+	if ( rec_count == array_size )
+	{
+	    array_size = array_size == 0 ? 4096 : array_size * 2;
+	    recs = xt_realloc(recs, array_size, sizeof(*recs));
+	}
+	if ( ((id = BL_GFF3_FEATURE_ID(&gff3_feature)) == NULL) ||
+	     (*id == '\0') )
+	{
+	    snprintf(default_id, sizeof(default_id), "%s:%" PRId64 "-%" PRId64,
+		     chrom->chrom, start, end);
+	    id = default_id;
+	}
+	recs[rec_count].start = start;
+	recs[rec_count].end = end;
+	recs[rec_count].chrom = chrom - genes->set.chroms;
+	recs[rec_count].id = strdup(id);
+	recs[rec_count].strand = BL_GFF3_STRAND(&gff3_feature);
+	++rec_count;
+    }
+    bl_gff3_free(&gff3_feature);
+    xt_fclose(gff3_stream);
+
+    qsort(recs, rec_count, sizeof(*recs), gene_rec_cmp);
+    genes->ids = xt_malloc(rec_count + 1, sizeof(*genes->ids));
+    genes->chrom_first = xt_malloc(genes->set.count + 1,
+				   sizeof(*genes->chrom_first));
+    for (c = g = 0; c < genes->set.count; ++c)
+    {
+	genes->chrom_first[c] = g;
+	for (; (g < rec_count) && (recs[g].chrom == c); ++g)
+	{
+	    chrom_features_add(&genes->set.chroms[c], recs[g].start,
+			       recs[g].end, 0, recs[g].strand);
+	    genes->ids[g] = recs[g].id;
+	}
+    }
+    genes->count = rec_count;
+    free(recs);
+    return EX_OK;
+}
+
+
+/*
+ *  Row of the class matrix for an overlap
+ */
+
+static size_t   matrix_class(matrix_emit_t *me, const char *feature_name)
+
+{
+    feature_set_t   *fs = me->fs;
+    size_t          c;
+
+    if ( me->rank != NULL )
+	return feature_name_rank(feature_name, me->rank->features) - 1;
+
+    // Names are those of the feature set, so compare pointers
+    if ( (me->last_class < fs->name_count) &&
+	 (fs->names[me->last_class] == feature_name) )
+	return me->last_class;
+    for (c = 0; c < fs->name_count; ++c)
+	if ( fs->names[c] == feature_name )
+	    return me->last_class = c;
+    return fs->name_count;      // BEYOND_FEATURE_NAME
+}
+
+
+static void matrix_emit(void *arg, const overlap_t *overlap)
+
+{
+    matrix_emit_t   *me = arg;
+
+    me->matrix->seen[matrix_class(me, overlap->feature_name)] = true;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Count the genes overlapping a peak for every sample in the
+ *      current group
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void matrix_count_genes(matrix_t *matrix, gene_sweep_t *sweep,
+			       const char *chrom, int64_t peak_start,
+			       int64_t peak_end, overlap_params_t *params)
+
+{
+    chrom_features_t    *genes;
+    size_t              first,
+			last,
+			f,
+			g,
+			gene;
+
+    if ( strcmp(chrom, sweep->last_chrom) != 0 )
+    {
+	strncpy(sweep->last_chrom, chrom, BL_CHROM_MAX_CHARS);
+	sweep->last_chrom[BL_CHROM_MAX_CHARS] = '\0';
+	if ( (sweep->chrom = feature_set_find_chrom(&matrix->genes.set,
+						    chrom)) != NULL )
+	    sweep->chrom_first = matrix->genes.chrom_first[sweep->chrom -
+					matrix->genes.set.chroms];
+	sweep->next = 0;
+    }
+    else if ( peak_start < sweep->last_start )
+	sweep->next = 0;
+    sweep->last_start = peak_start;
+    if ( (genes = sweep->chrom) == NULL )
+	return;
+
+    first = sweep->next = chrom_features_first_ending_after(genes,
+						sweep->next, peak_start);
+    for (last = first; (last < genes->count) &&
+		       (genes->starts[last] < peak_end); ++last)
+	;
+    if ( last - first > matrix->flags_array_size )
+    {
+	matrix->flags_array_size = last - first;
+	matrix->flags = xt_realloc(matrix->flags, matrix->flags_array_size,
+				   sizeof(*matrix->flags));
+    }
+    overlap_flags(genes->starts + first, genes->ends + first, last - first,
+		  peak_start, peak_end, params, matrix->flags);
+    for (f = 0; f < last - first; ++f)
+    {
+	if ( !(matrix->flags[f] & OVERLAP_FLAG_PASS) )
+	    continue;
+	gene = sweep->chrom_first + first + f;
+	for (g = 0; g < matrix->group_count; ++g)
+	    ++matrix->gene_counts[gene * matrix->sample_count +
+				  matrix->group[g]];
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify the current peak once and count it for every sample in
+ *      the group
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void matrix_peak(matrix_t *matrix, matrix_emit_t *me, sweep_t *sweep,
+			gene_sweep_t *gene_sweep, const char *chrom,
+			int64_t peak_start, int64_t peak_end,
+			overlap_params_t *params)
+
+{
+    size_t  c,
+	    g;
+
+    if ( params->midpoints_only )
+    {
+	// Replace peak start/end with midpoint coordinates
+	peak_start = (peak_start + peak_end) / 2;
+	peak_end = peak_start + 1;
+    }
+    classify_peak(me->fs, sweep, chrom, peak_start, peak_end, params,
+		  me->rank, NULL);
+    // Emit the kept overlap now rather than at the next peak
+    if ( me->rank != NULL )
+	rank_finish(me->rank, NULL);
+    for (c = 0; c < matrix->class_count; ++c)
+    {
+	if ( matrix->seen[c] )
+	{
+	    for (g = 0; g < matrix->group_count; ++g)
+		++matrix->class_counts[c * matrix->sample_count +
+				       matrix->group[g]];
+	    matrix->seen[c] = false;
+	}
+    }
+    if ( matrix->genes.count > 0 )
+	matrix_count_genes(matrix, gene_sweep, chrom, peak_start, peak_end,
+			   params);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Merge the peaks of all samples and classify them.  Peaks with
+ *      the same position in several samples are classified once.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     matrix_classify(matrix_t *matrix, feature_set_t *fs,
+			overlap_params_t *params, rank_t *rank,
+			classify_counts_t *counts)
+
+{
+    sweep_t         sweep = SWEEP_INIT;
+    gene_sweep_t    gene_sweep;
+    matrix_emit_t   me;
+    matrix_sample_t *sample;
+    bl_bed_t        *peak;
+    size_t          *heap,
+		    heap_count,
+		    c;
+    char            chrom[BL_CHROM_MAX_CHARS + 1];
+    int64_t         peak_start = 0,
+		    peak_end = 0;
+
+    matrix->class_count = rank != NULL ? rank->feature_count :
+			  fs->name_count + 1;
+    matrix->class_counts = calloc(matrix->class_count * matrix->sample_count,
+				  sizeof(*matrix->class_counts));
+    matrix->seen = calloc(matrix->class_count, sizeof(*matrix->seen));
+    matrix->gene_counts = calloc(matrix->genes.count * matrix->sample_count + 1,
+				 sizeof(*matrix->gene_counts));
+    if ( (matrix->class_counts == NULL) || (matrix->seen == NULL) ||
+	 (matrix->gene_counts == NULL) )
+    {
+	fputs("peak-classifier: Cannot allocate count matrix.\n", stderr);
+	return EX_UNAVAILABLE;
+    }
+    memset(&gene_sweep, 0, sizeof(gene_sweep));
+    me.matrix = matrix;
+    me.fs = fs;
+    me.rank = rank;
+    me.last_class = 0;
+    if ( rank != NULL )
+    {
+	rank->emit = matrix_emit;
+	rank->emit_arg = &me;
+    }
+    else
+    {
+	sweep.emit = matrix_emit;
+	sweep.emit_arg = &me;
+    }
+
+    heap = xt_malloc(matrix->sample_count, sizeof(*heap));
+    for (c = heap_count = 0; c < matrix->sample_count; ++c)
+	if ( sample_read(&matrix->samples[c]) )
+	    heap[heap_count++] = c;
+    for (c = heap_count / 2; c-- > 0; )
+	heap_sift_down(matrix, heap, heap_count, c);
+
+    matrix->group_count = 0;
+    while ( heap_count > 0 )
+    {
+	sample = &matrix->samples[heap[0]];
+	peak = &sample->peak;
+	if ( (matrix->group_count > 0) &&
+	     ((BL_BED_CHROM_START(peak) != peak_start) ||
+	      (BL_BED_CHROM_END(peak) != peak_end) ||
+	      (strcmp(BL_BED_CHROM(peak), chrom) != 0)) )
+	{
+	    matrix_peak(matrix, &me, &sweep, &gene_sweep, chrom, peak_start,
+			peak_end, params);
+	    matrix->group_count = 0;
+	}
+	if ( matrix->group_count == 0 )
+	{
+	    strcpy(chrom, BL_BED_CHROM(peak));
+	    peak_start = BL_BED_CHROM_START(peak);
+	    peak_end = BL_BED_CHROM_END(peak);
+	}
+	matrix->group[matrix->group_count++] = heap[0];
+	++sample->peaks;
+	if ( !sample_read(sample) )
+	    heap[0] = heap[--heap_count];
+	heap_sift_down(matrix, heap, heap_count, 0);
+    }
+    if ( matrix->group_count > 0 )
+	matrix_peak(matrix, &me, &sweep, &gene_sweep, chrom, peak_start,
+		    peak_end, params);
+
+    if ( rank != NULL )
+	rank->emit = NULL;
+    if ( counts != NULL )
+	for (c = 0; c < matrix->sample_count; ++c)
+	    counts->peaks += matrix->samples[c].peaks;
+    free(heap);
+    sweep_free(&sweep);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write one matrix as TSV, with a header line of sample names
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static FILE *matrix_header(matrix_t *matrix, const char *filename,
+			   const char *first_column)
+
+{
+    FILE    *stream;
+    size_t  s;
+
+    if ( (stream = fopen(filename, "w")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot create %s: %s\n", filename,
+		strerror(errno));
+	return NULL;
+    }
+    fprintf(stream, "#%s", first_column);
+    for (s = 0; s < matrix->sample_count; ++s)
+	fprintf(stream, "\t%s", matrix->samples[s].name);
+    putc('\n', stream);
+    return stream;
+}
+
+
+static int  matrix_close(FILE *stream, const char *filename)
+
+{
+    if ( ferror(stream) | (fclose(stream) != 0) )
+    {
+	fprintf(stderr, "peak-classifier: Error writing %s.\n", filename);
+	return EX_IOERR;
+    }
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the class matrix, and the gene matrix if genes were
+ *      loaded.  The first class row is the total peaks of each sample.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     matrix_write(matrix_t *matrix, feature_set_t *fs, rank_t *rank,
+		     const char *matrix_filename,
+		     const char *gene_matrix_filename)
+
+{
+    FILE    *stream;
+    size_t  c,
+	    s;
+    int     status;
+
+    if ( (stream = matrix_header(matrix, matrix_filename,
+				 "Feature")) == NULL )
+	return EX_CANTCREAT;
+    fputs(MATRIX_TOTAL_NAME, stream);
+    for (s = 0; s < matrix->sample_count; ++s)
+	fprintf(stream, "\t%lu", matrix->samples[s].peaks);
+    putc('\n', stream);
+    for (c = 0; c < matrix->class_count; ++c)
+    {
+	fputs(rank != NULL ? rank->features[c] :
+	      c < fs->name_count ? fs->names[c] : BEYOND_FEATURE_NAME, stream);
+	for (s = 0; s < matrix->sample_count; ++s)
+	    fprintf(stream, "\t%" PRIu64,
+		    matrix->class_counts[c * matrix->sample_count + s]);
+	putc('\n', stream);
+    }
+    if ( (status = matrix_close(stream, matrix_filename)) != EX_OK )
+	return status;
+
+    if ( gene_matrix_filename == NULL )
+	return EX_OK;
+    if ( (stream = matrix_header(matrix, gene_matrix_filename,
+				 "Gene")) == NULL )
+	return EX_CANTCREAT;
+    for (c = 0; c < matrix->genes.count; ++c)
+    {
+	fputs(matrix->genes.ids[c], stream);
+	for (s = 0; s < matrix->sample_count; ++s)
+	    fprintf(stream, "\t%" PRIu32,
+		    matrix->gene_counts[c * matrix->sample_count + s]);
+	putc('\n', stream);
+    }
+    return matrix_close(stream, gene_matrix_filename);
+}
+
+
+void    matrix_free(matrix_t *matrix)
+
+{
+    size_t  c;
+
+    for (c = 0; c < matrix->sample_count; ++c)
+    {
+	free(matrix->samples[c].name);
+	xt_fclose(matrix->samples[c].stream);
+    }
+    for (c = 0; c < matrix->genes.count; ++c)
+	free(matrix->genes.ids[c]);
+    feature_set_free(&matrix->genes.set);
+    free(matrix->genes.ids);
+    free(matrix->genes.chrom_first);
+    free(matrix->samples);
+    free(matrix->class_counts);
+    free(matrix->gene_counts);
+    free(matrix->seen);
+    free(matrix->group);
+    free(matrix->flags);
+    memset(matrix, 0, sizeof(*matrix));
+}
@@ -0,0 +1,72 @@
+#ifndef _MATRIX_H_
+#define _MATRIX_H_
+
+/*
+ *  Feature-by-sample count matrix for a cohort, with --matrix.  The
+ *  sorted peak files of all samples are merged into one stream, so the
+ *  features are swept once for all samples, and identical peaks in
+ *  different samples are classified only once.
+ *
+ *  Without --rank, each row counts the peaks of each sample that
+ *  overlap a feature with that name, so a peak may count toward several
+ *  rows.  With --rank, rows are the --rank features and each peak
+ *  counts toward its highest ranked feature only, as in the
+ *  filter-overlaps summary.  With --gene-matrix, a second matrix counts
+ *  the peaks overlapping each gene in the GFF, by gene ID.
+ */
+
+#define MATRIX_TOTAL_NAME   "total-peaks"
+
+// One sample's peak stream and its current peak
+typedef struct
+{
+    char            *name;          // Peak file name without path or .bed
+    FILE            *stream;
+    bl_bed_t        peak;
+    long            chrom_num;      // Numeric value of the chrom name
+    unsigned long   peaks;
+}   matrix_sample_t;
+
+/*
+ *  Genes read from the GFF for --gene-matrix, as a feature set sorted
+ *  by chromosome and position.  Gene f of set.chroms[c] has the ID
+ *  ids[chrom_first[c] + f].
+ */
+
+typedef struct
+{
+    feature_set_t   set;
+    size_t          *chrom_first;
+    char            **ids;
+    size_t          count;
+}   matrix_genes_t;
+
+typedef struct
+{
+    matrix_sample_t *samples;
+    size_t          sample_count;
+    size_t          class_count;    // Rows: names or --rank features
+    uint64_t        *class_counts;  // class_count x sample_count
+    matrix_genes_t  genes;
+    uint32_t        *gene_counts;   // genes.count x sample_count
+    bool            *seen;          // Classes found for the current peak
+    size_t          *group;         // Samples sharing the current peak
+    size_t          group_count;
+    unsigned char   *flags;         // overlap_flags() results for genes
+    size_t          flags_array_size;
+}   matrix_t;
+
+/* matrix.c */
+int     matrix_open(matrix_t *matrix, char *peak_filenames[],
+		    size_t sample_count, unsigned threads);
+int     matrix_load_genes(matrix_t *matrix, const char *gff3_filename,
+			  unsigned threads);
+int     matrix_classify(matrix_t *matrix, feature_set_t *fs,
+			overlap_params_t *params, rank_t *rank,
+			classify_counts_t *counts);
+int     matrix_write(matrix_t *matrix, feature_set_t *fs, rank_t *rank,
+		     const char *matrix_filename,
+		     const char *gene_matrix_filename);
+void    matrix_free(matrix_t *matrix);
+
+#endif  // _MATRIX_H_
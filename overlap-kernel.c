@@ -0,0 +1,255 @@
+/***************************************************************************
+ *  Description:
+ *      Vectorized overlap tests.  Nested genes and the upstream bands
+ *      keep many features active at once, and every active feature is
+ *      tested against every peak, so this is the innermost loop of the
+ *      classification.  The AVX2 kernels test four features per
+ *      iteration.  The scalar code handles the remainder and builds
+ *      without AVX2.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xtend/math.h>
+#include <biolibc/bed.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "classify.h"
+#include "overlap-kernel.h"
+
+/***************************************************************************
+ *  Description:
+ *      Check overlap bases against the minimum fractions of the peak
+ *      and the feature, like bedtools intersect -f, -F, and -e.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Move from classify.c
+ ***************************************************************************/
+
+static bool overlap_ok(int64_t overlap, int64_t peak_len, int64_t feature_len,
+		       const overlap_params_t *params)
+
+{
+    bool    peak_ok,
+	    gff3_ok;
+
+    if ( overlap <= 0 )
+	return false;
+    peak_ok = (double)overlap / peak_len >= params->min_peak_overlap;
+    gff3_ok = (double)overlap / feature_len >= params->min_gff3_overlap;
+    if ( params->min_either_overlap )
+	return peak_ok || gff3_ok;
+    else
+	return peak_ok && gff3_ok;
+}
+
+
+static void interval_flags_scalar(const int64_t starts[],
+			const int64_t ends[], size_t first, size_t count,
+			int64_t peak_start, int64_t peak_end,
+			const overlap_params_t *params, unsigned char flags[])
+
+{
+    size_t  c;
+    int64_t overlap;
+
+    for (c = first; c < count; ++c)
+    {
+	if ( ends[c] <= peak_start )
+	    flags[c] = 0;
+	else
+	{
+	    overlap = XT_MIN(peak_end, ends[c]) - XT_MAX(peak_start, starts[c]);
+	    flags[c] = OVERLAP_FLAG_ACTIVE |
+		(overlap_ok(overlap, peak_end - peak_start, ends[c] - starts[c],
+			    params) ? OVERLAP_FLAG_PASS : 0);
+	}
+    }
+}
+
+
+#ifdef __AVX2__
+
+/*
+ *  Exact for 0 <= x < 2^52, which covers any genomic length.  AVX2 has
+ *  no 64-bit integer to double conversion.
+ */
+
+static inline __m256d   int64_to_double(__m256i x)
+
+{
+    const __m256d   magic = _mm256_set1_pd(4503599627370496.0);    // 2^52
+
+    return _mm256_sub_pd(_mm256_castsi256_pd(
+	_mm256_or_si256(x, _mm256_castpd_si256(magic))), magic);
+}
+
+
+static inline __m256i   min_epi64(__m256i a, __m256i b)
+
+{
+    return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+
+static inline __m256i   max_epi64(__m256i a, __m256i b)
+
+{
+    return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+}
+
+
+/*
+ *  Expand 4-bit active and pass masks into four flag bytes
+ */
+
+static inline void  flags_store(unsigned char flags[], int active, int pass)
+
+{
+    int     b;
+
+    for (b = 0; b < 4; ++b)
+	flags[b] = ((active >> b) & 1) | (((pass >> b) & 1) << 1);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      AVX2 version of interval_flags_scalar() for the first count - count
+ *      % 4 features.  Divisions are the same IEEE operations as the
+ *      scalar code, so results are identical.  Return the number of
+ *      features done.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static size_t   interval_flags_avx2(const int64_t starts[],
+			const int64_t ends[], size_t count,
+			int64_t peak_start, int64_t peak_end,
+			const overlap_params_t *params, unsigned char flags[])
+
+{
+    __m256i s, e, overlap, positive, active;
+    __m256d overlap_d, peak_ok, gff3_ok, ok;
+    const __m256i   ps = _mm256_set1_epi64x(peak_start),
+		    pe = _mm256_set1_epi64x(peak_end),
+		    zero = _mm256_setzero_si256();
+    const __m256d   peak_len = _mm256_set1_pd((double)(peak_end - peak_start)),
+		    min_peak = _mm256_set1_pd(params->min_peak_overlap),
+		    min_gff3 = _mm256_set1_pd(params->min_gff3_overlap);
+    size_t  c;
+
+    for (c = 0; c + 4 <= count; c += 4)
+    {
+	s = _mm256_loadu_si256((const __m256i *)(starts + c));
+	e = _mm256_loadu_si256((const __m256i *)(ends + c));
+	active = _mm256_cmpgt_epi64(e, ps);
+	overlap = _mm256_sub_epi64(min_epi64(pe, e), max_epi64(ps, s));
+	positive = _mm256_cmpgt_epi64(overlap, zero);
+
+	// Negative overlaps fail anyway, so zero them for the conversion
+	overlap_d = int64_to_double(_mm256_and_si256(overlap, positive));
+	peak_ok = _mm256_cmp_pd(_mm256_div_pd(overlap_d, peak_len), min_peak,
+				_CMP_GE_OQ);
+	gff3_ok = _mm256_cmp_pd(_mm256_div_pd(overlap_d,
+			int64_to_double(_mm256_sub_epi64(e, s))), min_gff3,
+			_CMP_GE_OQ);
+	ok = params->min_either_overlap ? _mm256_or_pd(peak_ok, gff3_ok) :
+					  _mm256_and_pd(peak_ok, gff3_ok);
+	ok = _mm256_and_pd(ok, _mm256_castsi256_pd(positive));
+	flags_store(flags + c,
+		    _mm256_movemask_pd(_mm256_castsi256_pd(active)),
+		    _mm256_movemask_pd(ok));
+    }
+    return c;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Point-in-interval version for single-base peaks, as with
+ *      --midpoints.  The overlap is 1 base if the feature contains the
+ *      point, so only the feature fraction needs a division.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static size_t   point_flags_avx2(const int64_t starts[], const int64_t ends[],
+			size_t count, int64_t point,
+			const overlap_params_t *params, unsigned char flags[])
+
+{
+    __m256i s, e, active, inside;
+    __m256d gff3_ok, ok;
+    const __m256i   p = _mm256_set1_epi64x(point);
+    const __m256d   one = _mm256_set1_pd(1.0),
+		    min_gff3 = _mm256_set1_pd(params->min_gff3_overlap),
+		    peak_ok = 1.0 >= params->min_peak_overlap ?
+			_mm256_castsi256_pd(_mm256_set1_epi64x(-1)) :
+			_mm256_setzero_pd();
+    size_t  c;
+
+    for (c = 0; c + 4 <= count; c += 4)
+    {
+	s = _mm256_loadu_si256((const __m256i *)(starts + c));
+	e = _mm256_loadu_si256((const __m256i *)(ends + c));
+	active = _mm256_cmpgt_epi64(e, p);
+	inside = _mm256_andnot_si256(_mm256_cmpgt_epi64(s, p), active);
+	gff3_ok = _mm256_cmp_pd(_mm256_div_pd(one,
+			int64_to_double(_mm256_sub_epi64(e, s))), min_gff3,
+			_CMP_GE_OQ);
+	ok = params->min_either_overlap ? _mm256_or_pd(peak_ok, gff3_ok) :
+					  _mm256_and_pd(peak_ok, gff3_ok);
+	ok = _mm256_and_pd(ok, _mm256_castsi256_pd(inside));
+	flags_store(flags + c,
+		    _mm256_movemask_pd(_mm256_castsi256_pd(active)),
+		    _mm256_movemask_pd(ok));
+    }
+    return c;
+}
+
+#endif  // __AVX2__
+
+
+/***************************************************************************
+ *  Description:
+ *      Set flags[c] to OVERLAP_FLAG_ACTIVE if feature c ends after
+ *      peak_start, meaning it may overlap this or a later peak, plus
+ *      OVERLAP_FLAG_PASS if it overlaps the peak by the minimum
+ *      fractions in params.  Features must not be empty.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    overlap_flags(const int64_t starts[], const int64_t ends[],
+		      size_t count, int64_t peak_start, int64_t peak_end,
+		      const overlap_params_t *params, unsigned char flags[])
+
+{
+    size_t  done = 0;
+
+#ifdef __AVX2__
+    if ( peak_end - peak_start == 1 )
+	done = point_flags_avx2(starts, ends, count, peak_start, params,
+				flags);
+    else
+	done = interval_flags_avx2(starts, ends, count, peak_start, peak_end,
+				   params, flags);
+#endif
+    interval_flags_scalar(starts, ends, done, count, peak_start, peak_end,
+			  params, flags);
+}
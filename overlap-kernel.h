@@ -0,0 +1,19 @@
+#ifndef _OVERLAP_KERNEL_H_
+#define _OVERLAP_KERNEL_H_
+
+/*
+ *  Overlap tests for the innermost loop of classify_peak(), applied to
+ *  all active features of a peak at once.  Built with AVX2 when the
+ *  compiler targets it (e.g. CFLAGS+=-march=native), otherwise scalar.
+ *  Both produce identical flags.
+ */
+
+#define OVERLAP_FLAG_ACTIVE 0x01    // Feature ends after the peak start
+#define OVERLAP_FLAG_PASS   0x02    // Overlap meets -f, -F, and -e
+
+/* overlap-kernel.c */
+void    overlap_flags(const int64_t starts[], const int64_t ends[],
+		      size_t count, int64_t peak_start, int64_t peak_end,
+		      const overlap_params_t *params, unsigned char flags[]);
+
+#endif  // _OVERLAP_KERNEL_H_
@@ -0,0 +1,675 @@
+/***************************************************************************
+ *  Description:
+ *      Binary overlaps format.  Chromosomes are stored once per block
+ *      and feature names once per file, peak positions once per peak
+ *      group as deltas, and feature positions relative to the peak, all
+ *      as varints in column order.  This is typically several times
+ *      smaller than the TSV and needs no number parsing to read back.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xtend/mem.h>
+#include <xtend/math.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "overlaps-bin.h"
+
+/*
+ *  Varint and zigzag encoding
+ */
+
+static uint64_t zigzag(int64_t value)
+
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+
+static int64_t  unzigzag(uint64_t value)
+
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+static void buff_put(overlaps_bin_buff_t *buff, const void *data, size_t len)
+
+{
+    if ( buff->len + len > buff->array_size )
+    {
+	while ( buff->len + len > buff->array_size )
+	    buff->array_size = buff->array_size == 0 ? 65536 :
+			       buff->array_size * 2;
+	buff->data = xt_realloc(buff->data, buff->array_size, 1);
+    }
+    memcpy(buff->data + buff->len, data, len);
+    buff->len += len;
+}
+
+
+static void buff_put_varint(overlaps_bin_buff_t *buff, uint64_t value)
+
+{
+    unsigned char   bytes[10];
+    size_t          len = 0;
+
+    while ( value >= 0x80 )
+    {
+	bytes[len++] = (value & 0x7f) | 0x80;
+	value >>= 7;
+    }
+    bytes[len++] = value;
+    buff_put(buff, bytes, len);
+}
+
+
+static int  stream_put_varint(FILE *stream, uint64_t value)
+
+{
+    while ( value >= 0x80 )
+    {
+	putc((value & 0x7f) | 0x80, stream);
+	value >>= 7;
+    }
+    return putc(value, stream) == EOF ? EX_IOERR : EX_OK;
+}
+
+
+static int  stream_get_varint(FILE *stream, uint64_t *value)
+
+{
+    int     ch,
+	    shift;
+
+    for (*value = 0, shift = 0; shift < 64; shift += 7)
+    {
+	if ( (ch = getc(stream)) == EOF )
+	    return EOF;
+	*value |= (uint64_t)(ch & 0x7f) << shift;
+	if ( (ch & 0x80) == 0 )
+	    return EX_OK;
+    }
+    return EX_DATAERR;
+}
+
+
+/*
+ *  Decode the next varint from *p, which must be before end
+ */
+
+static int  get_varint(const unsigned char **p, const unsigned char *end,
+		       uint64_t *value)
+
+{
+    int     shift;
+
+    for (*value = 0, shift = 0; (shift < 64) && (*p < end); shift += 7)
+    {
+	*value |= (uint64_t)(**p & 0x7f) << shift;
+	if ( (*(*p)++ & 0x80) == 0 )
+	    return EX_OK;
+    }
+    return EX_DATAERR;
+}
+
+
+/*
+ *  Read a NUL-terminated string of at most max_len characters
+ */
+
+static int  stream_get_string(FILE *stream, char *str, size_t max_len)
+
+{
+    size_t  c;
+    int     ch;
+
+    for (c = 0; c <= max_len; ++c)
+    {
+	if ( (ch = getc(stream)) == EOF )
+	    return EX_DATAERR;
+	if ( (str[c] = ch) == '\0' )
+	    return EX_OK;
+    }
+    return EX_DATAERR;
+}
+
+
+/*
+ *  Make room for count peaks and rows in a block
+ */
+
+static void block_reserve(overlaps_bin_block_t *block, size_t peaks,
+			  size_t rows)
+
+{
+    if ( peaks > block->peak_array_size )
+    {
+	block->peak_array_size = peaks;
+	block->peak_starts = xt_realloc(block->peak_starts, peaks,
+					sizeof(*block->peak_starts));
+	block->peak_ends = xt_realloc(block->peak_ends, peaks,
+				      sizeof(*block->peak_ends));
+	block->peak_rows = xt_realloc(block->peak_rows, peaks,
+				      sizeof(*block->peak_rows));
+	block->peak_distances = xt_realloc(block->peak_distances, peaks,
+				      sizeof(*block->peak_distances));
+    }
+    if ( rows > block->row_array_size )
+    {
+	block->row_array_size = XT_MAX(rows, block->row_array_size * 2);
+	block->feature_starts = xt_realloc(block->feature_starts,
+		block->row_array_size, sizeof(*block->feature_starts));
+	block->feature_ends = xt_realloc(block->feature_ends,
+		block->row_array_size, sizeof(*block->feature_ends));
+	block->names = xt_realloc(block->names,
+		block->row_array_size, sizeof(*block->names));
+	block->strands = xt_realloc(block->strands,
+		block->row_array_size, sizeof(*block->strands));
+	block->overlaps = xt_realloc(block->overlaps,
+		block->row_array_size, sizeof(*block->overlaps));
+    }
+}
+
+
+static void block_free(overlaps_bin_block_t *block)
+
+{
+    free(block->peak_starts);
+    free(block->peak_ends);
+    free(block->peak_rows);
+    free(block->peak_distances);
+    free(block->feature_starts);
+    free(block->feature_ends);
+    free(block->names);
+    free(block->strands);
+    free(block->overlaps);
+    memset(block, 0, sizeof(*block));
+}
+
+
+/*
+ *  Header flags for classifying with params, ranked meaning with --rank
+ */
+
+unsigned    overlaps_bin_flags(const overlap_params_t *params, bool ranked)
+
+{
+    return (ranked ? OVERLAPS_BIN_NO_HEADER : 0) |
+	   (params->tss_regions != NULL ? OVERLAPS_BIN_TSS_DISTANCE : 0);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Start a binary overlaps writer on stream.  names is the feature
+ *      set name table, to which BEYOND_FEATURE_NAME is added.  The
+ *      header is written separately by overlaps_bin_write_header(), so
+ *      that writers for partitions can produce blocks to be appended
+ *      to another writer's output.  flags, from overlaps_bin_flags(),
+ *      must be the same for the partitions and the whole file.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Take flags here for the block layout
+ ***************************************************************************/
+
+int     overlaps_bin_open(overlaps_bin_writer_t *writer, FILE *stream,
+			  char **names, size_t name_count, unsigned flags)
+
+{
+    size_t  c;
+
+    memset(writer, 0, sizeof(*writer));
+    if ( name_count + 1 > OVERLAPS_BIN_MAX_NAMES )
+	return EX_DATAERR;
+    writer->stream = stream;
+    writer->flags = flags;
+    writer->name_count = name_count + 1;
+    writer->names = xt_malloc(writer->name_count, sizeof(*writer->names));
+    for (c = 0; c < name_count; ++c)
+	writer->names[c] = names[c];
+    writer->names[name_count] = BEYOND_FEATURE_NAME;
+    writer->status = EX_OK;
+    return EX_OK;
+}
+
+
+int     overlaps_bin_write_header(overlaps_bin_writer_t *writer)
+
+{
+    size_t  c;
+
+    fwrite(OVERLAPS_BIN_MAGIC, OVERLAPS_BIN_MAGIC_LEN, 1, writer->stream);
+    stream_put_varint(writer->stream, OVERLAPS_BIN_VERSION);
+    stream_put_varint(writer->stream, writer->flags);
+    stream_put_varint(writer->stream, writer->name_count);
+    for (c = 0; c < writer->name_count; ++c)
+	fwrite(writer->names[c], strlen(writer->names[c]) + 1, 1,
+	       writer->stream);
+    return ferror(writer->stream) ? EX_IOERR : EX_OK;
+}
+
+
+/*
+ *  Index of a feature name.  Names almost always come from the table
+ *  itself, so pointers are compared before strings.
+ */
+
+static size_t   name_index(overlaps_bin_writer_t *writer, const char *name)
+
+{
+    size_t  c;
+
+    if ( writer->names[writer->last_name] == name )
+	return writer->last_name;
+    for (c = 0; c < writer->name_count; ++c)
+	if ( writer->names[c] == name )
+	    return writer->last_name = c;
+    for (c = 0; c < writer->name_count; ++c)
+	if ( strcmp(writer->names[c], name) == 0 )
+	    return writer->last_name = c;
+    return writer->name_count;  // Not possible for a classified feature
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add one overlap to the current block.  The signature matches
+ *      overlap_emit_t, so this can be used as the emit function of a
+ *      sweep or rank.  A block is written when it is full or the
+ *      chromosome changes.  Errors are recorded in writer->status and
+ *      returned by overlaps_bin_close().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    overlaps_bin_emit(void *arg, const overlap_t *overlap)
+
+{
+    overlaps_bin_writer_t   *writer = arg;
+    overlaps_bin_block_t    *block = &writer->block;
+    size_t                  peak,
+			    row;
+
+    if ( (block->peak_count > 0) &&
+	 (strcmp(block->chrom, overlap->chrom) != 0) )
+	overlaps_bin_flush(writer);
+    if ( block->peak_count == 0 )
+    {
+	strncpy(block->chrom, overlap->chrom, BL_CHROM_MAX_CHARS);
+	block->chrom[BL_CHROM_MAX_CHARS] = '\0';
+    }
+
+    // Start a new peak group unless this row is for the last peak
+    peak = block->peak_count - 1;
+    if ( (block->peak_count == 0) ||
+	 (block->peak_starts[peak] != overlap->peak_start) ||
+	 (block->peak_ends[peak] != overlap->peak_end) )
+    {
+	if ( block->peak_count == OVERLAPS_BIN_BLOCK_PEAKS )
+	    overlaps_bin_flush(writer);     // Keeps block->chrom
+	block_reserve(block, OVERLAPS_BIN_BLOCK_PEAKS, block->row_count + 1);
+	peak = block->peak_count++;
+	block->peak_starts[peak] = overlap->peak_start;
+	block->peak_ends[peak] = overlap->peak_end;
+	block->peak_rows[peak] = 0;
+	block->peak_distances[peak] = overlap->tss_distance;
+    }
+    else
+	block_reserve(block, OVERLAPS_BIN_BLOCK_PEAKS, block->row_count + 1);
+
+    row = block->row_count++;
+    block->feature_starts[row] = overlap->feature_start;
+    block->feature_ends[row] = overlap->feature_end;
+    block->names[row] = name_index(writer, overlap->feature_name);
+    block->strands[row] = overlap->strand;
+    block->overlaps[row] = overlap->overlap;
+    ++block->peak_rows[peak];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Encode and write the current block, if it has any rows
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     overlaps_bin_flush(overlaps_bin_writer_t *writer)
+
+{
+    overlaps_bin_block_t    *block = &writer->block;
+    overlaps_bin_buff_t     *buff = &writer->buff;
+    int64_t                 prev_start;
+    size_t                  c,
+			    peak,
+			    row;
+
+    if ( block->peak_count == 0 )
+	return writer->status;
+
+    buff->len = 0;
+    for (c = 0, prev_start = 0; c < block->peak_count; ++c)
+    {
+	buff_put_varint(buff, zigzag(block->peak_starts[c] - prev_start));
+	prev_start = block->peak_starts[c];
+    }
+    for (c = 0; c < block->peak_count; ++c)
+	buff_put_varint(buff,
+			zigzag(block->peak_ends[c] - block->peak_starts[c]));
+    for (c = 0; c < block->peak_count; ++c)
+	buff_put_varint(buff, block->peak_rows[c]);
+    if ( writer->flags & OVERLAPS_BIN_TSS_DISTANCE )
+	for (c = 0; c < block->peak_count; ++c)
+	    buff_put_varint(buff, zigzag(block->peak_distances[c]));
+    for (peak = row = 0; peak < block->peak_count; ++peak)
+	for (c = 0; c < block->peak_rows[peak]; ++c, ++row)
+	    buff_put_varint(buff, zigzag(block->feature_starts[row] -
+					 block->peak_starts[peak]));
+    for (c = 0; c < block->row_count; ++c)
+	buff_put_varint(buff,
+		zigzag(block->feature_ends[c] - block->feature_starts[c]));
+    for (c = 0; c < block->row_count; ++c)
+	buff_put_varint(buff, block->names[c]);
+    buff_put(buff, block->strands, block->row_count);
+    for (c = 0; c < block->row_count; ++c)
+	buff_put_varint(buff, zigzag(block->overlaps[c]));
+
+    stream_put_varint(writer->stream, block->peak_count);
+    stream_put_varint(writer->stream, block->row_count);
+    stream_put_varint(writer->stream, buff->len);
+    fwrite(block->chrom, strlen(block->chrom) + 1, 1, writer->stream);
+    if ( fwrite(buff->data, buff->len, 1, writer->stream) != 1 )
+	writer->status = EX_IOERR;
+    block->peak_count = block->row_count = 0;
+    return writer->status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write any remaining rows and free the writer.  If end is true,
+ *      also write the end-of-file marker.  Partition writers pass
+ *      false, and the writer for the whole file passes true.  The
+ *      stream is not closed.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     overlaps_bin_close(overlaps_bin_writer_t *writer, bool end)
+
+{
+    int     status;
+
+    overlaps_bin_flush(writer);
+    if ( end )
+	stream_put_varint(writer->stream, 0);
+    status = ferror(writer->stream) ? EX_IOERR : writer->status;
+    block_free(&writer->block);
+    free(writer->buff.data);
+    free(writer->names);
+    writer->names = NULL;
+    writer->buff.data = NULL;
+    return status;
+}
+
+
+/*
+ *  Return true if stream starts with a binary overlaps file.  Only the
+ *  first byte is examined, so the stream need not be seekable.
+ */
+
+bool    overlaps_bin_detect(FILE *stream)
+
+{
+    int     ch;
+
+    if ( (ch = getc(stream)) == EOF )
+	return false;
+    ungetc(ch, stream);
+    return ch == (unsigned char)OVERLAPS_BIN_MAGIC[0];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read the header of a binary overlaps file.  Version 1 files,
+ *      which predate OVERLAPS_BIN_TSS_DISTANCE, are still accepted.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Accept versions 1 and 2
+ ***************************************************************************/
+
+int     overlaps_bin_read_open(overlaps_bin_reader_t *reader, FILE *stream)
+
+{
+    char        magic[OVERLAPS_BIN_MAGIC_LEN],
+		name[BL_BED_NAME_MAX_CHARS + 1];
+    uint64_t    version,
+		flags,
+		name_count;
+    size_t      c;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->stream = stream;
+    if ( (fread(magic, OVERLAPS_BIN_MAGIC_LEN, 1, stream) != 1) ||
+	 (memcmp(magic, OVERLAPS_BIN_MAGIC, OVERLAPS_BIN_MAGIC_LEN) != 0) ||
+	 (stream_get_varint(stream, &version) != EX_OK) ||
+	 (version < 1) || (version > OVERLAPS_BIN_VERSION) ||
+	 (stream_get_varint(stream, &flags) != EX_OK) ||
+	 ((flags & ~(uint64_t)OVERLAPS_BIN_FLAGS) != 0) ||
+	 (stream_get_varint(stream, &name_count) != EX_OK) ||
+	 (name_count > OVERLAPS_BIN_MAX_NAMES) )
+	return EX_DATAERR;
+    reader->flags = flags;
+    reader->names = xt_malloc(name_count, sizeof(*reader->names));
+    for (c = 0; c < name_count; ++c)
+    {
+	if ( stream_get_string(stream, name, BL_BED_NAME_MAX_CHARS) != EX_OK )
+	{
+	    overlaps_bin_read_close(reader);
+	    return EX_DATAERR;
+	}
+	reader->names[reader->name_count++] = strdup(name);
+    }
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read and decode the next block.  Return EX_OK, EOF at the end
+ *      marker, or EX_DATAERR.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static int  read_block(overlaps_bin_reader_t *reader)
+
+{
+    overlaps_bin_block_t    *block = &reader->block;
+    const unsigned char     *p,
+			    *end;
+    uint64_t                peak_count,
+			    row_count,
+			    payload_size,
+			    value;
+    int64_t                 prev_start;
+    size_t                  c,
+			    peak,
+			    row,
+			    rows;
+
+    if ( stream_get_varint(reader->stream, &peak_count) != EX_OK )
+	return EX_DATAERR;  // Missing end marker
+    if ( peak_count == 0 )
+	return EOF;
+    if ( (peak_count > OVERLAPS_BIN_BLOCK_PEAKS) ||
+	 (stream_get_varint(reader->stream, &row_count) != EX_OK) ||
+	 (row_count < peak_count) ||
+	 (stream_get_varint(reader->stream, &payload_size) != EX_OK) ||
+	 (payload_size < row_count) || (payload_size > SIZE_MAX / 2) ||
+	 (stream_get_string(reader->stream, block->chrom,
+			    BL_CHROM_MAX_CHARS) != EX_OK) )
+	return EX_DATAERR;
+
+    if ( payload_size > reader->payload_array_size )
+    {
+	reader->payload_array_size = payload_size;
+	reader->payload = xt_realloc(reader->payload, payload_size, 1);
+    }
+    if ( fread(reader->payload, payload_size, 1, reader->stream) != 1 )
+	return EX_DATAERR;
+    p = reader->payload;
+    end = p + payload_size;
+
+    block_reserve(block, peak_count, row_count);
+    block->peak_count = peak_count;
+    block->row_count = row_count;
+    for (c = 0, prev_start = 0; c < peak_count; ++c)
+    {
+	if ( get_varint(&p, end, &value) != EX_OK )
+	    return EX_DATAERR;
+	block->peak_starts[c] = prev_start += unzigzag(value);
+    }
+    for (c = 0; c < peak_count; ++c)
+    {
+	if ( get_varint(&p, end, &value) != EX_OK )
+	    return EX_DATAERR;
+	block->peak_ends[c] = block->peak_starts[c] + unzigzag(value);
+    }
+    for (c = rows = 0; c < peak_count; ++c)
+    {
+	// Every peak group has at least one row
+	if ( (get_varint(&p, end, &value) != EX_OK) || (value == 0) )
+	    return EX_DATAERR;
+	block->peak_rows[c] = value;
+	rows += value;
+    }
+    if ( rows != row_count )
+	return EX_DATAERR;
+    for (c = 0; c < peak_count; ++c)
+    {
+	if ( !(reader->flags & OVERLAPS_BIN_TSS_DISTANCE) )
+	    block->peak_distances[c] = OVERLAP_NO_TSS_DISTANCE;
+	else if ( get_varint(&p, end, &value) != EX_OK )
+	    return EX_DATAERR;
+	else
+	    block->peak_distances[c] = unzigzag(value);
+    }
+    for (peak = row = 0; peak < peak_count; ++peak)
+	for (c = 0; c < block->peak_rows[peak]; ++c, ++row)
+	{
+	    if ( get_varint(&p, end, &value) != EX_OK )
+		return EX_DATAERR;
+	    block->feature_starts[row] = block->peak_starts[peak] +
+					 unzigzag(value);
+	}
+    for (c = 0; c < row_count; ++c)
+    {
+	if ( get_varint(&p, end, &value) != EX_OK )
+	    return EX_DATAERR;
+	block->feature_ends[c] = block->feature_starts[c] + unzigzag(value);
+    }
+    for (c = 0; c < row_count; ++c)
+    {
+	if ( (get_varint(&p, end, &value) != EX_OK) ||
+	     (value >= reader->name_count) )
+	    return EX_DATAERR;
+	block->names[c] = value;
+    }
+    if ( (size_t)(end - p) < row_count )
+	return EX_DATAERR;
+    memcpy(block->strands, p, row_count);
+    p += row_count;
+    for (c = 0; c < row_count; ++c)
+    {
+	if ( get_varint(&p, end, &value) != EX_OK )
+	    return EX_DATAERR;
+	block->overlaps[c] = unzigzag(value);
+    }
+
+    reader->peak = reader->row = 0;
+    reader->peak_rows_left = block->peak_rows[0];
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read the next overlap.  The chrom and feature_name pointers are
+ *      valid until the next call.  Return EX_OK, EOF, or EX_DATAERR.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     overlaps_bin_read(overlaps_bin_reader_t *reader, overlap_t *overlap)
+
+{
+    overlaps_bin_block_t    *block = &reader->block;
+    size_t                  row;
+    int                     status;
+
+    if ( reader->row == block->row_count )
+    {
+	if ( (status = read_block(reader)) != EX_OK )
+	{
+	    if ( status != EOF )
+		fputs("overlaps_bin_read(): Corrupt binary overlaps file.\n",
+		      stderr);
+	    return status;
+	}
+    }
+    // Peaks always have at least one row, so this finds the next one
+    while ( reader->peak_rows_left == 0 )
+	reader->peak_rows_left = block->peak_rows[++reader->peak];
+
+    row = reader->row++;
+    --reader->peak_rows_left;
+    overlap->chrom = block->chrom;
+    overlap->peak_start = block->peak_starts[reader->peak];
+    overlap->peak_end = block->peak_ends[reader->peak];
+    overlap->feature_start = block->feature_starts[row];
+    overlap->feature_end = block->feature_ends[row];
+    overlap->feature_name = reader->names[block->names[row]];
+    overlap->strand = block->strands[row];
+    overlap->overlap = block->overlaps[row];
+    overlap->tss_distance = block->peak_distances[reader->peak];
+    return EX_OK;
+}
+
+
+void    overlaps_bin_read_close(overlaps_bin_reader_t *reader)
+
+{
+    size_t  c;
+
+    for (c = 0; c < reader->name_count; ++c)
+	free(reader->names[c]);
+    free(reader->names);
+    free(reader->payload);
+    block_free(&reader->block);
+    memset(reader, 0, sizeof(*reader));
+}
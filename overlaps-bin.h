@@ -0,0 +1,114 @@
+#ifndef _OVERLAPS_BIN_H_
+#define _OVERLAPS_BIN_H_
+
+/*
+ *  Compact binary alternative to the overlaps TSV, written when the
+ *  overlaps file name ends in OVERLAPS_BIN_EXT.  Rows hold the same
+ *  columns as the TSV, in the same order, so conversion in either
+ *  direction is exact.
+ *
+ *  Layout (all integers are LEB128 varints, signed ones zigzag encoded):
+ *      OVERLAPS_BIN_MAGIC
+ *      version
+ *      flags, OVERLAPS_BIN_* below
+ *      name_count, then name_count NUL-terminated feature names
+ *      Blocks, each holding up to OVERLAPS_BIN_BLOCK_PEAKS consecutive
+ *      peak groups on one chromosome:
+ *          peak_count, row_count, payload size in bytes
+ *          chromosome, NUL-terminated
+ *          payload, one column after another:
+ *              peak start, signed delta from the previous peak
+ *              peak end - peak start
+ *              rows for the peak
+ *              TSS-distance, signed, with OVERLAPS_BIN_TSS_DISTANCE
+ *              feature start - peak start, signed
+ *              feature end - feature start, signed
+ *              feature name index
+ *              strand, one raw byte per row
+ *              overlap
+ *      peak_count 0 marks the end of the file.
+ *
+ *  A peak group is a run of rows with the same chromosome, start, and
+ *  end, as in filter-overlaps, so the peak columns are stored once per
+ *  peak rather than once per row.
+ */
+
+#define OVERLAPS_BIN_EXT        ".pco"
+#define OVERLAPS_BIN_MAGIC      "\x89PCOVL\r\n"
+#define OVERLAPS_BIN_MAGIC_LEN  8
+#define OVERLAPS_BIN_VERSION    2     // 2 adds OVERLAPS_BIN_TSS_DISTANCE
+#define OVERLAPS_BIN_BLOCK_PEAKS 4096
+#define OVERLAPS_BIN_MAX_NAMES  65536
+
+// Header flags
+#define OVERLAPS_BIN_NO_HEADER  0x01    // TSV equivalent has no header (--rank)
+#define OVERLAPS_BIN_TSS_DISTANCE 0x02  // Per-peak column (--tss-distance)
+#define OVERLAPS_BIN_FLAGS      0x03    // All known flags
+
+// Byte buffer for encoding a block
+typedef struct
+{
+    unsigned char   *data;
+    size_t          len;
+    size_t          array_size;
+}   overlaps_bin_buff_t;
+
+// One column-oriented block, being filled or decoded
+typedef struct
+{
+    char            chrom[BL_CHROM_MAX_CHARS + 1];
+    size_t          peak_count;
+    size_t          peak_array_size;
+    int64_t         *peak_starts;
+    int64_t         *peak_ends;
+    size_t          *peak_rows;
+    int64_t         *peak_distances;
+    size_t          row_count;
+    size_t          row_array_size;
+    int64_t         *feature_starts;
+    int64_t         *feature_ends;
+    size_t          *names;
+    char            *strands;
+    int64_t         *overlaps;
+}   overlaps_bin_block_t;
+
+typedef struct
+{
+    FILE                    *stream;
+    unsigned                flags;
+    const char              **names;    // Feature set names, then beyond
+    size_t                  name_count;
+    size_t                  last_name;  // Usually the next name as well
+    overlaps_bin_block_t    block;
+    overlaps_bin_buff_t     buff;
+    int                     status;
+}   overlaps_bin_writer_t;
+
+typedef struct
+{
+    FILE                    *stream;
+    unsigned                flags;
+    char                    **names;
+    size_t                  name_count;
+    overlaps_bin_block_t    block;
+    unsigned char           *payload;
+    size_t                  payload_array_size;
+    size_t                  peak;       // Next peak and row in block
+    size_t                  row;
+    size_t                  peak_rows_left;
+}   overlaps_bin_reader_t;
+
+/* overlaps-bin.c */
+unsigned    overlaps_bin_flags(const overlap_params_t *params, bool ranked);
+int     overlaps_bin_open(overlaps_bin_writer_t *writer, FILE *stream,
+			  char **names, size_t name_count, unsigned flags);
+int     overlaps_bin_write_header(overlaps_bin_writer_t *writer);
+void    overlaps_bin_emit(void *arg, const overlap_t *overlap);
+int     overlaps_bin_flush(overlaps_bin_writer_t *writer);
+int     overlaps_bin_close(overlaps_bin_writer_t *writer, bool end);
+bool    overlaps_bin_detect(FILE *stream);
+int     overlaps_bin_read_open(overlaps_bin_reader_t *reader, FILE *stream);
+int     overlaps_bin_read(overlaps_bin_reader_t *reader, overlap_t *overlap);
+void    overlaps_bin_read_close(overlaps_bin_reader_t *reader);
+
+#endif  // _OVERLAPS_BIN_H_
@@ -0,0 +1,95 @@
+/***************************************************************************
+ *  Description:
+ *      Convert a binary overlaps file from peak-classifier to the same
+ *      TSV it would have written, for tools that only read text.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xtend/file.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "overlaps-bin.h"
+
+void    usage(char *argv[]);
+
+int     main(int argc,char *argv[])
+
+{
+    FILE                    *infile,
+			    *outfile;
+    overlaps_bin_reader_t   reader;
+    overlap_t               overlap;
+    int                     status;
+
+    if ( (argc == 2) && (strcmp(argv[1],"--version")) == 0 )
+    {
+	printf("%s %s\n", argv[0], VERSION);
+	return EX_OK;
+    }
+    if ( argc != 3 )
+	usage(argv);
+
+    if ( strcmp(argv[1], "-") == 0 )
+	infile = stdin;
+    else if ( (infile = xt_fopen(argv[1], "r")) == NULL )
+    {
+	fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[1],
+		strerror(errno));
+	return EX_NOINPUT;
+    }
+    if ( overlaps_bin_read_open(&reader, infile) != EX_OK )
+    {
+	fprintf(stderr, "%s: %s is not a binary overlaps file.\n", argv[0],
+		argv[1]);
+	return EX_DATAERR;
+    }
+
+    if ( strcmp(argv[2], "-") == 0 )
+	outfile = stdout;
+    else if ( (outfile = xt_fopen(argv[2], "w")) == NULL )
+    {
+	fprintf(stderr, "%s: Cannot create %s: %s\n", argv[0], argv[2],
+		strerror(errno));
+	return EX_CANTCREAT;
+    }
+
+    if ( !(reader.flags & OVERLAPS_BIN_NO_HEADER) )
+	fputs(reader.flags & OVERLAPS_BIN_TSS_DISTANCE ?
+	      OVERLAPS_TSS_HEADER : OVERLAPS_HEADER, outfile);
+    while ( (status = overlaps_bin_read(&reader, &overlap)) == EX_OK )
+	overlap_write(outfile, overlap.chrom, overlap.peak_start,
+		      overlap.peak_end, overlap.feature_start,
+		      overlap.feature_end, overlap.feature_name,
+		      overlap.strand, overlap.overlap, overlap.tss_distance);
+    overlaps_bin_read_close(&reader);
+    xt_fclose(infile);
+    if ( ferror(outfile) | (xt_fclose(outfile) != 0) )
+    {
+	fprintf(stderr, "%s: Error writing %s.\n", argv[0], argv[2]);
+	return EX_IOERR;
+    }
+    return status == EOF ? EX_OK : status;
+}
+
+
+void    usage(char *argv[])
+
+{
+    fprintf(stderr,
+	    "\nUsage: %s --version"
+	    "\n       %s overlaps.pco overlaps.tsv\n\n"
+	    "Converts a binary overlaps file from peak-classifier to TSV.\n"
+	    "Either file may be '-' for the standard input or output.\n\n",
+	    argv[0], argv[0]);
+    exit(EX_USAGE);
+}
@@ -0,0 +1,487 @@
+/***************************************************************************
+ *  Description:
+ *      Multithreaded classification.  Peaks are read into chromosome
+ *      partitions, which worker threads classify independently, largest
+ *      first so that chr1 does not start last and hold up the finish.
+ *      The main thread writes each partition's output as soon as it and
+ *      all partitions before it are done, so the result is identical to
+ *      serial classification.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <xtend/mem.h>
+#include <xtend/math.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "overlaps-bin.h"
+#include "peak-reader.h"
+#include "rank.h"
+#include "peak-sort.h"
+#include "partition.h"
+
+/***************************************************************************
+ *  Description:
+ *      Read all peaks from a BED stream into chromosome partitions.
+ *      With --midpoints, peaks are reduced to their midpoints here.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Read peaks with peak_reader_t
+ ***************************************************************************/
+
+int     partition_read_peaks(partition_list_t *list, FILE *peak_stream,
+			     overlap_params_t *params)
+
+{
+    peak_reader_t       reader;
+    const peak_line_t   *line;
+    peak_partition_t    *part = NULL;
+    peak_t              *peak;
+
+    peak_reader_open(&reader, peak_stream, true);
+    while ( (line = peak_reader_next(&reader)) != NULL )
+    {
+	if ( (part == NULL) || (strcmp(part->chrom, line->chrom) != 0) )
+	{
+	    if ( list->count == list->array_size )
+	    {
+		list->array_size = list->array_size == 0 ? 64 :
+				   list->array_size * 2;
+		list->partitions = xt_realloc(list->partitions,
+				list->array_size, sizeof(*list->partitions));
+	    }
+	    part = &list->partitions[list->count++];
+	    memset(part, 0, sizeof(*part));
+	    strcpy(part->chrom, line->chrom);
+	}
+
+	if ( part->count == part->array_size )
+	{
+	    part->array_size = part->array_size == 0 ? 1024 :
+			       part->array_size * 2;
+	    part->peaks = xt_realloc(part->peaks, part->array_size,
+				     sizeof(*part->peaks));
+	}
+	peak = &part->peaks[part->count++];
+	peak->start = line->start;
+	peak->end = line->end;
+	if ( params->midpoints_only )
+	{
+	    // Replace peak start/end with midpoint coordinates
+	    peak->start = (peak->start + peak->end) / 2;
+	    peak->end = peak->start + 1;
+	}
+    }
+    return peak_reader_close(&reader);
+}
+
+
+/*
+ *  Append the output buffered for a partition to its spill file and
+ *  free the buffer.  If mem_stream is not NULL, it is closed first and
+ *  reopened on a new buffer, and the binary writer, if any, is pointed
+ *  at the new stream.
+ */
+
+static int  partition_spill(partition_list_t *list, peak_partition_t *part,
+			    FILE **mem_stream, overlaps_bin_writer_t *writer)
+
+{
+    int     status = EX_OK;
+
+    if ( (mem_stream != NULL) && (fclose(*mem_stream) != 0) )
+	status = EX_OSERR;
+    if ( (part->spill == NULL) &&
+	 ((part->spill = temp_file_create(list->temp_dir)) == NULL) )
+	status = EX_CANTCREAT;
+    else if ( (part->output_size > 0) &&
+	      (fwrite(part->output, part->output_size, 1, part->spill) != 1) )
+    {
+	fprintf(stderr, "peak-classifier: Cannot write spill file: %s\n",
+		strerror(errno));
+	status = EX_IOERR;
+    }
+    free(part->output);
+    part->output = NULL;
+    part->output_size = 0;
+    if ( mem_stream != NULL )
+    {
+	if ( (*mem_stream = open_memstream(&part->output,
+					   &part->output_size)) == NULL )
+	{
+	    fprintf(stderr, "peak-classifier: open_memstream() failed: %s\n",
+		    strerror(errno));
+	    return EX_OSERR;
+	}
+	if ( writer != NULL )
+	    writer->stream = *mem_stream;
+    }
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify one partition into a private memory buffer.  Binary
+ *      output is written as blocks only, to follow the header written
+ *      by classify_peaks_threaded().  Output beyond list->chunk_size
+ *      bytes is moved to a spill file as it is produced, and a
+ *      finished partition that must wait for earlier ones is spilled
+ *      unless it fits within list->max_buffered.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Add binary output
+ *  2026-10-16  Jason Bacon Add TSS-distance column
+ *  2026-10-16  Jason Bacon Spill output to bound memory use
+ ***************************************************************************/
+
+static int  classify_partition(partition_list_t *list, peak_partition_t *part)
+
+{
+    FILE        *mem_stream;
+    sweep_t     sweep = SWEEP_INIT;
+    overlaps_bin_writer_t   writer;
+    size_t      c;
+    bool        keep;
+    int         status = EX_OK;
+
+    if ( (mem_stream = open_memstream(&part->output,
+				      &part->output_size)) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: open_memstream() failed: %s\n",
+		strerror(errno));
+	return EX_OSERR;
+    }
+    if ( list->rank != NULL )
+	rank_init(&part->rank, list->rank->features, list->fs);
+    if ( list->params->binary_output )
+    {
+	overlaps_bin_open(&writer, mem_stream, list->fs->names,
+			  list->fs->name_count,
+			  overlaps_bin_flags(list->params, list->rank != NULL));
+	if ( list->rank != NULL )
+	{
+	    part->rank.emit = overlaps_bin_emit;
+	    part->rank.emit_arg = &writer;
+	}
+	else
+	{
+	    sweep.emit = overlaps_bin_emit;
+	    sweep.emit_arg = &writer;
+	}
+    }
+    for (c = 0; (c < part->count) && (status == EX_OK); ++c)
+    {
+	classify_peak(list->fs, &sweep, part->chrom,
+		      part->peaks[c].start, part->peaks[c].end, list->params,
+		      list->rank != NULL ? &part->rank : NULL, mem_stream);
+	if ( (c % PARTITION_CHECK_PEAKS == 0) &&
+	     ((size_t)ftello(mem_stream) > list->chunk_size) )
+	    status = partition_spill(list, part, &mem_stream,
+			list->params->binary_output ? &writer : NULL);
+    }
+    if ( status != EX_OK )
+    {
+	// Not counted in list->buffered, so must not be left for the writer
+	if ( mem_stream != NULL )
+	    fclose(mem_stream);
+	free(part->output);
+	part->output = NULL;
+	part->output_size = 0;
+	sweep_free(&sweep);
+	return status;
+    }
+    if ( list->rank != NULL )
+	rank_finish(&part->rank, mem_stream);
+    if ( list->params->binary_output )
+	status = overlaps_bin_close(&writer, false);
+    part->rows = sweep.rows;
+    sweep_free(&sweep);
+    if ( fclose(mem_stream) != 0 )
+	status = EX_OSERR;
+
+    // The next partition to write goes out at once, so is always kept
+    pthread_mutex_lock(&list->lock);
+    keep = (part == &list->partitions[list->written]) ||
+	   (list->buffered + part->output_size <= list->max_buffered);
+    if ( keep )
+	list->buffered += part->output_size;
+    pthread_mutex_unlock(&list->lock);
+    if ( !keep && (partition_spill(list, part, NULL, NULL) != EX_OK) )
+	status = EX_IOERR;
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Worker thread: claim partitions in schedule order until none
+ *      are left
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void *partition_worker(void *arg)
+
+{
+    partition_list_t    *list = arg;
+    peak_partition_t    *part;
+    int                 status;
+
+    for (;;)
+    {
+	pthread_mutex_lock(&list->lock);
+	if ( list->next == list->count )
+	{
+	    pthread_mutex_unlock(&list->lock);
+	    break;
+	}
+	part = list->schedule[list->next++];
+	pthread_mutex_unlock(&list->lock);
+
+	status = classify_partition(list, part);
+
+	pthread_mutex_lock(&list->lock);
+	part->status = status;
+	part->done = true;
+	pthread_cond_broadcast(&list->done_cond);
+	pthread_mutex_unlock(&list->lock);
+    }
+    return NULL;
+}
+
+
+/*
+ *  qsort() comparison for the schedule: most peaks first
+ */
+static int  schedule_cmp(const void *p1, const void *p2)
+
+{
+    size_t  count1 = (*(peak_partition_t * const *)p1)->count,
+	    count2 = (*(peak_partition_t * const *)p2)->count;
+
+    return count1 < count2 ? 1 : count1 > count2 ? -1 : 0;
+}
+
+
+/*
+ *  Copy a spill file to overlaps_stream
+ */
+
+static int  spill_copy(FILE *spill, FILE *overlaps_stream)
+
+{
+    char    *buff;
+    size_t  bytes;
+    int     status = EX_OK;
+
+    rewind(spill);
+    buff = xt_malloc(PARTITION_MIN_CHUNK, 1);
+    while ( (bytes = fread(buff, 1, PARTITION_MIN_CHUNK, spill)) > 0 )
+	fwrite(buff, bytes, 1, overlaps_stream);
+    if ( ferror(spill) )
+    {
+	fprintf(stderr, "peak-classifier: Cannot read spill file: %s\n",
+		strerror(errno));
+	status = EX_IOERR;
+    }
+    free(buff);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify all partitions using the given number of threads and
+ *      write the results to overlaps_stream in input order.  Each
+ *      partition's output is freed as soon as it is written.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Write spilled output first
+ ***************************************************************************/
+
+int     classify_partitions(partition_list_t *list, FILE *overlaps_stream,
+			    unsigned threads)
+
+{
+    pthread_t           *tids;
+    peak_partition_t    *part;
+    size_t              c;
+    unsigned            t,
+			started;
+    int                 status = EX_OK;
+
+    list->written = list->buffered = 0;
+    list->schedule = xt_malloc(list->count, sizeof(*list->schedule));
+    for (c = 0; c < list->count; ++c)
+	list->schedule[c] = &list->partitions[c];
+    qsort(list->schedule, list->count, sizeof(*list->schedule), schedule_cmp);
+    list->next = 0;
+
+    if ( threads > list->count )
+	threads = list->count;
+    tids = xt_malloc(threads, sizeof(*tids));
+    for (t = started = 0; t < threads; ++t)
+	if ( pthread_create(&tids[started], NULL, partition_worker, list) == 0 )
+	    ++started;
+    if ( (started == 0) && (list->count > 0) )
+    {
+	fputs("peak-classifier: Cannot create worker threads.\n", stderr);
+	free(tids);
+	return EX_OSERR;
+    }
+
+    for (c = 0; c < list->count; ++c)
+    {
+	part = &list->partitions[c];
+	pthread_mutex_lock(&list->lock);
+	while ( !part->done )
+	    pthread_cond_wait(&list->done_cond, &list->lock);
+	pthread_mutex_unlock(&list->lock);
+
+	if ( part->status != EX_OK )
+	    status = part->status;
+	else if ( status == EX_OK )
+	{
+	    if ( part->spill != NULL )
+		status = spill_copy(part->spill, overlaps_stream);
+	    fwrite(part->output, part->output_size, 1, overlaps_stream);
+	}
+	if ( part->spill != NULL )
+	{
+	    fclose(part->spill);
+	    part->spill = NULL;
+	}
+	pthread_mutex_lock(&list->lock);
+	list->buffered -= part->output_size;
+	list->written = c + 1;
+	pthread_mutex_unlock(&list->lock);
+	free(part->output);
+	part->output = NULL;
+	part->output_size = 0;
+	if ( list->rank != NULL )
+	{
+	    rank_merge(list->rank, &part->rank);
+	    rank_free(&part->rank);
+	}
+    }
+
+    for (t = 0; t < started; ++t)
+	pthread_join(tids[t], NULL);
+    free(tids);
+    return status;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read and classify all peaks in a BED stream using multiple
+ *      threads.  Output and counts are identical to classify_peaks().
+ *      All peaks are held in memory, 16 bytes each, and overlaps
+ *      waiting to be written in order use up to about mem bytes, with
+ *      the rest spilled to temp_dir, or $TMPDIR or /tmp if temp_dir is
+ *      NULL.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Add TSS-distance column
+ *  2026-10-16  Jason Bacon Add mem and temp_dir to bound output buffers
+ ***************************************************************************/
+
+int     classify_peaks_threaded(feature_set_t *fs, FILE *peak_stream,
+				FILE *overlaps_stream, overlap_params_t *params,
+				rank_t *rank, classify_counts_t *counts,
+				unsigned threads, size_t mem,
+				const char *temp_dir)
+
+{
+    partition_list_t    list = PARTITION_LIST_INIT;
+    overlaps_bin_writer_t   writer;
+    int                 status;
+    size_t              c;
+
+    list.fs = fs;
+    list.params = params;
+    list.rank = rank;
+    if ( (temp_dir == NULL) && ((temp_dir = getenv("TMPDIR")) == NULL) )
+	temp_dir = "/tmp";
+    list.temp_dir = temp_dir;
+    // Half for workers still classifying, half for finished partitions
+    list.chunk_size = XT_MAX(mem / 2 / threads, PARTITION_MIN_CHUNK);
+    list.max_buffered = mem / 2;
+    if ( (status = partition_read_peaks(&list, peak_stream, params)) == EX_OK )
+    {
+	if ( params->binary_output )
+	{
+	    // Partitions write blocks, so only the header and end are here
+	    status = overlaps_bin_open(&writer, overlaps_stream, fs->names,
+			fs->name_count, overlaps_bin_flags(params, rank != NULL));
+	    if ( status == EX_OK )
+	    {
+		overlaps_bin_write_header(&writer);
+		status = classify_partitions(&list, overlaps_stream, threads);
+		if ( overlaps_bin_close(&writer, true) != EX_OK )
+		    status = EX_IOERR;
+	    }
+	}
+	else
+	{
+	    if ( rank == NULL )
+		fputs(params->tss_regions != NULL ? OVERLAPS_TSS_HEADER :
+		      OVERLAPS_HEADER, overlaps_stream);
+	    status = classify_partitions(&list, overlaps_stream, threads);
+	}
+    }
+    if ( counts != NULL )
+    {
+	for (c = 0; c < list.count; ++c)
+	{
+	    counts->peaks += list.partitions[c].count;
+	    counts->rows += list.partitions[c].rows;
+	}
+	if ( rank != NULL )
+	    counts->rows += rank_kept(rank);
+    }
+    partition_list_free(&list);
+    return status;
+}
+
+
+void    partition_list_free(partition_list_t *list)
+
+{
+    size_t  c;
+
+    for (c = 0; c < list->count; ++c)
+    {
+	free(list->partitions[c].peaks);
+	free(list->partitions[c].output);
+	if ( list->partitions[c].spill != NULL )
+	    fclose(list->partitions[c].spill);
+	rank_free(&list->partitions[c].rank);
+    }
+    free(list->partitions);
+    free(list->schedule);
+    list->partitions = NULL;
+    list->schedule = NULL;
+    list->count = list->array_size = list->next = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef _PARTITION_H_
+#define _PARTITION_H_
+
+/*
+ *  Peaks split into chromosome partitions for multithreaded
+ *  classification.  Each partition is a run of consecutive peaks on
+ *  the same chromosome, so writing partition outputs in order
+ *  reproduces the serial output exactly.
+ *
+ *  Partitions finish out of order, so output waiting to be written is
+ *  limited to about the --mem size.  A worker moves its output to an
+ *  unlinked spill file in --temp-dir whenever more than chunk_size
+ *  bytes are buffered, and a finished partition is spilled unless it
+ *  is the next to be written or fits within max_buffered.
+ */
+
+// Smallest output buffer per worker before spilling
+#define PARTITION_MIN_CHUNK     (1024 * 1024)
+// Peaks classified between checks of the output buffer size
+#define PARTITION_CHECK_PEAKS   256
+
+typedef struct
+{
+    int64_t         start;
+    int64_t         end;
+}   peak_t;
+
+typedef struct
+{
+    char            chrom[BL_CHROM_MAX_CHARS + 1];
+    peak_t          *peaks;
+    size_t          count;
+    size_t          array_size;
+    char            *output;        // Overlap lines, from open_memstream()
+    size_t          output_size;
+    FILE            *spill;         // Earlier output, NULL if none
+    unsigned long   rows;           // Lines written without --rank
+    rank_t          rank;           // Counts for this partition with --rank
+    int             status;
+    bool            done;
+}   peak_partition_t;
+
+typedef struct
+{
+    peak_partition_t    *partitions;
+    size_t              count;
+    size_t              array_size;
+    peak_partition_t    **schedule; // Most peaks first
+    size_t              next;       // Next schedule entry to claim
+    feature_set_t       *fs;
+    overlap_params_t    *params;
+    rank_t              *rank;      // Merged counts, NULL without --rank
+    const char          *temp_dir;  // For output spills
+    size_t              chunk_size; // Output buffered per worker
+    size_t              max_buffered;   // Finished output in memory
+    pthread_mutex_t     lock;       // Protects the fields below
+    pthread_cond_t      done_cond;
+    size_t              buffered;   // Finished output in memory now
+    size_t              written;    // Partitions written so far
+}   partition_list_t;
+
+#define PARTITION_LIST_INIT \
+    { NULL, 0, 0, NULL, 0, NULL, NULL, NULL, NULL, 0, 0, \
+      PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0 }
+
+/* partition.c */
+int     partition_read_peaks(partition_list_t *list, FILE *peak_stream,
+			     overlap_params_t *params);
+int     classify_peaks_threaded(feature_set_t *fs, FILE *peak_stream,
+				FILE *overlaps_stream, overlap_params_t *params,
+				rank_t *rank, classify_counts_t *counts,
+				unsigned threads, size_t mem,
+				const char *temp_dir);
+int     classify_partitions(partition_list_t *list, FILE *overlaps_stream,
+			    unsigned threads);
+void    partition_list_free(partition_list_t *list);
+
+#endif  // _PARTITION_H_
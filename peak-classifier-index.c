@@ -0,0 +1,163 @@
+/***************************************************************************
+ *  Description:
+ *      Build the augmented feature BED file and binary feature index
+ *      for a GFF, so that any number of later peak-classifier runs
+ *      can map the index instead of augmenting and sorting the GFF.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Add --tss-distance
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <xtend/file.h>
+#include <xtend/mem.h>
+#include <biolibc/bed.h>
+#include <biolibc/gff3.h>
+#include <biolibc/pos-list.h>
+#include "feature-sort.h"
+#include "classify.h"
+#include "fast-write.h"
+#include "augment.h"
+#include "stats.h"
+#include "feature-index.h"
+#include "decompress.h"
+
+void    usage(char *argv[]);
+
+int     main(int argc,char *argv[])
+
+{
+    int     c,
+	    status,
+	    lock_fd;
+    unsigned long   threads = 1;
+    bool    tss_distance = false;
+    FILE    *gff3_stream;
+    char    *upstream_boundaries = DEFAULT_UPSTREAM_BOUNDARIES,
+	    *gff3_filename,
+	    *gff3_stem,
+	    *index_stem,
+	    *index_boundaries,
+	    *cache_dir = NULL,
+	    *end,
+	    index_filename[PATH_MAX + 1];
+
+    if ( (argc == 2) && (strcmp(argv[1],"--version")) == 0 )
+    {
+	printf("%s %s\n", argv[0], VERSION);
+	return EX_OK;
+    }
+
+    /* Process flags */
+    for (c = 1; (c < argc) && (memcmp(argv[c],"--",2) == 0); ++c)
+    {
+	if ( (strcmp(argv[c], "--upstream-boundaries") == 0) && (c < argc - 1) )
+	{
+	    upstream_boundaries = argv[++c];
+	    if ( !upstream_boundaries_valid(upstream_boundaries) )
+	    {
+		fputs("peak-classifier-index: List should be comma-separated with no space.\n", stderr);
+		usage(argv);
+	    }
+	}
+	else if ( (strcmp(argv[c], "--cache-dir") == 0) && (c < argc - 1) )
+	    cache_dir = argv[++c];
+	else if ( strcmp(argv[c], "--tss-distance") == 0 )
+	    tss_distance = true;
+	else if ( (strcmp(argv[c], "--threads") == 0) && (c < argc - 1) )
+	{
+	    threads = strtoul(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (threads < 1) || (threads > 1024) )
+		usage(argv);
+	}
+	else
+	    usage(argv);
+    }
+    if ( c != argc - 1 )
+	usage(argv);
+
+    if ( !xt_valid_extension(argv[c], ".gff3") )
+	usage(argv);
+    if ( (gff3_stream = decompress_fopen(argv[c], threads)) == NULL )
+    {
+	fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[c],
+		strerror(errno));
+	return EX_NOINPUT;
+    }
+    gff3_filename = argv[c];
+    if ( (gff3_stem = strdup(gff3_filename)) == NULL )
+    {
+	fprintf(stderr, "%s: Cannot allocate GFF name.\n", argv[0]);
+	return EX_UNAVAILABLE;
+    }
+    *strstr(gff3_stem, ".gff3") = '\0';
+    if ( (cache_dir == NULL) &&
+	 ((cache_dir = getenv(FEATURE_INDEX_CACHE_ENV)) != NULL) &&
+	 (*cache_dir == '\0') )
+	cache_dir = NULL;
+
+    /*
+     *  The TSS index used by peak-classifier --tss-distance has no
+     *  stored upstream regions, so it serves any boundaries.
+     */
+    index_boundaries = tss_distance ? "" : upstream_boundaries;
+    if ( cache_dir != NULL )
+    {
+	free(gff3_stem);
+	if ( (status = feature_index_cache_stem(cache_dir, gff3_filename,
+			index_boundaries, &gff3_stem)) != EX_OK )
+	    return status;
+    }
+    if ( tss_distance )
+    {
+	index_stem = xt_malloc(strlen(gff3_stem) + sizeof(TSS_INDEX_SUFFIX), 1);
+	strcpy(index_stem, gff3_stem);
+	strcat(index_stem, TSS_INDEX_SUFFIX);
+    }
+    else
+	index_stem = gff3_stem;
+
+    /*
+     *  Always rebuild, in case the GFF or boundaries changed.  The new
+     *  files replace the old by rename(), so runs using the old index
+     *  are unaffected.
+     */
+    snprintf(index_filename, PATH_MAX, "%s" FEATURE_INDEX_EXT, index_stem);
+    lock_fd = feature_index_lock(index_filename);
+    status = feature_index_create(gff3_stream, gff3_filename, index_stem,
+				  index_boundaries, index_filename, NULL, NULL);
+    feature_index_unlock(index_filename, lock_fd);
+    if ( (status == EX_OK) && (cache_dir != NULL) )
+	printf("%s\n", index_filename);
+    return status;
+}
+
+
+void    usage(char *argv[])
+
+{
+    fprintf(stderr,
+	    "\nUsage: %s --version"
+	    "\n       %s [--upstream-boundaries pos[,pos ...]] [--threads N] "
+	    "[--cache-dir dir] [--tss-distance] features.gff3\n\n"
+	    "Writes features-augmented.bed and the binary feature index\n"
+	    "features" FEATURE_INDEX_EXT " used by peak-classifier.\n"
+	    "--tss-distance writes features-tss-augmented.bed and\n"
+	    "features-tss" FEATURE_INDEX_EXT " used by peak-classifier --tss-distance\n"
+	    "instead, with no upstream regions, for any boundaries.\n"
+	    "--cache-dir or " FEATURE_INDEX_CACHE_ENV " writes them to the\n"
+	    "peak-classifier cache in dir instead, and prints the index name.\n"
+	    "--threads N decompresses the GFF using up to N threads where the\n"
+	    "decompressor allows.\n\n",
+	    argv[0], argv[0]);
+    exit(EX_USAGE);
+}
@@ -13,44 +13,79 @@
 #include <string.h>
 #include <errno.h>
 #include <stdbool.h>
-#include <ctype.h>
 #include <limits.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <xtend/string.h>
 #include <xtend/file.h>
+#include <xtend/math.h>
+#include <xtend/mem.h>
 #include <biolibc/bed.h>
 #include <biolibc/gff3.h>
 #include <biolibc/pos-list.h>
+#include "feature-sort.h"
+#include "classify.h"
+#include "fast-write.h"
+#include "augment.h"
+#include "overlaps-bin.h"
+#include "stats.h"
+#include "feature-index.h"
+#include "rank.h"
+#include "partition.h"
+#include "peak-sort.h"
+#include "matrix.h"
+#include "batch.h"
+#include "decompress.h"
+#include "serve.h"
 #include "peak-classifier.h"
 
 int     main(int argc,char *argv[])
 
 {
     int     c,
-	    status;
-    double  min_peak_overlap = 1.0e-9,
-	    min_gff3_overlap = 1.0e-9;
+	    used,
+	    status,
+	    lock_fd = -1;
+    bool    summary_only = false,
+	    tss_distance = false,
+	    sort_input = false;
+    size_t  f;
+    unsigned long   threads = 0;    // 0 until --threads is given
     FILE    *peak_stream,
 	    *gff3_stream,
-	    *intersect_pipe;
+	    *overlaps_stream;
 	    // Default, override with --upstream-boundaries
-    char    *upstream_boundaries = "1000,10000,100000,200000,300000,400000,500000,600000,700000,800000",
-	    *p,
-	    cmd[PEAK_CMD_MAX + 1],
-	    *redirect_overwrite,
-	    *redirect_append,
+    char    *upstream_boundaries = DEFAULT_UPSTREAM_BOUNDARIES,
+	    *index_boundaries,
 	    *overlaps_filename,
-	    *min_overlap_flags = "",
+	    *peak_filename = NULL,
+	    *batch_filename = NULL,
+	    *socket_path = NULL,
+	    *matrix_filename = NULL,
+	    *gene_matrix_filename = NULL,
+	    *cache_dir = NULL,
 	    *end,
+	    *gff3_filename,
+	    *index_gff3_filename,
 	    *gff3_stem,
-	    augmented_filename[PATH_MAX + 1],
-	    sorted_filename[PATH_MAX + 1],
-	    *sort;
-    bool    midpoints_only = false;
-    bl_bed_t   bed_feature;
-    struct stat     file_info;
+	    *index_stem,
+	    index_filename[PATH_MAX + 1];
+    feature_set_t   feature_set = FEATURE_SET_INIT;
+    overlap_params_t    overlap_params = OVERLAP_PARAMS_INIT;
+    tss_regions_t   tss_regions;
+    batch_t         batch = BATCH_INIT;
+    peak_sort_params_t  sort_params = PEAK_SORT_PARAMS_INIT;
+    matrix_t        matrix;
+    rank_t          rank,
+		    *rankp = NULL;
+    stats_t         stats = STATS_INIT("peak-classifier");
+    stats_stage_t   *stage;
+    classify_counts_t   counts = CLASSIFY_COUNTS_INIT;
+    int64_t         bytes_in,
+		    bytes_out;
     
     if ( (argc == 2) && (strcmp(argv[1],"--version")) == 0 )
     {
@@ -67,39 +102,115 @@ int     main(int argc,char *argv[])
 	if ( strcmp(argv[c], "--upstream-boundaries") == 0 )
 	{
 	    upstream_boundaries = argv[++c];
-	    for (p = upstream_boundaries; *p != '\0'; ++p)
-		if ( !isdigit(*p) && (*p != ',') )
-		{
-		    fputs("peak-classifier: List should be comma-separated with no space.\n", stderr);
-		    usage(argv);
-		}
+	    if ( !upstream_boundaries_valid(upstream_boundaries) )
+	    {
+		fputs("peak-classifier: List should be comma-separated with no space.\n", stderr);
+		usage(argv);
+	    }
 	}
-	else if ( strcmp(argv[c], "--min-peak-overlap") == 0 )
+	else if ( (used = overlap_params_parse(&overlap_params, argc, argv,
+					       c)) != 0 )
 	{
-	    min_peak_overlap = strtod(argv[++c], &end);
-	    if ( *end != '\0' )
+	    if ( used < 0 )
 		usage(argv);
+	    c += used - 1;
 	}
-	else if ( strcmp(argv[c], "--min-gff-overlap") == 0 )
+	else if ( strcmp(argv[c], "--threads") == 0 )
 	{
-	    min_gff3_overlap = strtod(argv[++c], &end);
-	    if ( *end != '\0' )
+	    threads = strtoul(argv[++c], &end, 10);
+	    if ( (*end != '\0') || (threads < 1) || (threads > 1024) )
+		usage(argv);
+	}
+	else if ( (strcmp(argv[c], "--batch") == 0) && (c < argc - 1) )
+	    batch_filename = argv[++c];
+	else if ( (strcmp(argv[c], "--serve") == 0) && (c < argc - 1) )
+	    socket_path = argv[++c];
+	else if ( strcmp(argv[c], "--summary-only") == 0 )
+	    summary_only = true;
+	else if ( strcmp(argv[c], "--tss-distance") == 0 )
+	    tss_distance = true;
+	else if ( strcmp(argv[c], "--sort-input") == 0 )
+	    sort_input = true;
+	else if ( strcmp(argv[c], "--restore-order") == 0 )
+	    sort_input = sort_params.restore_order = true;
+	else if ( (strcmp(argv[c], "--mem") == 0) && (c < argc - 1) )
+	{
+	    if ( (sort_params.mem = peak_sort_parse_mem(argv[++c])) == 0 )
+		usage(argv);
+	}
+	else if ( (strcmp(argv[c], "--temp-dir") == 0) && (c < argc - 1) )
+	    sort_params.temp_dir = argv[++c];
+	else if ( (strcmp(argv[c], "--cache-dir") == 0) && (c < argc - 1) )
+	    cache_dir = argv[++c];
+	else if ( (strcmp(argv[c], "--matrix") == 0) && (c < argc - 1) )
+	    matrix_filename = argv[++c];
+	else if ( (strcmp(argv[c], "--gene-matrix") == 0) && (c < argc - 1) )
+	    gene_matrix_filename = argv[++c];
+	else if ( (used = stats_parse(&stats, argv[c])) != 0 )
+	{
+	    if ( used < 0 )
 		usage(argv);
 	}
-	else if ( strcmp(argv[c], "--min-either-overlap") == 0 )
-	    min_overlap_flags = "-e";
-	else if ( strcmp(argv[c], "--midpoints") == 0 )
-	    midpoints_only = true;
 	else
 	    usage(argv);
     }
 
-    if ( strcmp(argv[c], "-") == 0 )
+    /*
+     *  --batch and --serve take no peaks or overlaps arguments, and
+     *  --summary-only no overlaps argument.  --summary-only reports the
+     *  --rank counts, so it needs a --rank list.  --matrix takes the
+     *  GFF followed by any number of peak files.
+     */
+    if ( (batch_filename != NULL) + (socket_path != NULL) + summary_only +
+	 (matrix_filename != NULL) > 1 )
+	usage(argv);
+    if ( sort_input && ((batch_filename != NULL) || (socket_path != NULL) ||
+			(matrix_filename != NULL)) )
+	usage(argv);
+    if ( (gene_matrix_filename != NULL) && (matrix_filename == NULL) )
+	usage(argv);
+    if ( summary_only && (overlap_params.rank_features == NULL) )
+    {
+	fprintf(stderr, "%s: --summary-only requires --rank.\n", argv[0]);
+	usage(argv);
+    }
+    if ( matrix_filename != NULL ? argc - c < 2 :
+	 c != argc - ((batch_filename != NULL) || (socket_path != NULL) ? 1 :
+		      summary_only ? 2 : 3) )
+	usage(argv);
+    if ( threads == 0 )
+	threads = socket_path != NULL ? SERVE_DEFAULT_THREADS : 1;
+
+    /*
+     *  --tss-distance computes upstream regions from a TSS index with
+     *  no stored regions, so it has its own index and any boundaries
+     *  share it.  Set up before the batch jobs copy overlap_params.
+     */
+    if ( tss_distance )
+    {
+	tss_regions_init(&tss_regions, upstream_boundaries);
+	overlap_params.tss_regions = &tss_regions;
+	index_boundaries = "";
+    }
+    else
+	index_boundaries = upstream_boundaries;
+
+    if ( (socket_path != NULL) || (matrix_filename != NULL) )
+	peak_stream = NULL;
+    else if ( batch_filename != NULL )
+    {
+	if ( (status = batch_read_manifest(&batch, batch_filename,
+					   &overlap_params)) != EX_OK )
+	    exit(status);
+	peak_stream = NULL;
+    }
+    else if ( strcmp(argv[c], "-") == 0 )
 	peak_stream = stdin;
     else
     {
 	assert(xt_valid_extension(argv[c], ".bed"));
-	if ( (peak_stream = xt_fopen(argv[c], "r")) == NULL )
+	peak_filename = argv[c];
+	if ( (peak_stream = decompress_fopen(argv[c], threads)) == NULL )
 	{
 	    fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[c],
 		    strerror(errno));
@@ -107,347 +218,292 @@ int     main(int argc,char *argv[])
 	}
     }
     
-    if ( strcmp(argv[++c], "-") == 0 )
+    if ( (batch_filename == NULL) && (socket_path == NULL) &&
+	 (matrix_filename == NULL) )
+	++c;
+    if ( strcmp(argv[c], "-") == 0 )
     {
-	gff3_stream = stdin;
+	gff3_filename = NULL;
 	gff3_stem = "unknown-stdin-gff";
     }
     else
     {
 	assert(xt_valid_extension(argv[c], ".gff3"));
-	if ( (gff3_stream = xt_fopen(argv[c], "r")) == NULL )
+	gff3_filename = argv[c];
+	if ( (gff3_stem = strdup(gff3_filename)) == NULL )
 	{
-	    fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[c],
-		    strerror(errno));
-	    exit(EX_NOINPUT);
+	    fprintf(stderr, "%s: Cannot allocate GFF name.\n", argv[0]);
+	    exit(EX_UNAVAILABLE);
 	}
-	gff3_stem = argv[c];
     }
     
-    if ( strcmp(argv[++c], "-") == 0 )
-    {
+    if ( (batch_filename != NULL) || (socket_path != NULL) || summary_only ||
+	 (matrix_filename != NULL) )
+	overlaps_filename = NULL;
+    else if ( strcmp(argv[++c], "-") == 0 )
 	overlaps_filename = "";
-	redirect_overwrite = "";
-	redirect_append = "";
-    }
     else
     {
 	overlaps_filename = argv[c];
-	assert(xt_valid_extension(overlaps_filename, ".tsv"));
-	redirect_overwrite = " > ";
-	redirect_append = " >> ";
+	overlap_params.binary_output = xt_valid_extension(overlaps_filename,
+							  OVERLAPS_BIN_EXT);
+	assert(overlap_params.binary_output ||
+	       xt_valid_extension(overlaps_filename, ".tsv"));
     }
 
     // Already verified .gff3[.*z] extension above
     *strstr(gff3_stem, ".gff3") = '\0';
-    snprintf(augmented_filename, PATH_MAX, "%s-augmented.bed", gff3_stem);
-    if ( stat(augmented_filename, &file_info) == 0 )
-	fprintf(stderr, "Using existing %s...\n", augmented_filename);
-    else if ( gff3_augment(gff3_stream, upstream_boundaries, augmented_filename) != EX_OK )
+    if ( (cache_dir == NULL) &&
+	 ((cache_dir = getenv(FEATURE_INDEX_CACHE_ENV)) != NULL) &&
+	 (*cache_dir == '\0') )
+	cache_dir = NULL;
+    // The cache is keyed on the GFF content, so stdin is not cached
+    if ( (cache_dir != NULL) && (gff3_filename != NULL) )
     {
-	fprintf(stderr, "gff3_augment() failed.  Removing %s...\n",
-		augmented_filename);
-	unlink(augmented_filename);
-	exit(EX_DATAERR);
+	free(gff3_stem);
+	if ( (status = feature_index_cache_stem(cache_dir, gff3_filename,
+			index_boundaries, &gff3_stem)) != EX_OK )
+	    exit(status);
+	// The hash identifies the GFF, so copies with other mtimes match
+	index_gff3_filename = NULL;
     }
-    
-    snprintf(sorted_filename, PATH_MAX, "%s-augmented+sorted.bed", gff3_stem);
-    if ( stat(sorted_filename, &file_info) == 0 )
-	fprintf(stderr, "Using existing %s...\n", sorted_filename);
     else
+	index_gff3_filename = gff3_filename;
+    if ( tss_distance )
     {
-	// LC_ALL=C makes sort assume 1 byte/char, which improves speed
-	// gsort is faster than other implementations, so use it if
-	// available
-	if ( system("which gsort") == 0 )
-	    sort = "gsort";
+	index_stem = xt_malloc(strlen(gff3_stem) + sizeof(TSS_INDEX_SUFFIX), 1);
+	strcpy(index_stem, gff3_stem);
+	strcat(index_stem, TSS_INDEX_SUFFIX);
+    }
+    else
+	index_stem = gff3_stem;
+    snprintf(index_filename, PATH_MAX, "%s" FEATURE_INDEX_EXT, index_stem);
+    status = feature_index_check(index_filename, index_gff3_filename,
+				 index_boundaries);
+    if ( status == FEATURE_INDEX_CURRENT )
+    {
+	map_index(&feature_set, index_filename, &stats);
+	// Another job may have updated it for other boundaries since
+	if ( feature_index_boundaries_match(&feature_set, index_boundaries) )
+	    fprintf(stderr, "Using existing %s...\n", index_filename);
 	else
-	    sort = "sort";
-	snprintf(cmd, PEAK_CMD_MAX, "env LC_ALL=C grep -v '^#' %s | "
-		"%s -n -k 1 -k 2 -k 3 > %s\n",
-		augmented_filename, sort, sorted_filename);
-	fputs("Sorting...\n", stderr);
-	if ( (status = system(cmd)) != 0 )
 	{
-	    fprintf(stderr, "Sort failed.  Removing %s...\n", sorted_filename);
-	    unlink(sorted_filename);
-	    exit(EX_DATAERR);
+	    feature_set_free(&feature_set);
+	    status = FEATURE_INDEX_BOUNDARIES;
 	}
     }
-    
-    fputs("Finding intersects...\n", stderr);
-    snprintf(cmd, PEAK_CMD_MAX,
-	    "printf '#Chr\tP-start\tP-end\tF-start\tF-end\tF-name\tStrand\tOverlap\n'%s%s",
-	    redirect_overwrite, overlaps_filename);
-    if ( (status = system(cmd)) == 0 )
+    if ( status != FEATURE_INDEX_CURRENT )
     {
-	/*
-	 *  Peaks not overlapping anything else are labeled
-	 *  upstream-beyond.  The entire peak length must overlap the
-	 *  beyond region since none of it overlaps anything else.
-	 */
-	 
-	// Insert "set -x; " for debugging
-	snprintf(cmd, PEAK_CMD_MAX,
-		 "bedtools intersect -a - -b %s -f %g -F %g %s -wao"
-		 "| awk 'BEGIN { OFS=IFS; } { if ( $8 == -1 ) "
-		    "$9 = \"upstream-beyond\"; $12 = $3 - $2; "
-		    "printf(\"%%s\\t%%d\\t%%d\\t%%d\\t%%d\\t"
-		    "%%s\\t%%s\\t%%s\\n\", "
-		    "$1, $2, $3, $7, $8, $9, $11, $12); }' %s%s\n",
-		sorted_filename, min_peak_overlap, min_gff3_overlap,
-		min_overlap_flags, redirect_append, overlaps_filename);
-
-	if ( (intersect_pipe = popen(cmd, "w")) == NULL )
+	// Wait for any other process building it, which may finish it
+	lock_fd = feature_index_lock(index_filename);
+	status = feature_index_check(index_filename, index_gff3_filename,
+				     index_boundaries);
+	if ( status == FEATURE_INDEX_CURRENT )
+	    fprintf(stderr, "Using existing %s...\n", index_filename);
+	else if ( status == FEATURE_INDEX_BOUNDARIES )
 	{
-	    fprintf(stderr, "%s: Cannot pipe data to bedtools intersect.\n",
-		    argv[0]);
-	    return EX_CANTCREAT;
+	    fprintf(stderr, "Regenerating upstream regions in %s...\n",
+		    index_filename);
+	    if ( (status = feature_index_update(index_filename, index_stem,
+			    index_boundaries, sort_params.temp_dir,
+			    &stats)) != EX_OK )
+		exit(status);
 	}
-	while ( bl_bed_read(&bed_feature, peak_stream, BL_BED_FIELD_ALL) != EOF )
+	else
 	{
-	    if ( midpoints_only )
+	    if ( status == FEATURE_INDEX_STALE )
+		fprintf(stderr, "Rebuilding %s, which does not match %s...\n",
+			index_filename, gff3_filename == NULL ? "the GFF" :
+			gff3_filename);
+	    // Open only when needed, so cached runs start no decompressor
+	    if ( gff3_filename == NULL )
+		gff3_stream = stdin;
+	    else if ( (gff3_stream = decompress_fopen(gff3_filename,
+						      threads)) == NULL )
 	    {
-		// Replace peak start/end with midpoint coordinates
-		bl_bed_set_chrom_start(&bed_feature,
-		    (BL_BED_CHROM_START(&bed_feature) + BL_BED_CHROM_END(&bed_feature))
-		    / 2);
-		bl_bed_set_chrom_end(&bed_feature, BL_BED_CHROM_START(&bed_feature) + 1);
+		fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0],
+			gff3_filename, strerror(errno));
+		exit(EX_NOINPUT);
 	    }
-	    bl_bed_write(&bed_feature, intersect_pipe, BL_BED_FIELD_ALL);
+	    if ( (status = feature_index_create(gff3_stream, gff3_filename,
+			    index_stem, index_boundaries, index_filename,
+			    sort_params.temp_dir, &stats)) != EX_OK )
+		exit(status);
 	}
-	pclose(intersect_pipe);
+	// Map before unlocking, so no other job can replace it first
+	map_index(&feature_set, index_filename, &stats);
+	feature_index_unlock(index_filename, lock_fd);
     }
-    xt_fclose(peak_stream);
-    return status;
-}
-
-
-/***************************************************************************
- *  Description:
- *      Filter the GFF file and insert explicit intron and upstream
- *      (promoter) regions, returning a FILE pointer to a BED file
- *      containing all features of interest.
- *
- *  History: 
- *  Date        Name        Modification
- *  2021-04-15  Jason Bacon Begin
- ***************************************************************************/
-
-int     gff3_augment(FILE *gff3_stream, const char *upstream_boundaries,
-		    const char *augmented_filename)
-
-{
-    FILE        *bed_stream;
-    bl_bed_t    bed_feature = BL_BED_INIT;
-    bl_gff3_t    gff3_feature;
-    char        *feature,
-		strand;
-    bl_pos_list_t      pos_list = BL_POS_LIST_INIT;
+    if ( tss_distance &&
+	 ((status = feature_set_add_tss_names(&feature_set,
+					      &tss_regions)) != EX_OK) )
+	exit(status);
     
-    if ( (bed_stream = fopen(augmented_filename, "w")) == NULL )
+    if ( socket_path != NULL )
     {
-	fprintf(stderr, "peak-classifier: Cannot write temp GFF: %s\n",
-		strerror(errno));
-	return EX_CANTCREAT;
+	// Returns only if the server cannot start or fails
+	status = serve(&feature_set, &overlap_params, socket_path, threads);
+	feature_set_free(&feature_set);
+	if ( tss_distance )
+	    tss_regions_free(&tss_regions);
+	return status;
     }
-    fprintf(bed_stream, "#CHROM\tFirst\tLast+1\tStrand+Feature\n");
-    
-    bl_pos_list_from_csv(&pos_list, upstream_boundaries, MAX_UPSTREAM_BOUNDARIES);
-    // Upstream features are 1 to first pos, first + 1 to second, etc.
-    bl_pos_list_add_position(&pos_list, 0);
-    bl_pos_list_sort(&pos_list, BL_POS_LIST_ASCENDING);
 
-    // Write all of the first 4 fields to the feature file
-    // Done within bl_gff3_to_bed() now
-    //bl_bed_set_fields(&bed_feature, 6);
-    //bl_bed_set_score(&bed_feature, 0);
-    
-    fputs("Augmenting GFF3 data...\n", stderr);
-    bl_gff3_skip_header(gff3_stream);
-    bl_gff3_init(&gff3_feature);
-    while ( bl_gff3_read(&gff3_feature, gff3_stream, BL_GFF3_FIELD_ALL) == BL_READ_OK )
+    if ( batch_filename != NULL )
     {
-	// FIXME: Create a --autosomes-only flag to activate this check
-	if ( xt_strisint(BL_GFF3_SEQID(&gff3_feature), 10) )
+	stage = stats_begin(&stats, "classify");
+	status = batch_classify(&batch, &feature_set, threads);
+	bytes_in = bytes_out = 0;
+	for (f = 0; f < batch.count; ++f)
 	{
-	    feature = BL_GFF3_TYPE(&gff3_feature);
-	    // FIXME: Rely on parent IDs instead of ###?
-	    if ( strcmp(feature, "###") == 0 )
-		fputs("###\n", bed_stream);
-	    else if ( strstr(feature, "gene") != NULL )
-	    {
-		// Write out upstream regions for likely regulatory elements
-		strand = BL_GFF3_STRAND(&gff3_feature);
-		bl_gff3_to_bed(&gff3_feature, &bed_feature);
-		bl_bed_write(&bed_feature, bed_stream, BL_BED_FIELD_ALL);
-		
-		if ( strand == '+' )
-		    generate_upstream_features(bed_stream, &gff3_feature, &pos_list);
-		gff3_process_subfeatures(gff3_stream, bed_stream, &gff3_feature);
-		if ( strand == '-' )
-		    generate_upstream_features(bed_stream, &gff3_feature, &pos_list);
-		fputs("###\n", bed_stream);
-	    }
-	    else if ( strcmp(feature, "chromosome") != 0 )
+	    counts.peaks += batch.jobs[f].counts.peaks;
+	    counts.rows += batch.jobs[f].counts.rows;
+	    // Both exist after a successful run, so -1 is not expected
+	    bytes_in += XT_MAX(stats_path_bytes(batch.jobs[f].peak_filename), 0);
+	    bytes_out += XT_MAX(stats_path_bytes(batch.jobs[f].overlaps_filename),
+				0);
+	}
+	stats_end(stage, counts.peaks, counts.rows, bytes_in, bytes_out);
+	stats_print(&stats, stderr);
+	batch_free(&batch);
+	feature_set_free(&feature_set);
+	if ( tss_distance )
+	    tss_regions_free(&tss_regions);
+	return status;
+    }
+
+    if ( matrix_filename != NULL )
+    {
+	if ( overlap_params.rank_features != NULL )
+	{
+	    rank_init(&rank, overlap_params.rank_features, &feature_set);
+	    rankp = &rank;
+	}
+	stage = stats_begin(&stats, "classify");
+	status = matrix_open(&matrix, argv + c + 1, argc - c - 1, threads);
+	if ( (status == EX_OK) && (gene_matrix_filename != NULL) )
+	{
+	    // The GFF is read again for the gene IDs
+	    if ( gff3_filename == NULL )
 	    {
-		bl_gff3_to_bed(&gff3_feature, &bed_feature);
-		bl_bed_write(&bed_feature, bed_stream, BL_BED_FIELD_ALL);
-		fputs("###\n", bed_stream);
+		fprintf(stderr, "%s: --gene-matrix requires a GFF file.\n",
+			argv[0]);
+		status = EX_USAGE;
 	    }
+	    else
+		status = matrix_load_genes(&matrix, gff3_filename, threads);
 	}
+	if ( status == EX_OK )
+	    status = matrix_classify(&matrix, &feature_set, &overlap_params,
+				     rankp, &counts);
+	if ( status == EX_OK )
+	    status = matrix_write(&matrix, &feature_set, rankp,
+				  matrix_filename, gene_matrix_filename);
+	bytes_in = 0;
+	for (f = c + 1; f < (size_t)argc; ++f)
+	    bytes_in += XT_MAX(stats_path_bytes(argv[f]), 0);
+	stats_end(stage, counts.peaks,
+		  matrix.class_count + 1 + matrix.genes.count, bytes_in,
+		  stats_path_bytes(matrix_filename));
+	stats_print(&stats, stderr);
+	matrix_free(&matrix);
+	if ( rankp != NULL )
+	    rank_free(rankp);
+	feature_set_free(&feature_set);
+	if ( tss_distance )
+	    tss_regions_free(&tss_regions);
+	return status;
     }
-    xt_fclose(gff3_stream);
-    fclose(bed_stream);
-    return EX_OK;
-}
-
 
-/***************************************************************************
- *  Description:
- *      Process sub-features of a gene
- *
- *  History: 
- *  Date        Name        Modification
- *  2021-04-19  Jason Bacon Begin
- ***************************************************************************/
-
-void    gff3_process_subfeatures(FILE *gff3_stream, FILE *bed_stream,
-				bl_gff3_t *gene_feature)
-
-{
-    bl_gff3_t   subfeature;
-    bl_bed_t   bed_feature = BL_BED_INIT;
-    bool            first_exon = true,
-		    exon;
-    int64_t         intron_start = 0,   // Silence bogus warning from GCC
-		    intron_end;
-    char            *feature,
-		    strand,
-		    name[BL_BED_NAME_MAX_CHARS + 1];
-
-    bl_bed_set_fields(&bed_feature, 6);
-    strand = BL_GFF3_STRAND(gene_feature);
-    if ( bl_bed_set_strand(&bed_feature, strand) != BL_BED_DATA_OK )
+    if ( summary_only )
+	overlaps_stream = NULL;
+    else if ( *overlaps_filename == '\0' )
+	overlaps_stream = stdout;
+    else if ( (overlaps_stream = fopen(overlaps_filename, "w")) == NULL )
     {
-	fputs("gff3_process_subfeatures(): bl_bed_set_strand() failed..\n", stderr);
-	exit(EX_DATAERR);
+	fprintf(stderr, "%s: Cannot create %s: %s\n", argv[0],
+		overlaps_filename, strerror(errno));
+	exit(EX_CANTCREAT);
     }
+    if ( overlaps_stream != NULL )
+	setvbuf(overlaps_stream, NULL, _IOFBF, FAST_WRITE_BUFF_SIZE);
     
-    bl_gff3_init(&subfeature);
-    while ( (bl_gff3_read(&subfeature, gff3_stream, BL_GFF3_FIELD_ALL) == BL_READ_OK) &&
-	    (strcmp(BL_GFF3_TYPE(&subfeature), "###") != 0) )
+    if ( overlap_params.rank_features != NULL )
     {
-	feature = BL_GFF3_TYPE(&subfeature);
-	exon = (strcmp(feature, "exon") == 0);
-
-	// mRNA or lnc_RNA mark the start of a new set of exons
-	if ( (strstr(BL_GFF3_TYPE(&subfeature), "RNA") != NULL) ||
-	     (strstr(BL_GFF3_TYPE(&subfeature), "transcript") != NULL) ||
-	     (strstr(BL_GFF3_TYPE(&subfeature), "gene_segment") != NULL) ||
-	     (strstr(BL_GFF3_TYPE(&subfeature), "_overlapping_ncrna") != NULL) )
-	    first_exon = true;
-	
-	// Generate introns between exons
-	if ( exon )
-	{
-	    if ( !first_exon )
-	    {
-		intron_end = BL_GFF3_START(&subfeature) - 1;
-		bl_bed_set_chrom_cpy(&bed_feature, BL_GFF3_SEQID(&subfeature),
-				 BL_CHROM_MAX_CHARS + 1);
-		/*
-		 *  BED start is 0-based and inclusive
-		 *  GFF is 1-based and inclusive
-		 */
-		bl_bed_set_chrom_start(&bed_feature, intron_start);
-		/*
-		 *  BED end is 0-base and inclusive (or 1-based and non-inclusive)
-		 *  GFF is the same
-		 */
-		bl_bed_set_chrom_end(&bed_feature, intron_end);
-		snprintf(name, BL_BED_NAME_MAX_CHARS, "intron");
-		bl_bed_set_name_cpy(&bed_feature, name, BL_BED_NAME_MAX_CHARS + 1);
-		bl_bed_write(&bed_feature, bed_stream, BL_BED_FIELD_ALL);
-	    }
-	    
-	    intron_start = BL_GFF3_END(&subfeature);
-	    first_exon = false;
-	}
-	
-	bl_gff3_to_bed(&subfeature, &bed_feature);
-	bl_bed_write(&bed_feature, bed_stream, BL_BED_FIELD_ALL);
+	rank_init(&rank, overlap_params.rank_features, &feature_set);
+	rankp = &rank;
+    }
+    fputs("Finding intersects...\n", stderr);
+    stage = stats_begin(&stats, "classify");
+    /*
+     *  Partitioning holds all peaks in memory, which --summary-only
+     *  avoids.  --sort-input bounds memory use, and classifies while
+     *  merging sorted runs.
+     */
+    if ( sort_input )
+	status = classify_peaks_sorted(&feature_set, peak_stream,
+				       overlaps_stream, &overlap_params,
+				       rankp, &counts, &sort_params);
+    else if ( (threads > 1) && !summary_only )
+	status = classify_peaks_threaded(&feature_set, peak_stream,
+					 overlaps_stream, &overlap_params,
+					 rankp, &counts, threads,
+					 sort_params.mem, sort_params.temp_dir);
+    else
+	status = classify_peaks(&feature_set, peak_stream, overlaps_stream,
+				&overlap_params, rankp, &counts);
+    if ( overlaps_stream == NULL )
+	bytes_out = 0;
+    else
+    {
+	bytes_out = stats_stream_bytes(overlaps_stream);
+	if ( overlaps_stream != stdout )
+	    fclose(overlaps_stream);
     }
+    // Reap any decompressor so its CPU time counts toward this stage
+    xt_fclose(peak_stream);
+    stats_end(stage, counts.peaks, counts.rows,
+	      stats_path_bytes(peak_filename), bytes_out);
+    if ( rankp != NULL )
+    {
+	// Same summary as filter-overlaps, kept out of the way of output
+	if ( status == EX_OK )
+	    rank_summary(rankp, overlaps_stream == stdout ? stderr : stdout);
+	rank_free(rankp);
+    }
+    stats_print(&stats, stderr);
+    feature_set_free(&feature_set);
+    if ( tss_distance )
+	tss_regions_free(&tss_regions);
+    return status;
 }
 
 
 /***************************************************************************
  *  Description:
- *      Generate upstream region features from a GFF feature and a list
- *      of upstream distances
+ *      Map the feature index and report the map stage, exiting on
+ *      failure
  *
- *  History: 
+ *  History:
  *  Date        Name        Modification
- *  2021-04-17  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Begin
  ***************************************************************************/
 
-void    generate_upstream_features(FILE *feature_stream,
-				   bl_gff3_t *gff3_feature, bl_pos_list_t *pos_list)
+void    map_index(feature_set_t *fs, const char *index_filename,
+		  stats_t *stats)
 
 {
-    bl_bed_t   bed_feature[MAX_UPSTREAM_BOUNDARIES];
-    char            strand,
-		    name[BL_BED_NAME_MAX_CHARS + 1];
-    int             c;
-    
-    strand = BL_GFF3_STRAND(gff3_feature);
+    stats_stage_t   *stage;
+    int64_t         features;
+    size_t          c;
+    int             status;
 
-    for (c = 0; c < BL_POS_LIST_COUNT(pos_list) - 1; ++c)
-    {
-	bl_bed_set_fields(&bed_feature[c], 6);
-	bl_bed_set_strand(&bed_feature[c], strand);
-	bl_bed_set_chrom_cpy(&bed_feature[c], BL_GFF3_SEQID(gff3_feature),
-			     BL_CHROM_MAX_CHARS + 1);
-	/*
-	 *  BED start is 0-based and inclusive
-	 *  GFF is 1-based and inclusive
-	 *  BED end is 0-base and inclusive (or 1-based and non-inclusive)
-	 *  GFF is the same
-	 */
-	if ( strand == '+' )
-	{
-	    bl_bed_set_chrom_start(&bed_feature[c],
-			      BL_GFF3_START(gff3_feature) - 
-			      BL_POS_LIST_POSITIONS_AE(pos_list, c + 1) - 1);
-	    bl_bed_set_chrom_end(&bed_feature[c],
-			    BL_GFF3_START(gff3_feature) -
-			    BL_POS_LIST_POSITIONS_AE(pos_list, c) - 1);
-	}
-	else
-	{
-	    bl_bed_set_chrom_start(&bed_feature[c],
-			      BL_GFF3_END(gff3_feature) +
-			      BL_POS_LIST_POSITIONS_AE(pos_list, c));
-	    bl_bed_set_chrom_end(&bed_feature[c],
-			    BL_GFF3_END(gff3_feature) + 
-			    BL_POS_LIST_POSITIONS_AE(pos_list, c + 1));
-	}
-	
-	snprintf(name, BL_BED_NAME_MAX_CHARS, "upstream%" PRId64,
-		 BL_POS_LIST_POSITIONS_AE(pos_list, c + 1));
-	bl_bed_set_name_cpy(&bed_feature[c], name, BL_BED_NAME_MAX_CHARS + 1);
-    }
-    
-    if ( strand == '-' )
-    {
-	for (c = 0; c < BL_POS_LIST_COUNT(pos_list) - 1; ++c)
-	    bl_bed_write(&bed_feature[c], feature_stream, BL_BED_FIELD_ALL);
-    }
-    else
-    {
-	for (c = BL_POS_LIST_COUNT(pos_list) - 2; c >= 0; --c)
-	    bl_bed_write(&bed_feature[c], feature_stream, BL_BED_FIELD_ALL);
-    }
+    stage = stats_begin(stats, "map");
+    if ( (status = feature_index_map(fs, index_filename)) != EX_OK )
+	exit(status);
+    for (c = 0, features = 0; c < fs->count; ++c)
+	features += fs->chroms[c].count;
+    stats_end(stage, -1, features, fs->map_size, -1);
 }
 
 
@@ -458,15 +514,25 @@ void    usage(char *argv[])
 	    "\nUsage: %s --version"
 	    "\n       %s [--upstream-boundaries pos[,pos ...]] "
 	    "[--min-peak-overlap x.y] [--min-gff-overlap x.y] [--midpoints] "
-	    "peaks.bed features.gff3 overlaps.tsv\n\n", argv[0], argv[0]);
+	    "[--threads N] [--rank feature[,feature ...]] [--tss-distance] "
+	    "[--sort-input] [--restore-order] [--mem size[K|M|G]] "
+	    "[--temp-dir dir] [--cache-dir dir] "
+	    "[--stats[=json]] peaks.bed features.gff3 overlaps.{tsv|pco}"
+	    "\n       %s [options] --matrix counts.tsv [--gene-matrix genes.tsv] "
+	    "features.gff3 peaks.bed [peaks.bed ...]"
+	    "\n       %s [options] --rank feature[,feature ...] --summary-only "
+	    "peaks.bed features.gff3"
+	    "\n       %s [options] --batch manifest features.gff3"
+	    "\n       %s [options] --serve socket features.gff3\n\n",
+	    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
     fputs("Upstream boundaries are distances upstream from TSS, for which we want\n"
 	  "overlaps reported.  The default is 1000,10000,100000, which means features\n"
 	  "are generated for 1 to 1000, 1001 to 10000, and 10001 to 100000 bases\n"
 	  "upstream.  Peaks that do not overlap any of these or other features are\n"
 	  "reported as 'upstream-beyond.\n\n"
 	  "The minimum peak/gff overlap must range from 1.0e-9 (the default, which\n"
-	  "corresponds to a single base) to 1.0. These values are passed directlry to\n"
-	  "bedtools intersect -f/-F.\n"
+	  "corresponds to a single base) to 1.0. These values have the same meaning\n"
+	  "as bedtools intersect -f/-F.\n"
 	  "They must be used with great caution since the size of peaks and GFF\n"
 	  "features varies greatly.\n\n"
 	  "--min-either-overlap indicates that either the minimum peak or the minimum\n"
@@ -475,6 +541,53 @@ void    usage(char *argv[])
 	  "--midpoints indicates that we are only interested in which feature contains\n"
 	  "the midpoint of each peak.  This is the same as --min-peak-overlap 0.5\n"
 	  "in cases where half the peak is contained in a feature, but can also report\n"
-	  "overlaps with features too small to contain this much overlap.\n\n", stderr);
+	  "overlaps with features too small to contain this much overlap.\n\n"
+	  "If the overlaps file name ends in .pco, overlaps are written in a compact\n"
+	  "binary format, which filter-overlaps reads directly and overlaps-to-tsv\n"
+	  "converts to TSV.\n\n"
+	  "--tss-distance computes the upstream region of each peak from its\n"
+	  "distance to the nearest TSS of a gene it lies upstream of or overlaps,\n"
+	  "instead of storing upstream regions as features, and adds this distance\n"
+	  "as a TSS-distance column, -1 if no TSS is within the last boundary.\n"
+	  "Only the region of the nearest TSS is reported for each peak.\n\n"
+	  "--rank keeps only the highest ranked overlap for each peak, where rank\n"
+	  "is the position of the feature name in the list, as if the output were\n"
+	  "piped through filter-overlaps with the same features.\n\n"
+	  "--summary-only prints only the --rank summary of unique peaks and peaks\n"
+	  "per feature, without writing overlaps.  Peaks are streamed, so memory\n"
+	  "use does not grow with the number of peaks.  --threads then applies\n"
+	  "only to decompression.\n\n"
+	  "--sort-input accepts peaks in any order.  They are sorted using at most\n"
+	  "--mem bytes of memory, 256M by default, with sorted runs spilled to\n"
+	  "--temp-dir, $TMPDIR, or /tmp, and overlaps are written in sorted peak\n"
+	  "order.  --restore-order implies --sort-input and writes overlaps in the\n"
+	  "order of the input peaks instead.  --threads then applies only to\n"
+	  "decompression.  --temp-dir also holds the features of a GFF too large\n"
+	  "to sort in memory while building the feature index.\n\n"
+	  "--cache-dir keeps the feature index in dir, named by a hash of the GFF\n"
+	  "content and upstream boundaries, instead of next to the GFF.  Concurrent\n"
+	  "jobs share one index, built by the first while the others wait.\n"
+	  "PEAK_CLASSIFIER_CACHE_DIR in the environment does the same.\n\n"
+	  "--threads classifies up to N chromosomes at once.  Output is identical\n"
+	  "to a single-threaded run.  All peaks are held in memory, and overlaps\n"
+	  "waiting to be written in order beyond --mem are spilled to --temp-dir.\n"
+	  "Compressed inputs are also decompressed using up to N threads when\n"
+	  "pigz, bgzip, lbzip2, pbzip2, or xz is installed.\n\n"
+	  "--batch classifies every peak file in manifest against the same\n"
+	  "features.  Each line contains peaks.bed overlaps.tsv, optionally\n"
+	  "followed by overlap options for that line only.  With --threads, up to\n"
+	  "N peak files are classified at once.\n\n"
+	  "--matrix writes a count matrix of feature names by sample for any number\n"
+	  "of sorted peak files, classifying all of them in one merged pass.  Each\n"
+	  "count is the number of peaks of the sample overlapping that feature, or\n"
+	  "with --rank, having it as the highest ranked feature.  --gene-matrix\n"
+	  "also writes the number of peaks overlapping each gene, by gene ID.\n\n"
+	  "--serve answers queries of the form 'chrom start end' on the Unix\n"
+	  "domain socket, one per line, with the same columns as overlaps.tsv.\n"
+	  "A blank line ends a batch of queries.  Up to N clients are served at\n"
+	  "once, 8 by default.\n\n"
+	  "--stats reports wall and CPU time, records and bytes in and out,\n"
+	  "and peak memory for each stage on the standard error.  --stats=json\n"
+	  "reports the same as a JSON object.\n\n", stderr);
     exit(EX_USAGE);
 }
@@ -1,5 +1 @@
-
-#define MAX_UPSTREAM_BOUNDARIES 64
-#define PEAK_CMD_MAX            PATH_MAX * 2 + 256
-
 #include "protos.h"
@@ -0,0 +1,346 @@
+/***************************************************************************
+ *  Description:
+ *      Block-buffered peak input that parses only chrom, start, and end,
+ *      optionally in a separate reader thread.  See peak-reader.h.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <xtend/mem.h>
+#include <biolibc/bed.h>
+#include "peak-reader.h"
+
+/*
+ *  Parse a non-negative decimal position.  Return the first character
+ *  after it, to be checked by the caller, or NULL if there are no
+ *  digits or the value overflows.
+ */
+
+static char *parse_pos(char *p, int64_t *pos)
+
+{
+    int64_t value = 0;
+    char    *start = p;
+
+    while ( (*p >= '0') && (*p <= '9') )
+    {
+	if ( value > (INT64_MAX - 9) / 10 )
+	    return NULL;
+	value = value * 10 + (*p++ - '0');
+    }
+    if ( p == start )
+	return NULL;
+    *pos = value;
+    return p;
+}
+
+
+/*
+ *  Parse one line, terminated in place, into block->peaks.  Return
+ *  false if it is not a valid BED line.  Comment, track, browser, and
+ *  blank lines are skipped, as by bl_bed_read().
+ */
+
+static bool parse_line(peak_block_t *block, char *line)
+
+{
+    char        *p;
+    peak_line_t *peak;
+
+    if ( (*line == '\0') || (*line == '\r') || (*line == '#') ||
+	 (strncmp(line, "track", 5) == 0) ||
+	 (strncmp(line, "browser", 7) == 0) )
+	return true;
+
+    if ( block->count == block->array_size )
+    {
+	block->array_size = block->array_size == 0 ? 4096 :
+			    block->array_size * 2;
+	block->peaks = xt_realloc(block->peaks, block->array_size,
+				  sizeof(*block->peaks));
+    }
+    peak = &block->peaks[block->count];
+    if ( ((p = strchr(line, '\t')) == NULL) || (p == line) ||
+	 (p - line > BL_CHROM_MAX_CHARS) )
+	return false;
+    *p++ = '\0';
+    peak->chrom = line;
+    // Start must be followed by a tab, and end by a tab or end of line
+    if ( ((p = parse_pos(p, &peak->start)) == NULL) || (*p != '\t') )
+	return false;
+    if ( ((p = parse_pos(p + 1, &peak->end)) == NULL) ||
+	 ((*p != '\t') && (*p != '\r') && (*p != '\0')) )
+	return false;
+    if ( peak->end < peak->start )
+	return false;
+    ++block->count;
+    return true;
+}
+
+
+/*
+ *  Fill a block with the incomplete last line of the previous block and
+ *  as much new input as fits, and parse every complete line.  All but
+ *  the last block end at a newline.
+ */
+
+static void fill_block(peak_reader_t *reader, peak_block_t *block)
+
+{
+    size_t  carry,
+	    bytes;
+    char    *line,
+	    *eol,
+	    *end;
+
+    carry = reader->prev == NULL ? 0 : reader->prev->len - reader->prev->tail;
+    if ( carry >= block->buff_size )
+    {
+	block->buff_size = reader->prev->buff_size;
+	block->buff = xt_realloc(block->buff, block->buff_size + 1, 1);
+    }
+    if ( carry > 0 )
+	memmove(block->buff, reader->prev->buff + reader->prev->tail, carry);
+    block->len = carry;
+    block->count = 0;
+    block->status = EX_OK;
+    block->eof = false;
+
+    // Grow the buffer only for a line longer than it
+    for (;;)
+    {
+	bytes = fread(block->buff + block->len, 1,
+		      block->buff_size - block->len, reader->stream);
+	block->len += bytes;
+	if ( block->len < block->buff_size )
+	{
+	    if ( ferror(reader->stream) )
+	    {
+		fprintf(stderr, "peak-classifier: Error reading peaks: %s\n",
+			strerror(errno));
+		block->status = EX_IOERR;
+	    }
+	    block->eof = true;
+	    break;
+	}
+	for (end = block->buff + block->len; (end > block->buff) &&
+	     (end[-1] != '\n'); --end)
+	    ;
+	if ( end > block->buff )
+	    break;
+	block->buff_size *= 2;
+	block->buff = xt_realloc(block->buff, block->buff_size + 1, 1);
+    }
+
+    if ( block->eof )
+    {
+	// A last line without a newline is still a line
+	block->tail = block->len;
+	block->buff[block->len] = '\n';
+    }
+    else
+	block->tail = end - block->buff;
+
+    end = block->buff + block->tail;
+    for (line = block->buff; line < end; line = eol + 1)
+    {
+	eol = memchr(line, '\n', end - line + (block->eof ? 1 : 0));
+	*eol = '\0';
+	++reader->line;
+	if ( !parse_line(block, line) )
+	{
+	    fprintf(stderr, "peak-classifier: Invalid BED data at line %lu: "
+		    "expected chrom, start, and end >= start.\n",
+		    reader->line);
+	    block->status = EX_DATAERR;
+	    block->eof = true;
+	    break;
+	}
+    }
+    reader->prev = block;
+}
+
+
+/*
+ *  Reader thread: fill blocks in turn as the classifier frees them
+ */
+
+static void *peak_reader_thread(void *arg)
+
+{
+    peak_reader_t   *reader = arg;
+    peak_block_t    *block;
+    size_t          tail = 0;
+
+    for (;;)
+    {
+	pthread_mutex_lock(&reader->lock);
+	while ( (reader->filled == reader->block_count) && !reader->cancel )
+	    pthread_cond_wait(&reader->not_full, &reader->lock);
+	if ( reader->cancel )
+	{
+	    pthread_mutex_unlock(&reader->lock);
+	    break;
+	}
+	pthread_mutex_unlock(&reader->lock);
+
+	block = &reader->blocks[tail];
+	fill_block(reader, block);
+
+	pthread_mutex_lock(&reader->lock);
+	++reader->filled;
+	pthread_cond_signal(&reader->not_empty);
+	pthread_mutex_unlock(&reader->lock);
+	if ( block->eof )
+	    break;
+	tail = (tail + 1) % reader->block_count;
+    }
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Start reading peaks from stream.  With threaded, blocks are read
+ *      and parsed ahead by a separate thread.  Otherwise, or if the
+ *      thread cannot be created, each block is read when the previous
+ *      one has been used.  The stream is not closed by
+ *      peak_reader_close().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    peak_reader_open(peak_reader_t *reader, FILE *stream, bool threaded)
+
+{
+    size_t  c;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->stream = stream;
+    reader->status = EX_OK;
+    reader->block_count = threaded ? PEAK_READER_BLOCKS : 1;
+    for (c = 0; c < reader->block_count; ++c)
+    {
+	reader->blocks[c].buff_size = PEAK_READER_BUFF_SIZE;
+	// Room to terminate a last line without a newline
+	reader->blocks[c].buff = xt_malloc(PEAK_READER_BUFF_SIZE + 1, 1);
+    }
+    if ( threaded )
+    {
+	pthread_mutex_init(&reader->lock, NULL);
+	pthread_cond_init(&reader->not_empty, NULL);
+	pthread_cond_init(&reader->not_full, NULL);
+	if ( pthread_create(&reader->thread, NULL, peak_reader_thread,
+			    reader) == 0 )
+	    reader->threaded = true;
+	else
+	{
+	    pthread_mutex_destroy(&reader->lock);
+	    pthread_cond_destroy(&reader->not_empty);
+	    pthread_cond_destroy(&reader->not_full);
+	    for (c = 1; c < reader->block_count; ++c)
+		free(reader->blocks[c].buff);
+	    reader->block_count = 1;
+	}
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the next peak, or NULL at the end of input or after an
+ *      error, which is returned by peak_reader_close().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+const peak_line_t *peak_reader_next(peak_reader_t *reader)
+
+{
+    while ( (reader->current == NULL) ||
+	    (reader->next == reader->current->count) )
+    {
+	if ( reader->current != NULL )
+	{
+	    if ( reader->current->eof )
+	    {
+		reader->status = reader->current->status;
+		return NULL;
+	    }
+	    if ( reader->threaded )
+	    {
+		// Hand the used block back to the reader thread
+		pthread_mutex_lock(&reader->lock);
+		reader->head = (reader->head + 1) % reader->block_count;
+		--reader->filled;
+		pthread_cond_signal(&reader->not_full);
+		pthread_mutex_unlock(&reader->lock);
+	    }
+	}
+
+	if ( reader->threaded )
+	{
+	    pthread_mutex_lock(&reader->lock);
+	    while ( reader->filled == 0 )
+		pthread_cond_wait(&reader->not_empty, &reader->lock);
+	    reader->current = &reader->blocks[reader->head];
+	    pthread_mutex_unlock(&reader->lock);
+	}
+	else
+	{
+	    fill_block(reader, &reader->blocks[0]);
+	    reader->current = &reader->blocks[0];
+	}
+	reader->next = 0;
+    }
+    return &reader->current->peaks[reader->next++];
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Stop reading and free the buffers.  Return EX_OK, or the error
+ *      that ended input early.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     peak_reader_close(peak_reader_t *reader)
+
+{
+    size_t  c;
+
+    if ( reader->threaded )
+    {
+	pthread_mutex_lock(&reader->lock);
+	reader->cancel = true;
+	pthread_cond_signal(&reader->not_full);
+	pthread_mutex_unlock(&reader->lock);
+	pthread_join(reader->thread, NULL);
+	pthread_mutex_destroy(&reader->lock);
+	pthread_cond_destroy(&reader->not_empty);
+	pthread_cond_destroy(&reader->not_full);
+    }
+    for (c = 0; c < reader->block_count; ++c)
+    {
+	free(reader->blocks[c].buff);
+	free(reader->blocks[c].peaks);
+    }
+    return reader->status;
+}
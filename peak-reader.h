@@ -0,0 +1,66 @@
+#ifndef _PEAK_READER_H_
+#define _PEAK_READER_H_
+
+/*
+ *  Peak input for classification, which uses only the chrom, start,
+ *  and end of each peak.  The BED stream is read in large blocks and
+ *  only those fields are parsed, in place, so the chrom of a peak
+ *  points into the block instead of being copied, and the name, score,
+ *  and other columns of narrowPeak and similar files are skipped
+ *  without being converted.  With a reader thread, the next blocks are
+ *  read and parsed while the current one is classified, which keeps a
+ *  decompressor and the parser running ahead of the sweep.
+ *
+ *  A peak returned by peak_reader_next() is valid until the next call.
+ */
+
+#define PEAK_READER_BUFF_SIZE   (1024 * 1024)
+// Blocks being filled, waiting, and classified
+#define PEAK_READER_BLOCKS      4
+
+typedef struct
+{
+    const char      *chrom;
+    int64_t         start;
+    int64_t         end;
+}   peak_line_t;
+
+typedef struct
+{
+    char            *buff;
+    size_t          buff_size;
+    size_t          len;            // Bytes read into buff
+    size_t          tail;           // Start of an incomplete last line
+    peak_line_t     *peaks;
+    size_t          count;
+    size_t          array_size;
+    bool            eof;            // Last block, at EOF or an error
+    int             status;         // EX_OK unless an error ended input
+}   peak_block_t;
+
+typedef struct
+{
+    FILE            *stream;
+    peak_block_t    blocks[PEAK_READER_BLOCKS];
+    size_t          block_count;    // 1 without a reader thread
+    peak_block_t    *prev;          // Last block filled, for the tail
+    unsigned long   line;           // Lines read, for error messages
+    peak_block_t    *current;       // Block being classified
+    size_t          next;           // Next peak in current
+    int             status;
+    bool            threaded;
+    pthread_t       thread;
+    pthread_mutex_t lock;           // Protects the fields below
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+    size_t          head;           // Oldest filled block
+    size_t          filled;
+    bool            cancel;
+}   peak_reader_t;
+
+/* peak-reader.c */
+void    peak_reader_open(peak_reader_t *reader, FILE *stream, bool threaded);
+const peak_line_t *peak_reader_next(peak_reader_t *reader);
+int     peak_reader_close(peak_reader_t *reader);
+
+#endif  // _PEAK_READER_H_
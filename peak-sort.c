@@ -0,0 +1,843 @@
+/***************************************************************************
+ *  Description:
+ *      Classify peaks that are not sorted by chromosome and position,
+ *      with --sort-input.  Peaks are sorted in bounded memory, spilling
+ *      sorted runs to temporary files, and the k-way merge of the runs
+ *      feeds classification directly, so no sorted copy of the input is
+ *      ever written out.
+ *
+ *      With --restore-order, the overlaps of each peak are spooled to a
+ *      temporary file as they are found and read back in the order of
+ *      the input peaks, by sorting a small (order, rows) index.  The
+ *      spooled overlap_t records point to chromosome and feature names
+ *      that stay in memory for the whole run, so only the numbers need
+ *      to be stored.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <xtend/mem.h>
+#include <xtend/math.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "overlaps-bin.h"
+#include "peak-reader.h"
+#include "rank.h"
+#include "peak-sort.h"
+
+/*
+ *  Index of the spooled overlaps of one input peak for --restore-order
+ */
+
+typedef struct
+{
+    uint64_t        order;
+    uint64_t        first_row;
+    uint64_t        rows;
+}   order_rec_t;
+
+/*
+ *  qsort() has no context argument, so runs are sorted one at a time
+ *  with the comparison stashed here.  Only one rec_sort_t may sort at a
+ *  time, so it is used only by the main thread of peak-classifier.
+ */
+static rec_cmp_t    Qsort_cmp;
+static void         *Qsort_context;
+
+static int  rec_qsort_cmp(const void *p1, const void *p2)
+
+{
+    return Qsort_cmp(Qsort_context, p1, p2);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Create an unlinked temporary file in temp_dir, so that it cannot
+ *      be left behind.  Also used for the output spills of
+ *      classify_partitions().
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Make public for partition.c
+ ***************************************************************************/
+
+FILE    *temp_file_create(const char *temp_dir)
+
+{
+    char    filename[PATH_MAX + 1];
+    int     fd;
+    FILE    *stream;
+
+    snprintf(filename, PATH_MAX, "%s/peak-classifier-peaks.XXXXXX", temp_dir);
+    if ( ((fd = mkstemp(filename)) == -1) ||
+	 ((stream = fdopen(fd, "w+")) == NULL) )
+    {
+	fprintf(stderr, "peak-classifier: Cannot create temporary file %s: %s\n",
+		filename, strerror(errno));
+	return NULL;
+    }
+    unlink(filename);
+    return stream;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Initialize a sorter for records of rec_size bytes, using about
+ *      mem bytes of memory.  Spill files go in temp_dir, or $TMPDIR or
+ *      /tmp if temp_dir is NULL.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    rec_sort_init(rec_sort_t *sorter, size_t rec_size, size_t mem,
+		      rec_cmp_t cmp, void *context, const char *temp_dir)
+
+{
+    memset(sorter, 0, sizeof(*sorter));
+    sorter->rec_size = rec_size;
+    sorter->max_recs = XT_MAX(mem / rec_size, REC_SORT_MIN_BUF);
+    sorter->cmp = cmp;
+    sorter->context = context;
+    if ( (temp_dir == NULL) && ((temp_dir = getenv("TMPDIR")) == NULL) )
+	temp_dir = "/tmp";
+    sorter->temp_dir = temp_dir;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Free all memory and spill files used by a sorter
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    rec_sort_free(rec_sort_t *sorter)
+
+{
+    size_t  c;
+
+    for (c = 0; c < sorter->spill_count; ++c)
+	fclose(sorter->spills[c]);
+    free(sorter->recs);
+    free(sorter->spills);
+    free(sorter->sources);
+    free(sorter->heap);
+    memset(sorter, 0, sizeof(*sorter));
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Sort the buffer, write it to a new spill file, and empty it
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static int  rec_sort_spill(rec_sort_t *sorter)
+
+{
+    FILE    *spill_stream;
+
+    Qsort_cmp = sorter->cmp;
+    Qsort_context = sorter->context;
+    qsort(sorter->recs, sorter->count, sorter->rec_size, rec_qsort_cmp);
+
+    if ( (spill_stream = temp_file_create(sorter->temp_dir)) == NULL )
+	return EX_CANTCREAT;
+    if ( (fwrite(sorter->recs, sorter->rec_size, sorter->count,
+		 spill_stream) != sorter->count) ||
+	 (fflush(spill_stream) != 0) )
+    {
+	fprintf(stderr, "peak-classifier: Error writing spill file in %s.\n",
+		sorter->temp_dir);
+	fclose(spill_stream);
+	return EX_IOERR;
+    }
+    rewind(spill_stream);
+
+    if ( sorter->spill_count == sorter->spill_array_size )
+    {
+	sorter->spill_array_size = sorter->spill_array_size == 0 ? 16 :
+				   sorter->spill_array_size * 2;
+	sorter->spills = xt_realloc(sorter->spills, sorter->spill_array_size,
+				    sizeof(*sorter->spills));
+    }
+    sorter->spills[sorter->spill_count++] = spill_stream;
+    sorter->count = 0;
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Add one record, spilling the buffer first if it is full
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     rec_sort_add(rec_sort_t *sorter, const void *rec)
+
+{
+    int     status;
+
+    if ( sorter->count == sorter->max_recs )
+    {
+	if ( (status = rec_sort_spill(sorter)) != EX_OK )
+	    return status;
+    }
+    else if ( sorter->count == sorter->array_size )
+    {
+	sorter->array_size = sorter->array_size == 0 ?
+			     XT_MIN(65536, sorter->max_recs) :
+			     XT_MIN(sorter->array_size * 2, sorter->max_recs);
+	sorter->recs = xt_realloc(sorter->recs, sorter->array_size,
+				  sorter->rec_size);
+    }
+    memcpy(sorter->recs + sorter->count * sorter->rec_size, rec,
+	   sorter->rec_size);
+    ++sorter->count;
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Refill a spill file source.  Return false when it is exhausted.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static bool source_refill(rec_sort_t *sorter, rec_source_t *source)
+
+{
+    size_t  count;
+
+    if ( source->stream == NULL )
+	return false;
+    count = fread(source->buf, sorter->rec_size, source->buf_recs,
+		  source->stream);
+    source->next = source->buf;
+    source->end = source->buf + count * sorter->rec_size;
+    return count > 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Maintain the min-heap property for the k-way merge, moving
+ *      heap[top] down to its place.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void heap_sift_down(rec_sort_t *sorter, size_t top)
+
+{
+    rec_source_t    **heap = sorter->heap,
+		    *temp;
+    size_t          child,
+		    count = sorter->heap_count;
+
+    while ( (child = top * 2 + 1) < count )
+    {
+	if ( (child + 1 < count) &&
+	     (sorter->cmp(sorter->context, heap[child + 1]->next,
+			  heap[child]->next) < 0) )
+	    ++child;
+	if ( sorter->cmp(sorter->context, heap[top]->next,
+			 heap[child]->next) <= 0 )
+	    break;
+	temp = heap[top];
+	heap[top] = heap[child];
+	heap[child] = temp;
+	top = child;
+    }
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Finish adding records and prepare to read them back in order.
+ *      If nothing was spilled, the buffer is simply sorted in place.
+ *      Otherwise the remainder is spilled too and the buffer is divided
+ *      among the spill files for reading them back.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     rec_sort_finish(rec_sort_t *sorter)
+
+{
+    size_t  c,
+	    buf_recs,
+	    source_count;
+    int     status;
+
+    if ( sorter->spill_count == 0 )
+    {
+	Qsort_cmp = sorter->cmp;
+	Qsort_context = sorter->context;
+	qsort(sorter->recs, sorter->count, sorter->rec_size, rec_qsort_cmp);
+	source_count = 1;
+	sorter->sources = xt_malloc(1, sizeof(*sorter->sources));
+	sorter->sources[0].buf = sorter->sources[0].next = sorter->recs;
+	sorter->sources[0].end = sorter->recs +
+				 sorter->count * sorter->rec_size;
+	sorter->sources[0].buf_recs = sorter->count;
+	sorter->sources[0].stream = NULL;
+    }
+    else
+    {
+	if ( (sorter->count > 0) &&
+	     ((status = rec_sort_spill(sorter)) != EX_OK) )
+	    return status;
+	source_count = sorter->spill_count;
+	buf_recs = XT_MAX(sorter->max_recs / source_count, REC_SORT_MIN_BUF);
+	if ( source_count * buf_recs > sorter->array_size )
+	{
+	    sorter->array_size = source_count * buf_recs;
+	    sorter->recs = xt_realloc(sorter->recs, sorter->array_size,
+				      sorter->rec_size);
+	}
+	sorter->sources = xt_malloc(source_count, sizeof(*sorter->sources));
+	for (c = 0; c < source_count; ++c)
+	{
+	    sorter->sources[c].buf = sorter->recs +
+				     c * buf_recs * sorter->rec_size;
+	    sorter->sources[c].next = sorter->sources[c].end =
+				      sorter->sources[c].buf;
+	    sorter->sources[c].buf_recs = buf_recs;
+	    sorter->sources[c].stream = sorter->spills[c];
+	}
+    }
+
+    sorter->heap = xt_malloc(source_count, sizeof(*sorter->heap));
+    for (c = sorter->heap_count = 0; c < source_count; ++c)
+	if ( (sorter->sources[c].next < sorter->sources[c].end) ||
+	     source_refill(sorter, &sorter->sources[c]) )
+	    sorter->heap[sorter->heap_count++] = &sorter->sources[c];
+    for (c = sorter->heap_count / 2; c-- > 0; )
+	heap_sift_down(sorter, c);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Copy the next record in sorted order to rec.  Return EX_OK, or
+ *      EOF when all records have been read.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     rec_sort_read(rec_sort_t *sorter, void *rec)
+
+{
+    rec_source_t    *top;
+
+    if ( sorter->heap_count == 0 )
+	return EOF;
+    top = sorter->heap[0];
+    memcpy(rec, top->next, sorter->rec_size);
+    top->next += sorter->rec_size;
+    if ( (top->next == top->end) && !source_refill(sorter, top) )
+	sorter->heap[0] = sorter->heap[--sorter->heap_count];
+    heap_sift_down(sorter, 0);
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Parse a --mem size: a number of bytes with an optional K, M, or
+ *      G suffix.  Return 0 if str is not valid.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+size_t  peak_sort_parse_mem(const char *str)
+
+{
+    unsigned long long  mem;
+    char                *end;
+
+    mem = strtoull(str, &end, 10);
+    if ( end == str )
+	return 0;
+    switch(*end)
+    {
+	case 'K':
+	case 'k':
+	    mem <<= 10;
+	    ++end;
+	    break;
+	case 'M':
+	case 'm':
+	    mem <<= 20;
+	    ++end;
+	    break;
+	case 'G':
+	case 'g':
+	    mem <<= 30;
+	    ++end;
+	    break;
+    }
+    return *end == '\0' ? mem : 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the number of a chromosome name, adding it if necessary.
+ *      Peak files have few chromosomes and are usually grouped by them
+ *      even when unsorted, so the last one is checked first.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static uint32_t peak_sort_chrom(peak_sort_t *ps, const char *chrom)
+
+{
+    size_t  c;
+
+    if ( (ps->chrom_count > 0) &&
+	 (strcmp(ps->chroms[ps->chrom_count - 1], chrom) == 0) )
+	return ps->chrom_count - 1;
+    for (c = 0; c < ps->chrom_count; ++c)
+	if ( strcmp(ps->chroms[c], chrom) == 0 )
+	    return c;
+    if ( ps->chrom_count == ps->chrom_array_size )
+    {
+	ps->chrom_array_size = ps->chrom_array_size == 0 ? 64 :
+			       ps->chrom_array_size * 2;
+	ps->chroms = xt_realloc(ps->chroms, ps->chrom_array_size,
+				sizeof(*ps->chroms));
+	ps->chrom_nums = xt_realloc(ps->chrom_nums, ps->chrom_array_size,
+				    sizeof(*ps->chrom_nums));
+    }
+    ps->chroms[c] = strdup(chrom);
+    // Same as sort -n: leading digits, 0 if none
+    ps->chrom_nums[c] = strtol(chrom, NULL, 10);
+    return ps->chrom_count++;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Order peaks the same as feature-sort.c orders features, and
+ *      identical peaks by input position.  With --midpoints, peaks are
+ *      classified by their midpoints, which is the order that the sweep
+ *      in classify_peak() needs.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static int  peak_cmp(void *context, const void *p1, const void *p2)
+
+{
+    peak_sort_t         *ps = context;
+    const peak_rec_t    *r1 = p1,
+			*r2 = p2;
+    int64_t             s1,
+			s2;
+
+    if ( r1->chrom != r2->chrom )
+    {
+	if ( ps->chrom_nums[r1->chrom] != ps->chrom_nums[r2->chrom] )
+	    return ps->chrom_nums[r1->chrom] < ps->chrom_nums[r2->chrom] ?
+		   -1 : 1;
+	return strcmp(ps->chroms[r1->chrom], ps->chroms[r2->chrom]);
+    }
+    if ( ps->midpoints )
+    {
+	s1 = (r1->start + r1->end) / 2;
+	s2 = (r2->start + r2->end) / 2;
+	if ( s1 != s2 )
+	    return s1 < s2 ? -1 : 1;
+    }
+    else
+    {
+	if ( r1->start != r2->start )
+	    return r1->start < r2->start ? -1 : 1;
+	if ( r1->end != r2->end )
+	    return r1->end < r2->end ? -1 : 1;
+    }
+    return r1->order < r2->order ? -1 : r1->order > r2->order;
+}
+
+
+static int  order_cmp(void *context, const void *p1, const void *p2)
+
+{
+    const order_rec_t   *r1 = p1,
+			*r2 = p2;
+
+    // Input order needs no chrom table
+    (void)context;
+    return r1->order < r2->order ? -1 : r1->order > r2->order;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Read all peaks from a BED stream into the sorter.  Return the
+ *      number of peaks in *peak_count.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Read peaks with peak_reader_t
+ ***************************************************************************/
+
+static int  peak_sort_read_bed(peak_sort_t *ps, FILE *peak_stream,
+			       uint64_t *peak_count)
+
+{
+    peak_reader_t       reader;
+    const peak_line_t   *peak;
+    peak_rec_t  rec;
+    int         status;
+
+    memset(&rec, 0, sizeof(rec));
+    peak_reader_open(&reader, peak_stream, true);
+    for (rec.order = 0; (peak = peak_reader_next(&reader)) != NULL;
+	 ++rec.order)
+    {
+	rec.start = peak->start;
+	rec.end = peak->end;
+	rec.chrom = peak_sort_chrom(ps, peak->chrom);
+	if ( (status = rec_sort_add(&ps->peaks, &rec)) != EX_OK )
+	{
+	    peak_reader_close(&reader);
+	    return status;
+	}
+    }
+    *peak_count = rec.order;
+    if ( (status = peak_reader_close(&reader)) != EX_OK )
+	return status;
+    return rec_sort_finish(&ps->peaks);
+}
+
+
+static void peak_sort_free(peak_sort_t *ps)
+
+{
+    size_t  c;
+
+    rec_sort_free(&ps->peaks);
+    for (c = 0; c < ps->chrom_count; ++c)
+	free(ps->chroms[c]);
+    free(ps->chroms);
+    free(ps->chrom_nums);
+}
+
+
+/*
+ *  Overlap output shared by both modes, set up as in classify_peaks()
+ */
+
+typedef struct
+{
+    FILE                    *stream;
+    overlap_params_t        *params;
+    rank_t                  *rank;
+    overlaps_bin_writer_t   writer;
+    unsigned long           rows;
+}   sorted_out_t;
+
+static int  sorted_out_open(sorted_out_t *out, feature_set_t *fs,
+			    FILE *overlaps_stream, overlap_params_t *params,
+			    rank_t *rank)
+
+{
+    int     status;
+
+    out->stream = overlaps_stream;
+    out->params = params;
+    out->rank = rank;
+    out->rows = 0;
+    if ( (overlaps_stream != NULL) && params->binary_output )
+    {
+	if ( (status = overlaps_bin_open(&out->writer, overlaps_stream,
+		    fs->names, fs->name_count,
+		    overlaps_bin_flags(params, rank != NULL))) != EX_OK )
+	    return status;
+	overlaps_bin_write_header(&out->writer);
+	if ( rank != NULL )
+	{
+	    rank->emit = overlaps_bin_emit;
+	    rank->emit_arg = &out->writer;
+	}
+    }
+    // Ranked output matches filter-overlaps, which drops the header
+    else if ( (overlaps_stream != NULL) && (rank == NULL) )
+	fputs(params->tss_regions != NULL ? OVERLAPS_TSS_HEADER :
+	      OVERLAPS_HEADER, overlaps_stream);
+    return EX_OK;
+}
+
+
+static int  sorted_out_close(sorted_out_t *out)
+
+{
+    if ( out->rank != NULL )
+    {
+	rank_finish(out->rank, out->stream);
+	out->rank->emit = NULL;
+    }
+    if ( (out->stream != NULL) && out->params->binary_output )
+	return overlaps_bin_close(&out->writer, true);
+    return EX_OK;
+}
+
+
+/*
+ *  Write one spooled overlap for --restore-order.  --rank is applied
+ *  here rather than during classification, so that peak groups are
+ *  formed in input order, as filter-overlaps would see them.
+ */
+
+static void sorted_out_emit(sorted_out_t *out, const overlap_t *overlap)
+
+{
+    if ( out->rank != NULL )
+	rank_add(out->rank, out->stream, overlap->chrom, overlap->peak_start,
+		 overlap->peak_end, overlap->feature_start,
+		 overlap->feature_end, overlap->feature_name,
+		 feature_name_rank(overlap->feature_name, out->rank->features),
+		 overlap->strand, overlap->overlap, overlap->tss_distance);
+    else if ( out->params->binary_output )
+	overlaps_bin_emit(&out->writer, overlap);
+    else
+	overlap_write(out->stream, overlap->chrom, overlap->peak_start,
+		      overlap->peak_end, overlap->feature_start,
+		      overlap->feature_end, overlap->feature_name,
+		      overlap->strand, overlap->overlap, overlap->tss_distance);
+    ++out->rows;
+}
+
+
+static void spool_emit(void *arg, const overlap_t *overlap)
+
+{
+    fwrite(overlap, sizeof(*overlap), 1, (FILE *)arg);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Write the spooled overlaps in input peak order
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static int  restore_order(rec_sort_t *orders, FILE *spool, sorted_out_t *out)
+
+{
+    order_rec_t orec;
+    overlap_t   overlap;
+    uint64_t    pos = 0,
+		r;
+    int         status;
+
+    if ( (status = rec_sort_finish(orders)) != EX_OK )
+	return status;
+    while ( rec_sort_read(orders, &orec) == EX_OK )
+    {
+	// Sequential when runs of input peaks were already sorted
+	if ( (orec.first_row != pos) &&
+	     (fseeko(spool, orec.first_row * sizeof(overlap), SEEK_SET) != 0) )
+	    return EX_IOERR;
+	for (r = 0; r < orec.rows; ++r)
+	{
+	    if ( fread(&overlap, sizeof(overlap), 1, spool) != 1 )
+		return EX_IOERR;
+	    sorted_out_emit(out, &overlap);
+	}
+	pos = orec.first_row + orec.rows;
+    }
+    return EX_OK;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Classify peaks from an unsorted BED stream, as classify_peaks()
+ *      would classify the same peaks sorted.  Overlaps are written in
+ *      sorted peak order, or in input order with --restore-order.
+ *      Memory use is bounded by sort_params->mem, regardless of the
+ *      number of peaks.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     classify_peaks_sorted(feature_set_t *fs, FILE *peak_stream,
+			      FILE *overlaps_stream, overlap_params_t *params,
+			      rank_t *rank, classify_counts_t *counts,
+			      peak_sort_params_t *sort_params)
+
+{
+    peak_sort_t ps;
+    peak_rec_t  prec;
+    order_rec_t orec;
+    rec_sort_t  orders;
+    sweep_t     sweep = SWEEP_INIT;
+    sorted_out_t    out;
+    FILE        *spool = NULL;
+    uint64_t    peak_count;
+    int64_t     peak_start,
+		peak_end;
+    bool        restore;
+    size_t      mem;
+    int         status;
+
+    /*
+     *  Restoring the order only matters if overlaps are written, and
+     *  then the memory is shared by the peak and order sorts, which are
+     *  both in use while classifying.
+     */
+    restore = sort_params->restore_order && (overlaps_stream != NULL);
+    mem = restore ? sort_params->mem / 2 : sort_params->mem;
+    memset(&ps, 0, sizeof(ps));
+    memset(&out, 0, sizeof(out));
+    ps.midpoints = params->midpoints_only;
+    rec_sort_init(&ps.peaks, sizeof(peak_rec_t), mem, peak_cmp, &ps,
+		  sort_params->temp_dir);
+    rec_sort_init(&orders, sizeof(order_rec_t), mem, order_cmp, NULL,
+		  sort_params->temp_dir);
+    if ( (status = peak_sort_read_bed(&ps, peak_stream,
+				      &peak_count)) != EX_OK )
+    {
+	peak_sort_free(&ps);
+	return status;
+    }
+
+    if ( restore )
+    {
+	if ( (spool = temp_file_create(ps.peaks.temp_dir)) == NULL )
+	{
+	    peak_sort_free(&ps);
+	    return EX_CANTCREAT;
+	}
+	sweep.emit = spool_emit;
+	sweep.emit_arg = spool;
+    }
+    else
+    {
+	if ( (status = sorted_out_open(&out, fs, overlaps_stream, params,
+				       rank)) != EX_OK )
+	{
+	    peak_sort_free(&ps);
+	    return status;
+	}
+	if ( (overlaps_stream != NULL) && params->binary_output &&
+	     (rank == NULL) )
+	{
+	    sweep.emit = overlaps_bin_emit;
+	    sweep.emit_arg = &out.writer;
+	}
+    }
+
+    while ( (status = rec_sort_read(&ps.peaks, &prec)) == EX_OK )
+    {
+	peak_start = prec.start;
+	peak_end = prec.end;
+	if ( params->midpoints_only )
+	{
+	    // Replace peak start/end with midpoint coordinates
+	    peak_start = (peak_start + peak_end) / 2;
+	    peak_end = peak_start + 1;
+	}
+	orec.first_row = sweep.rows;
+	classify_peak(fs, &sweep, ps.chroms[prec.chrom], peak_start, peak_end,
+		      params, restore ? NULL : rank, overlaps_stream);
+	if ( restore )
+	{
+	    orec.order = prec.order;
+	    orec.rows = sweep.rows - orec.first_row;
+	    if ( (status = rec_sort_add(&orders, &orec)) != EX_OK )
+		break;
+	}
+    }
+    status = status == EOF ? EX_OK : status;
+    // Free the peak buffers, but keep ps.chroms for the spooled overlaps
+    rec_sort_free(&ps.peaks);
+
+    if ( restore && (status == EX_OK) )
+    {
+	if ( (fflush(spool) != 0) || ferror(spool) )
+	{
+	    fprintf(stderr, "peak-classifier: Error writing temporary file in %s.\n",
+		    orders.temp_dir);
+	    status = EX_IOERR;
+	}
+	else if ( (status = sorted_out_open(&out, fs, overlaps_stream, params,
+					    rank)) == EX_OK )
+	{
+	    rewind(spool);
+	    if ( (status = restore_order(&orders, spool, &out)) != EX_OK )
+		fprintf(stderr, "peak-classifier: Error reading temporary file in %s.\n",
+			orders.temp_dir);
+	    if ( (sorted_out_close(&out) != EX_OK) && (status == EX_OK) )
+		status = EX_IOERR;
+	}
+    }
+    else if ( !restore && (sorted_out_close(&out) != EX_OK) &&
+	      (status == EX_OK) )
+	status = EX_IOERR;
+
+    if ( counts != NULL )
+    {
+	counts->peaks += peak_count;
+	counts->rows += rank != NULL ? rank_kept(rank) :
+			restore ? out.rows : sweep.rows;
+    }
+    if ( spool != NULL )
+	fclose(spool);
+    rec_sort_free(&orders);
+    sweep_free(&sweep);
+    peak_sort_free(&ps);
+    return status;
+}
@@ -0,0 +1,103 @@
+#ifndef _PEAK_SORT_H_
+#define _PEAK_SORT_H_
+
+/*
+ *  Memory used for sorting unsorted peaks with --sort-input, unless
+ *  overridden with --mem.  Peaks take 32 bytes each, so about 8
+ *  million peaks are sorted in memory before any are spilled.
+ */
+#define PEAK_SORT_DEFAULT_MEM   (256 * 1024 * 1024)
+
+// Fewer records per merge buffer would make spill reads too small
+#define REC_SORT_MIN_BUF        256
+
+/*
+ *  External sort of fixed-size records.  Records are added until
+ *  max_recs fill the buffer, which is then sorted and spilled to an
+ *  unlinked temporary file.  rec_sort_read() returns records in order,
+ *  merging the spill files with a heap, so the sorted output is never
+ *  stored as a whole.  The buffer is sorted with qsort() through a
+ *  file-static comparison, so only one thread may use rec_sort_t.
+ */
+
+typedef int (*rec_cmp_t)(void *context, const void *r1, const void *r2);
+
+typedef struct
+{
+    unsigned char   *next;
+    unsigned char   *end;
+    unsigned char   *buf;
+    size_t          buf_recs;
+    FILE            *stream;
+}   rec_source_t;
+
+typedef struct
+{
+    size_t          rec_size;
+    size_t          max_recs;       // In memory at once
+    unsigned char   *recs;
+    size_t          count;
+    size_t          array_size;
+    rec_cmp_t       cmp;
+    void            *context;
+    const char      *temp_dir;
+    FILE            **spills;
+    size_t          spill_count;
+    size_t          spill_array_size;
+    rec_source_t    *sources;       // Merge state for rec_sort_read()
+    rec_source_t    **heap;
+    size_t          heap_count;
+}   rec_sort_t;
+
+/*
+ *  One peak, with its position in the input so that the input order
+ *  can be restored and identical peaks keep it.  chrom is an index into
+ *  the chromosome table of the peak_sort_t.
+ */
+
+typedef struct
+{
+    int64_t         start;
+    int64_t         end;
+    uint64_t        order;
+    uint32_t        chrom;
+}   peak_rec_t;
+
+typedef struct
+{
+    rec_sort_t      peaks;
+    bool            midpoints;      // Sort by midpoint, as classified
+    char            **chroms;
+    long            *chrom_nums;    // Numeric value of each chrom name
+    size_t          chrom_count;
+    size_t          chrom_array_size;
+}   peak_sort_t;
+
+/*
+ *  Options for classify_peaks_sorted()
+ */
+
+typedef struct
+{
+    size_t          mem;            // --mem, bytes for sorting
+    const char      *temp_dir;      // --temp-dir, NULL for $TMPDIR or /tmp
+    bool            restore_order;  // --restore-order
+}   peak_sort_params_t;
+
+#define PEAK_SORT_PARAMS_INIT   { PEAK_SORT_DEFAULT_MEM, NULL, false }
+
+/* peak-sort.c */
+FILE    *temp_file_create(const char *temp_dir);
+void    rec_sort_init(rec_sort_t *sorter, size_t rec_size, size_t mem,
+		      rec_cmp_t cmp, void *context, const char *temp_dir);
+void    rec_sort_free(rec_sort_t *sorter);
+int     rec_sort_add(rec_sort_t *sorter, const void *rec);
+int     rec_sort_finish(rec_sort_t *sorter);
+int     rec_sort_read(rec_sort_t *sorter, void *rec);
+size_t  peak_sort_parse_mem(const char *str);
+int     classify_peaks_sorted(feature_set_t *fs, FILE *peak_stream,
+			      FILE *overlaps_stream, overlap_params_t *params,
+			      rank_t *rank, classify_counts_t *counts,
+			      peak_sort_params_t *sort_params);
+
+#endif  // _PEAK_SORT_H_
@@ -0,0 +1,270 @@
+/***************************************************************************
+ *  Description:
+ *      Keep only the best ranked overlap for each peak during
+ *      classification, producing the same output and summary counts as
+ *      running filter-overlaps on the full overlaps file.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xtend/mem.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "rank.h"
+
+/***************************************************************************
+ *  Description:
+ *      Split a comma-separated feature list into a NULL-terminated
+ *      array.  The array and strings are one allocation, so the result
+ *      is released with a single free().  Return NULL if the list is
+ *      empty, has an empty entry, or has more than RANK_MAX_FEATURES.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+char    **rank_list_parse(const char *list)
+
+{
+    size_t  count,
+	    c;
+    const char  *p;
+    char    **features,
+	    *copy;
+
+    for (count = 1, p = list; *p != '\0'; ++p)
+	if ( *p == ',' )
+	    ++count;
+    if ( count > RANK_MAX_FEATURES )
+	return NULL;
+
+    features = xt_malloc(1, (count + 1) * sizeof(*features) + strlen(list) + 1);
+    copy = (char *)(features + count + 1);
+    strcpy(copy, list);
+    for (c = 0; c < count; ++c)
+    {
+	features[c] = copy;
+	if ( (copy = strchr(copy, ',')) != NULL )
+	    *copy++ = '\0';
+	if ( *features[c] == '\0' )
+	{
+	    free(features);
+	    return NULL;
+	}
+    }
+    features[count] = NULL;
+    return features;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Initialize ranking for one output stream.  The rank of every
+ *      name in the feature set is looked up once here, so that
+ *      classification never compares name strings.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    rank_init(rank_t *rank, char **features, feature_set_t *fs)
+
+{
+    size_t  n;
+
+    memset(rank, 0, sizeof(*rank));
+    rank->features = features;
+    for (rank->feature_count = 0; features[rank->feature_count] != NULL;
+	 ++rank->feature_count)
+	;
+    rank->name_ranks = xt_malloc(fs->name_count + 1, sizeof(*rank->name_ranks));
+    for (n = 0; n < fs->name_count; ++n)
+	rank->name_ranks[n] = feature_name_rank(fs->names[n], features);
+    rank->beyond_rank = feature_name_rank(BEYOND_FEATURE_NAME, features);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Return the 1-based position of name in features, ignoring case,
+ *      or 0 if it is not listed.  Same as feature_rank() in
+ *      filter-overlaps.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+size_t  feature_name_rank(const char *name, char *features[])
+
+{
+    size_t  c;
+
+    for (c = 0; features[c] != NULL; ++c)
+	if ( strcasecmp(name, features[c]) == 0 )
+	    return c + 1;
+    return 0;
+}
+
+
+/*
+ *  Write the keeper for the current peak group, if there is one, or
+ *  pass it to the emit function.  With neither an emit function nor
+ *  a stream, as for --summary-only, the keeper is only counted.
+ */
+
+static void rank_flush(rank_t *rank, FILE *overlaps_stream)
+
+{
+    overlap_t   record;
+
+    if ( rank->in_group && (rank->keeper_rank != 0) )
+    {
+	if ( rank->emit != NULL )
+	{
+	    record.chrom = rank->chrom;
+	    record.peak_start = rank->peak_start;
+	    record.peak_end = rank->peak_end;
+	    record.feature_start = rank->feature_start;
+	    record.feature_end = rank->feature_end;
+	    record.feature_name = rank->feature_name;
+	    record.overlap = rank->overlap;
+	    record.strand = rank->strand;
+	    record.tss_distance = rank->tss_distance;
+	    rank->emit(rank->emit_arg, &record);
+	}
+	else if ( overlaps_stream != NULL )
+	    overlap_write(overlaps_stream, rank->chrom, rank->peak_start,
+			  rank->peak_end, rank->feature_start,
+			  rank->feature_end, rank->feature_name, rank->strand,
+			  rank->overlap, rank->tss_distance);
+	++rank->feature_overlaps[rank->keeper_rank - 1];
+    }
+    rank->keeper_rank = 0;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Accept one overlap row in output order.  A row for a different
+ *      peak than the last completes the previous group.  tss_distance
+ *      is the same for every row of a peak.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ *  2026-10-16  Jason Bacon Add tss_distance
+ ***************************************************************************/
+
+void    rank_add(rank_t *rank, FILE *overlaps_stream, const char *chrom,
+		 int64_t peak_start, int64_t peak_end,
+		 int64_t feature_start, int64_t feature_end,
+		 const char *feature_name, size_t name_rank, char strand,
+		 int64_t overlap, int64_t tss_distance)
+
+{
+    if ( !rank->in_group || (peak_start != rank->peak_start) ||
+	 (peak_end != rank->peak_end) || (strcmp(chrom, rank->chrom) != 0) )
+    {
+	rank_flush(rank, overlaps_stream);
+	rank->in_group = true;
+	strncpy(rank->chrom, chrom, BL_CHROM_MAX_CHARS);
+	rank->chrom[BL_CHROM_MAX_CHARS] = '\0';
+	rank->peak_start = peak_start;
+	rank->peak_end = peak_end;
+	rank->tss_distance = tss_distance;
+	++rank->unique_peaks;
+    }
+
+    // Ties go to the first overlap, as in filter-overlaps
+    if ( (name_rank != 0) &&
+	 ((rank->keeper_rank == 0) || (name_rank < rank->keeper_rank)) )
+    {
+	rank->keeper_rank = name_rank;
+	rank->feature_start = feature_start;
+	rank->feature_end = feature_end;
+	rank->feature_name = feature_name;
+	rank->strand = strand;
+	rank->overlap = overlap;
+    }
+}
+
+
+void    rank_finish(rank_t *rank, FILE *overlaps_stream)
+
+{
+    rank_flush(rank, overlaps_stream);
+    rank->in_group = false;
+}
+
+
+/*
+ *  Add the counts from src, e.g. one partition, into dest
+ */
+
+void    rank_merge(rank_t *dest, rank_t *src)
+
+{
+    size_t  c;
+
+    dest->unique_peaks += src->unique_peaks;
+    for (c = 0; c < dest->feature_count; ++c)
+	dest->feature_overlaps[c] += src->feature_overlaps[c];
+}
+
+
+/*
+ *  Number of overlap lines written so far
+ */
+
+unsigned long   rank_kept(rank_t *rank)
+
+{
+    unsigned long   kept = 0;
+    size_t          c;
+
+    for (c = 0; c < rank->feature_count; ++c)
+	kept += rank->feature_overlaps[c];
+    return kept;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Print the same summary as filter-overlaps
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    rank_summary(rank_t *rank, FILE *stream)
+
+{
+    size_t  c;
+
+    fprintf(stream, "Total unique peaks: %lu\n", rank->unique_peaks);
+    for (c = 0; c < rank->feature_count; ++c)
+	fprintf(stream, "Overlaps with %-20s: %7lu (%3.1f%%)\n",
+		rank->features[c], rank->feature_overlaps[c],
+		100.0 * rank->feature_overlaps[c] / rank->unique_peaks);
+}
+
+
+void    rank_free(rank_t *rank)
+
+{
+    free(rank->name_ranks);
+    rank->name_ranks = NULL;
+}
@@ -0,0 +1,57 @@
+#ifndef _RANK_H_
+#define _RANK_H_
+
+/*
+ *  Fused filter-overlaps: keep only the best ranked overlap for each
+ *  peak as it is classified.  Ranks follow feature_rank() in
+ *  filter-overlaps: the 1-based position of the feature name in the
+ *  list, compared case-insensitively, with 0 meaning not listed.
+ *  Consecutive overlaps of the same peak form one group, and the first
+ *  overlap with the lowest nonzero rank in the group is kept.
+ */
+
+#define RANK_MAX_FEATURES   64
+
+struct rank
+{
+    char            **features;     // NULL-terminated, from rank_list_parse()
+    size_t          feature_count;
+    size_t          *name_ranks;    // Rank of each feature set name
+    size_t          beyond_rank;
+
+    // Current peak group and its best overlap so far
+    bool            in_group;
+    char            chrom[BL_CHROM_MAX_CHARS + 1];
+    int64_t         peak_start;
+    int64_t         peak_end;
+    int64_t         tss_distance;
+    size_t          keeper_rank;    // 0 until a listed feature is seen
+    int64_t         feature_start;
+    int64_t         feature_end;
+    const char      *feature_name;
+    char            strand;
+    int64_t         overlap;
+
+    unsigned long   unique_peaks;
+    unsigned long   feature_overlaps[RANK_MAX_FEATURES];
+
+    overlap_emit_t  emit;           // Receives kept overlaps if not NULL
+    void            *emit_arg;
+};
+
+/* rank.c */
+char    **rank_list_parse(const char *list);
+void    rank_init(rank_t *rank, char **features, feature_set_t *fs);
+size_t  feature_name_rank(const char *name, char *features[]);
+void    rank_add(rank_t *rank, FILE *overlaps_stream, const char *chrom,
+		 int64_t peak_start, int64_t peak_end,
+		 int64_t feature_start, int64_t feature_end,
+		 const char *feature_name, size_t name_rank, char strand,
+		 int64_t overlap, int64_t tss_distance);
+void    rank_finish(rank_t *rank, FILE *overlaps_stream);
+void    rank_merge(rank_t *dest, rank_t *src);
+unsigned long   rank_kept(rank_t *rank);
+void    rank_summary(rank_t *rank, FILE *stream);
+void    rank_free(rank_t *rank);
+
+#endif  // _RANK_H_
@@ -0,0 +1,257 @@
+/***************************************************************************
+ *  Description:
+ *      peak-classifier --serve: keep the feature index mapped and answer
+ *      peak and region queries on a Unix domain socket, so interactive
+ *      tools do not pay for a full run per question.  Each worker
+ *      thread accepts and serves one connection at a time.  Queries
+ *      need not be sorted, since the sweep is positioned for each one by
+ *      binary search.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <sysexits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <xtend/mem.h>
+#include <biolibc/bed.h>
+#include "classify.h"
+#include "rank.h"
+#include "serve.h"
+
+// For removing the socket on SIGINT or SIGTERM
+static char Socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+static void serve_exit(int sig)
+
+{
+    unlink(Socket_path);
+    _exit(sig == SIGTERM ? EX_OK : 128 + sig);
+}
+
+
+/*
+ *  Parse chrom, start, and end from a query line.  Return true if valid.
+ */
+
+static bool query_parse(char *line, char **chrom, int64_t *start,
+			int64_t *end)
+
+{
+    char    *save,
+	    *start_str,
+	    *end_str,
+	    *p;
+
+    if ( ((*chrom = strtok_r(line, " \t\r\n", &save)) == NULL) ||
+	 ((start_str = strtok_r(NULL, " \t\r\n", &save)) == NULL) ||
+	 ((end_str = strtok_r(NULL, " \t\r\n", &save)) == NULL) ||
+	 (strlen(*chrom) > BL_CHROM_MAX_CHARS) )
+	return false;
+    *start = strtoll(start_str, &p, 10);
+    if ( (*p != '\0') || (*start < 0) )
+	return false;
+    *end = strtoll(end_str, &p, 10);
+    return (*p == '\0') && (*end >= *start);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Answer queries on one connection until the client closes it
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+static void serve_connection(server_t *server, int fd)
+
+{
+    FILE            *in,
+		    *out;
+    char            *line = NULL,
+		    *chrom;
+    size_t          line_size = 0;
+    unsigned long   line_num = 0;
+    int64_t         start,
+		    end;
+    sweep_t         sweep = SWEEP_INIT;
+    rank_t          rank,
+		    *rankp = NULL;
+    int             out_fd;
+
+    if ( ((out_fd = dup(fd)) == -1) || ((in = fdopen(fd, "r")) == NULL) )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open connection: %s\n",
+		strerror(errno));
+	close(fd);
+	if ( out_fd != -1 )
+	    close(out_fd);
+	return;
+    }
+    if ( (out = fdopen(out_fd, "w")) == NULL )
+    {
+	fprintf(stderr, "peak-classifier: Cannot open connection: %s\n",
+		strerror(errno));
+	fclose(in);
+	close(out_fd);
+	return;
+    }
+
+    if ( server->params->rank_features != NULL )
+    {
+	rank_init(&rank, server->params->rank_features, server->fs);
+	rankp = &rank;
+    }
+    while ( getline(&line, &line_size, in) != -1 )
+    {
+	++line_num;
+	if ( line[strspn(line, " \t\r\n")] == '\0' )
+	{
+	    // End of batch
+	    if ( rankp != NULL )
+		rank_finish(rankp, out);
+	    putc('\n', out);
+	    if ( fflush(out) != 0 )
+		break;  // Client went away
+	    continue;
+	}
+	if ( *line == '#' )
+	    continue;
+	if ( !query_parse(line, &chrom, &start, &end) )
+	{
+	    fprintf(out, "#Error: Query %lu: Expected chrom start end.\n",
+		    line_num);
+	    continue;
+	}
+	if ( server->params->midpoints_only )
+	{
+	    start = (start + end) / 2;
+	    end = start + 1;
+	}
+	sweep_seek(&sweep, server->fs, chrom, start);
+	classify_peak(server->fs, &sweep, chrom, start, end, server->params,
+		      rankp, out);
+    }
+    if ( rankp != NULL )
+    {
+	rank_finish(rankp, out);
+	rank_free(rankp);
+    }
+    sweep_free(&sweep);
+    free(line);
+    fclose(out);
+    fclose(in);
+}
+
+
+/*
+ *  Worker thread: accept and serve connections until the process exits
+ */
+
+static void *serve_worker(void *arg)
+
+{
+    server_t    *server = arg;
+    int         fd;
+
+    for (;;)
+    {
+	if ( (fd = accept(server->listen_fd, NULL, NULL)) == -1 )
+	{
+	    if ( (errno == EINTR) || (errno == ECONNABORTED) )
+		continue;
+	    fprintf(stderr, "peak-classifier: accept() failed: %s\n",
+		    strerror(errno));
+	    break;
+	}
+	serve_connection(server, fd);
+    }
+    return NULL;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Listen on socket_path and serve queries using threads worker
+ *      threads until terminated by SIGINT or SIGTERM, which remove the
+ *      socket.  An existing socket at socket_path is replaced.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     serve(feature_set_t *fs, overlap_params_t *params,
+	      const char *socket_path, unsigned threads)
+
+{
+    server_t            server;
+    struct sockaddr_un  addr;
+    pthread_t           *tids;
+    unsigned            t,
+			started;
+
+    if ( strlen(socket_path) >= sizeof(addr.sun_path) )
+    {
+	fprintf(stderr, "peak-classifier: Socket path %s is too long.\n",
+		socket_path);
+	return EX_USAGE;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    strcpy(Socket_path, socket_path);
+
+    server.fs = fs;
+    server.params = params;
+    if ( (server.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 )
+    {
+	fprintf(stderr, "peak-classifier: socket() failed: %s\n",
+		strerror(errno));
+	return EX_OSERR;
+    }
+    unlink(socket_path);
+    if ( (bind(server.listen_fd, (struct sockaddr *)&addr,
+	       sizeof(addr)) != 0) ||
+	 (listen(server.listen_fd, SERVE_BACKLOG) != 0) )
+    {
+	fprintf(stderr, "peak-classifier: Cannot listen on %s: %s\n",
+		socket_path, strerror(errno));
+	close(server.listen_fd);
+	return EX_CANTCREAT;
+    }
+
+    // Clients that disconnect early must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, serve_exit);
+    signal(SIGTERM, serve_exit);
+    fprintf(stderr, "Serving queries on %s with %u threads...\n",
+	    socket_path, threads);
+
+    tids = xt_malloc(threads, sizeof(*tids));
+    for (t = started = 0; t < threads; ++t)
+	if ( pthread_create(&tids[started], NULL, serve_worker, &server) == 0 )
+	    ++started;
+    if ( started == 0 )
+	serve_worker(&server);
+    for (t = 0; t < started; ++t)
+	pthread_join(tids[t], NULL);
+    free(tids);
+    close(server.listen_fd);
+    unlink(socket_path);
+    return EX_OSERR;
+}
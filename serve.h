@@ -0,0 +1,31 @@
+#ifndef _SERVE_H_
+#define _SERVE_H_
+
+/*
+ *  Resident classification server.  Clients connect to a Unix domain
+ *  socket and send queries, one per line, as BED-like fields:
+ *
+ *      chrom start end [anything ...]
+ *
+ *  Each query is answered with the same lines peak-classifier writes
+ *  to the overlaps TSV, without the header.  A blank line ends a batch:
+ *  the server sends the results for the batch followed by a blank line.
+ *  Results are also flushed when the client closes its end.  Malformed
+ *  queries are answered with a line beginning "#Error".
+ */
+
+#define SERVE_BACKLOG           64
+#define SERVE_DEFAULT_THREADS   8
+
+typedef struct
+{
+    int                 listen_fd;
+    feature_set_t       *fs;
+    overlap_params_t    *params;
+}   server_t;
+
+/* serve.c */
+int     serve(feature_set_t *fs, overlap_params_t *params,
+	      const char *socket_path, unsigned threads);
+
+#endif  // _SERVE_H_
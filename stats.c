@@ -0,0 +1,270 @@
+/***************************************************************************
+ *  Description:
+ *      Wall time, CPU time, record and byte counts, and peak memory
+ *      for each stage of a run, reported on stderr with --stats so that
+ *      jobs can be sized for a scheduler without wrapping them in
+ *      time(1), which sees only the process as a whole.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "stats.h"
+
+/***************************************************************************
+ *  Description:
+ *      Parse --stats or --stats=format at arg.  Return 1 if recognized,
+ *      0 if arg is not a stats option, or -1 if the format is invalid.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+int     stats_parse(stats_t *stats, const char *arg)
+
+{
+    if ( (strcmp(arg, "--stats") == 0) || (strcmp(arg, "--stats=text") == 0) )
+	stats->format = STATS_TEXT;
+    else if ( strcmp(arg, "--stats=json") == 0 )
+	stats->format = STATS_JSON;
+    else if ( strncmp(arg, "--stats=", 8) == 0 )
+	return -1;
+    else
+	return 0;
+    return 1;
+}
+
+
+static double   wall_seconds(void)
+
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static double   tv_seconds(struct timeval *tv)
+
+{
+    return tv->tv_sec + tv->tv_usec / 1000000.0;
+}
+
+
+/*
+ *  CPU time and peak RSS of this process plus reaped children
+ */
+
+static double   cpu_seconds(long *max_rss)
+
+{
+    struct rusage   self,
+		    children;
+
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    if ( max_rss != NULL )
+    {
+	*max_rss = self.ru_maxrss > children.ru_maxrss ?
+		   self.ru_maxrss : children.ru_maxrss;
+#ifdef __APPLE__
+	*max_rss /= 1024;   // Bytes on macOS, KiB elsewhere
+#endif
+    }
+    return tv_seconds(&self.ru_utime) + tv_seconds(&self.ru_stime) +
+	   tv_seconds(&children.ru_utime) + tv_seconds(&children.ru_stime);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Start timing a stage.  Stages are recorded whether or not
+ *      --stats was given, since it costs only two system calls.
+ *      Return NULL if stats is NULL or the stage table is full, which
+ *      stats_end() ignores.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+stats_stage_t   *stats_begin(stats_t *stats, const char *name)
+
+{
+    stats_stage_t   *stage;
+
+    if ( (stats == NULL) || (stats->count == STATS_MAX_STAGES) )
+	return NULL;
+    stage = &stats->stages[stats->count++];
+    memset(stage, 0, sizeof(*stage));
+    stage->name = name;
+    stage->wall_start = wall_seconds();
+    stage->cpu_start = cpu_seconds(NULL);
+    return stage;
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Finish timing a stage and record its counts.  Pass -1 for
+ *      counts that are unknown or do not apply.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    stats_end(stats_stage_t *stage, int64_t records_in,
+		  int64_t records_out, int64_t bytes_in, int64_t bytes_out)
+
+{
+    if ( stage == NULL )
+	return;
+    stage->wall = wall_seconds() - stage->wall_start;
+    stage->cpu = cpu_seconds(&stage->max_rss) - stage->cpu_start;
+    stage->records_in = records_in;
+    stage->records_out = records_out;
+    stage->bytes_in = bytes_in;
+    stage->bytes_out = bytes_out;
+}
+
+
+/*
+ *  Input records per second, or output records if input is unknown
+ */
+
+static double   stage_rate(stats_stage_t *stage)
+
+{
+    int64_t records = stage->records_in >= 0 ? stage->records_in :
+		      stage->records_out;
+
+    if ( (records < 0) || (stage->wall <= 0.0) )
+	return -1.0;
+    return records / stage->wall;
+}
+
+
+static void text_count(FILE *stream, int width, int64_t count)
+
+{
+    if ( count < 0 )
+	fprintf(stream, " %*s", width, "-");
+    else
+	fprintf(stream, " %*" PRId64, width, count);
+}
+
+
+static void json_count(FILE *stream, const char *key, int64_t count)
+
+{
+    if ( count < 0 )
+	fprintf(stream, ", \"%s\": null", key);
+    else
+	fprintf(stream, ", \"%s\": %" PRId64, key, count);
+}
+
+
+/***************************************************************************
+ *  Description:
+ *      Print all stages as a table or a JSON object, according to the
+ *      --stats format.  Nothing is printed without --stats.
+ *
+ *  History:
+ *  Date        Name        Modification
+ *  2026-10-16  Jason Bacon Begin
+ ***************************************************************************/
+
+void    stats_print(stats_t *stats, FILE *stream)
+
+{
+    stats_stage_t   *stage;
+    double          rate;
+    size_t          c;
+
+    if ( stats->format == STATS_TEXT )
+    {
+	fprintf(stream, "\n%-10s %9s %9s %12s %12s %11s %13s %13s %11s\n",
+		"Stage", "Wall(s)", "CPU(s)", "Records-in", "Records-out",
+		"Records/s", "Bytes-in", "Bytes-out", "MaxRSS(KiB)");
+	for (c = 0; c < stats->count; ++c)
+	{
+	    stage = &stats->stages[c];
+	    fprintf(stream, "%-10s %9.3f %9.3f", stage->name, stage->wall,
+		    stage->cpu);
+	    text_count(stream, 12, stage->records_in);
+	    text_count(stream, 12, stage->records_out);
+	    text_count(stream, 11, (int64_t)stage_rate(stage));
+	    text_count(stream, 13, stage->bytes_in);
+	    text_count(stream, 13, stage->bytes_out);
+	    fprintf(stream, " %11ld\n", stage->max_rss);
+	}
+    }
+    else if ( stats->format == STATS_JSON )
+    {
+	fprintf(stream, "{\"program\": \"%s\", \"version\": \"%s\", "
+		"\"stages\": [", stats->program, VERSION);
+	for (c = 0; c < stats->count; ++c)
+	{
+	    stage = &stats->stages[c];
+	    fprintf(stream, "%s\n  {\"stage\": \"%s\", \"wall_seconds\": %.6f, "
+		    "\"cpu_seconds\": %.6f", c == 0 ? "" : ",", stage->name,
+		    stage->wall, stage->cpu);
+	    json_count(stream, "records_in", stage->records_in);
+	    json_count(stream, "records_out", stage->records_out);
+	    if ( (rate = stage_rate(stage)) < 0.0 )
+		fputs(", \"records_per_second\": null", stream);
+	    else
+		fprintf(stream, ", \"records_per_second\": %.1f", rate);
+	    json_count(stream, "bytes_in", stage->bytes_in);
+	    json_count(stream, "bytes_out", stage->bytes_out);
+	    fprintf(stream, ", \"max_rss_kib\": %ld}", stage->max_rss);
+	}
+	fputs("\n]}\n", stream);
+    }
+}
+
+
+/*
+ *  Size of a file, or -1 if unknown, e.g. for "-" (stdin/stdout)
+ */
+
+int64_t stats_path_bytes(const char *filename)
+
+{
+    struct stat st;
+
+    if ( (filename == NULL) || (strcmp(filename, "-") == 0) ||
+	 (stat(filename, &st) != 0) || !S_ISREG(st.st_mode) )
+	return -1;
+    return st.st_size;
+}
+
+
+/*
+ *  Bytes written so far to an output stream, or -1 for a pipe
+ */
+
+int64_t stats_stream_bytes(FILE *stream)
+
+{
+    off_t   offset;
+
+    fflush(stream);
+    if ( (offset = ftello(stream)) == -1 )
+	return -1;
+    return offset;
+}
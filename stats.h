@@ -0,0 +1,53 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/*
+ *  Per-stage resource use for --stats.  CPU time and peak RSS include
+ *  child processes such as decompressors once they have been reaped,
+ *  which is when getrusage(RUSAGE_CHILDREN) sees them.  Counts of -1
+ *  are unknown, e.g. bytes written to a pipe.
+ */
+
+#define STATS_MAX_STAGES    16
+
+typedef enum
+{
+    STATS_OFF,
+    STATS_TEXT,
+    STATS_JSON
+}   stats_format_t;
+
+typedef struct
+{
+    const char      *name;
+    double          wall_start;
+    double          cpu_start;
+    double          wall;           // Seconds
+    double          cpu;            // User + system seconds, all threads
+    int64_t         records_in;
+    int64_t         records_out;
+    int64_t         bytes_in;
+    int64_t         bytes_out;
+    long            max_rss;        // KiB, high water mark so far
+}   stats_stage_t;
+
+typedef struct
+{
+    const char      *program;
+    stats_format_t  format;
+    stats_stage_t   stages[STATS_MAX_STAGES];
+    size_t          count;
+}   stats_t;
+
+#define STATS_INIT(program) { (program), STATS_OFF, { { NULL } }, 0 }
+
+/* stats.c */
+int     stats_parse(stats_t *stats, const char *arg);
+stats_stage_t *stats_begin(stats_t *stats, const char *name);
+void    stats_end(stats_stage_t *stage, int64_t records_in,
+		  int64_t records_out, int64_t bytes_in, int64_t bytes_out);
+void    stats_print(stats_t *stats, FILE *stream);
+int64_t stats_path_bytes(const char *filename);
+int64_t stats_stream_bytes(FILE *stream);
+
+#endif  // _STATS_H_